@@ -0,0 +1,257 @@
+// library overhead benchmarks, google benchmark.
+// g++ -std=c++17 -O2 -I../include bench.cpp -lbenchmark -lpthread -lmysqlclient -lodbc -o bench
+// ./bench --benchmark_format=json --benchmark_out=bench.json
+//
+// mysql: SQLPP_BENCH_MYSQL_HOST(127.0.0.1) SQLPP_BENCH_MYSQL_PORT(3306) SQLPP_BENCH_MYSQL_USER(root) SQLPP_BENCH_MYSQL_PASSWD
+// odbc:  SQLPP_BENCH_ODBC_DRIVER(Driver=SQLite3;Database=/tmp/sqlpp_bench.db), unixODBC with sqliteodbc
+// a backend that can not connect is skipped with error
+//
+// built with -DSQLCPP_MOCK_DRIVER (no -lmysqlclient -lodbc) both backends are the in-process mock driver,
+// so only the library's own cost is measured. SQLPP_BENCH_MOCK_LATENCY_US(0) adds latency to every statement
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <optional>
+#include <memory>
+#include <chrono>
+#include <benchmark/benchmark.h>
+#include "db.hpp"
+#include "mysql_connection_pool.hpp"
+#include "sqlserver_connection_pool.hpp"
+
+using namespace sqlcpp;
+
+namespace {
+	constexpr int seed_rows = 10000;
+
+	struct bench_row {
+		int id;
+		int a;
+		std::string b;
+		std::optional<int> c;
+		std::optional<std::string> d;
+		REFLECT(bench_row, id, a, b, c, d);
+	};
+	using bench_tuple = std::tuple<int, int, std::string, std::optional<int>, std::optional<std::string>>;
+
+	std::string env(const char* name, const char* default_value) {
+		auto v = std::getenv(name);
+		return v == nullptr ? default_value : v;
+	}
+
+	struct mysql_backend {
+		using db_t = db<model::single, mysql::connection_pool>;
+		static constexpr const char* table = "sqlpp_bench.bench_rows";
+		static constexpr const char* begin_sql = "start transaction";
+
+		static std::unique_ptr<db_t> make() {
+			node_info node{ env("SQLPP_BENCH_MYSQL_HOST", "127.0.0.1"), env("SQLPP_BENCH_MYSQL_PORT", "3306") };
+			return std::make_unique<db_t>(std::vector<node_info>{ node },
+				env("SQLPP_BENCH_MYSQL_USER", "root"), env("SQLPP_BENCH_MYSQL_PASSWD", ""));
+		}
+
+		static void create_schema(db_t& d) {
+			auto conn = d.get_conn<conn_type::general>();
+			conn->query<void>("create database if not exists sqlpp_bench");
+			conn->query<void>("drop table if exists sqlpp_bench.bench_rows");
+			conn->query<void>("create table sqlpp_bench.bench_rows (id int primary key, a int not null, "
+				"b varchar(64) not null, c int null, d varchar(64) null)");
+		}
+	};
+
+	struct odbc_backend {
+		using db_t = db<model::single, sqlserver::connection_pool>;
+		static constexpr const char* table = "bench_rows";
+		//not begin_transaction, its T-SQL "begin tran" is a syntax error for sqlite. both take this one
+		static constexpr const char* begin_sql = "begin transaction";
+
+		static std::unique_ptr<db_t> make() {
+			return std::make_unique<db_t>(std::vector<node_info>{ {"localhost"} }, "", "",
+				env("SQLPP_BENCH_ODBC_DRIVER", "Driver=SQLite3;Database=/tmp/sqlpp_bench.db"));
+		}
+
+		static void create_schema(db_t& d) {
+			auto conn = d.get_conn<conn_type::general>();
+			conn->query<void>("drop table if exists bench_rows");
+			conn->query<void>("create table bench_rows (id int primary key, a int not null, "
+				"b varchar(64) not null, c int null, d varchar(64) null)");
+		}
+	};
+
+#ifdef SQLCPP_MOCK_DRIVER
+	// the seeded table as canned results of every statement the benchmarks send
+	void add_mock_rules(const std::string& table) {
+		using namespace sqlcpp::mock;
+		auto make_result = [](const std::string& columns, int rows) {
+			result_set rs;
+			auto all = std::vector<column>{ {"id", column_type::integer}, {"a", column_type::integer},
+				{"b", column_type::text, 64}, {"c", column_type::integer}, {"d", column_type::text, 64} };
+			for (const auto& c : all) {
+				if (columns.find(c.name) != std::string::npos) {
+					rs.columns.push_back(c);
+				}
+			}
+			for (int i = 0; i < rows; i++) {
+				std::vector<cell> row{ i, i * 7, "name_" + std::to_string(i), std::nullopt, std::nullopt };
+				if (i % 2 == 0) {
+					row[3] = i;
+					row[4] = "note_" + std::to_string(i);
+				}
+				std::vector<cell> picked;
+				for (size_t c = 0; c < all.size(); c++) {
+					if (columns.find(all[c].name) != std::string::npos) {
+						picked.push_back(std::move(row[c]));
+					}
+				}
+				rs.rows.push_back(std::move(picked));
+			}
+			return rs;
+		};
+
+		auto& drv = driver::instance();
+		for (std::string columns : { "id,a,b,c,d", "a", "b", "d" }) {
+			for (int rows : { seed_rows, 100 }) { //"id < 100" is in "id < 10000", bigger first
+				auto sql = "select " + columns + " from " + table + " where id < " + std::to_string(rows);
+				drv.on(sql, make_result(columns, rows));
+			}
+		}
+		drv.on("select a from " + table + " where id", make_result("a", 1));
+	}
+#endif
+
+	// connected and seeded once, shared by all benchmarks of the backend. null if it can not connect
+	template<typename Backend>
+	typename Backend::db_t* bench_db() {
+		static auto d = []() -> std::unique_ptr<typename Backend::db_t> {
+			try {
+#ifdef SQLCPP_MOCK_DRIVER
+				add_mock_rules(Backend::table);
+				auto latency = std::chrono::microseconds(std::stoll(env("SQLPP_BENCH_MOCK_LATENCY_US", "0")));
+				sqlcpp::mock::driver::instance().set_latency(latency);
+#endif
+				auto d = Backend::make();
+				Backend::create_schema(*d);
+				auto conn = d->template get_conn<conn_type::general>();
+				auto insert = std::string("insert into ") + Backend::table + " (id,a,b,c,d) values (?,?,?,?,?)";
+				conn->execute(Backend::begin_sql);
+				for (int i = 0; i < seed_rows; i++) {
+					bench_row row{ i, i * 7, "name_" + std::to_string(i), {}, {} };
+					if (i % 2 == 0) {
+						row.c = i;
+						row.d = "note_" + std::to_string(i);
+					}
+					conn->template query<void>(insert, row);
+				}
+				conn->execute("commit");
+				return d;
+			}
+			catch (const std::exception& e) {
+				fprintf(stderr, "benchmark backend not ready: %s\n", e.what());
+				return nullptr;
+			}
+		}();
+		return d.get();
+	}
+
+	template<typename Backend>
+	typename Backend::db_t* bench_db_or_skip(benchmark::State& state) {
+		auto d = bench_db<Backend>();
+		if (d == nullptr) {
+			state.SkipWithError("backend not ready");
+		}
+		return d;
+	}
+
+	// per query overhead, point lookup by primary key with 0/1/10 params
+	template<typename Backend>
+	void point_lookup(benchmark::State& state) {
+		auto d = bench_db_or_skip<Backend>(state);
+		if (d == nullptr) {
+			return;
+		}
+		auto conn = d->template get_conn<conn_type::general>();
+		auto table = std::string(Backend::table);
+		auto sql0 = "select a from " + table + " where id = 42";
+		auto sql1 = "select a from " + table + " where id = ?";
+		auto sql10 = "select a from " + table + " where id in (?,?,?,?,?,?,?,?,?,?)";
+		int id = 42;
+		for (auto _ : state) {
+			std::vector<int> r;
+			switch (state.range(0)) {
+			case 0:
+				r = conn->template query<int>(sql0);
+				break;
+			case 1:
+				r = conn->template query<int>(sql1, id);
+				break;
+			default:
+				r = conn->template query<int>(sql10, id, id, id, id, id, id, id, id, id, id);
+				break;
+			}
+			benchmark::DoNotOptimize(r);
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	// rows decoded per second, state.range(0) rows a query
+	template<typename Backend, typename Row>
+	void decode_rows(benchmark::State& state) {
+		auto d = bench_db_or_skip<Backend>(state);
+		if (d == nullptr) {
+			return;
+		}
+		auto conn = d->template get_conn<conn_type::general>();
+		std::string columns = "id,a,b,c,d";
+		if constexpr (std::is_same_v<Row, int>) {
+			columns = "a";
+		}
+		else if constexpr (std::is_same_v<Row, std::string>) {
+			columns = "b";
+		}
+		else if constexpr (std::is_same_v<Row, std::optional<std::string>>) {
+			columns = "d";
+		}
+		auto sql = "select " + columns + " from " + Backend::table + " where id < " + std::to_string(state.range(0));
+		int64_t rows = 0;
+		for (auto _ : state) {
+			auto r = conn->template query<Row>(sql);
+			rows += (int64_t)r.size();
+			benchmark::DoNotOptimize(r);
+		}
+		state.SetItemsProcessed(rows);
+	}
+
+	// acquire and release a pooled connection, every thread shares one pool
+	template<typename Backend>
+	void pool_acquire(benchmark::State& state) {
+		auto d = bench_db_or_skip<Backend>(state);
+		if (d == nullptr) {
+			return;
+		}
+		for (auto _ : state) {
+			auto conn = d->template get_conn<conn_type::general>();
+			benchmark::DoNotOptimize(conn);
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+}
+
+BENCHMARK_TEMPLATE(point_lookup, mysql_backend)->Arg(0)->Arg(1)->Arg(10);
+BENCHMARK_TEMPLATE(point_lookup, odbc_backend)->Arg(0)->Arg(1)->Arg(10);
+
+BENCHMARK_TEMPLATE(decode_rows, mysql_backend, bench_tuple)->Arg(100)->Arg(seed_rows);
+BENCHMARK_TEMPLATE(decode_rows, mysql_backend, bench_row)->Arg(100)->Arg(seed_rows);
+BENCHMARK_TEMPLATE(decode_rows, mysql_backend, int)->Arg(100)->Arg(seed_rows);
+BENCHMARK_TEMPLATE(decode_rows, mysql_backend, std::string)->Arg(100)->Arg(seed_rows);
+BENCHMARK_TEMPLATE(decode_rows, mysql_backend, std::optional<std::string>)->Arg(100)->Arg(seed_rows);
+BENCHMARK_TEMPLATE(decode_rows, odbc_backend, bench_tuple)->Arg(100)->Arg(seed_rows);
+BENCHMARK_TEMPLATE(decode_rows, odbc_backend, bench_row)->Arg(100)->Arg(seed_rows);
+BENCHMARK_TEMPLATE(decode_rows, odbc_backend, int)->Arg(100)->Arg(seed_rows);
+BENCHMARK_TEMPLATE(decode_rows, odbc_backend, std::string)->Arg(100)->Arg(seed_rows);
+BENCHMARK_TEMPLATE(decode_rows, odbc_backend, std::optional<std::string>)->Arg(100)->Arg(seed_rows);
+
+BENCHMARK_TEMPLATE(pool_acquire, mysql_backend)->ThreadRange(1, 128)->UseRealTime();
+BENCHMARK_TEMPLATE(pool_acquire, odbc_backend)->ThreadRange(1, 128)->UseRealTime();
+
+BENCHMARK_MAIN();
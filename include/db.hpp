@@ -1,15 +1,147 @@
 #pragma once
 #include <memory>
 #include <vector>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <type_traits>
+#include <string>
+#include <string_view>
+#include <cctype>
+#include <unordered_map>
+#include <shared_mutex>
+#include <optional>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <chrono>
 #include "db_common.h"
 #include "exception.hpp"
 #include "db_meta.hpp"
+#include "result_cache.hpp"
+#include "write_behind.hpp"
+#include "trace.hpp"
+#include "pool_metrics.hpp"
+#include "reflect_sql.hpp"
 
 namespace sqlcpp {
-	template<model Model, template<model M> typename ConnectionPool>
+	namespace detail {
+		// a select that can run on a replica: no locking clause, no into, no session or lock functions.
+		// with ... is a read only if no insert/update/delete/merge follows
+		inline bool is_replica_read(std::string_view sql) {
+			std::string word;
+			std::string prev;
+			bool first = true;
+			bool with = false;
+			for (size_t i = 0; i < sql.size();) {
+				char c = sql[i];
+				if (c == '\'' || c == '"' || c == '`' || c == '[') { //literal or quoted name
+					char close = c == '[' ? ']' : c;
+					for (i++; i < sql.size() && sql[i] != close; i++) {
+						if (sql[i] == '\\') {
+							i++;
+						}
+					}
+					i++;
+					continue;
+				}
+				if (c == '-' && i + 1 < sql.size() && sql[i + 1] == '-') {
+					i = sql.find('\n', i);
+					i = i == std::string_view::npos ? sql.size() : i;
+					continue;
+				}
+				if (c == '/' && i + 1 < sql.size() && sql[i + 1] == '*') {
+					i = sql.find("*/", i + 2);
+					i = i == std::string_view::npos ? sql.size() : i + 2;
+					continue;
+				}
+				if (!(std::isalnum((unsigned char)c) || c == '_' || c == '@')) {
+					i++;
+					continue;
+				}
+
+				word.clear();
+				for (; i < sql.size() && (std::isalnum((unsigned char)sql[i]) || sql[i] == '_' || sql[i] == '@'); i++) {
+					word += (char)std::tolower((unsigned char)sql[i]);
+				}
+				if (first) {
+					first = false;
+					with = word == "with";
+					if (word != "select" && !with) {
+						return false;
+					}
+				}
+				else if (word == "into" || word == "updlock" || word == "xlock" || word == "holdlock" || word == "tablockx" ||
+					(prev == "for" && (word == "update" || word == "share")) || (prev == "in" && word == "share") ||
+					word == "get_lock" || word == "release_lock" || word == "last_insert_id" || word == "found_rows" || word == "row_count" ||
+					word == "scope_identity" || word == "@@identity" || word == "nextval" || word == "setval") {
+					return false;
+				}
+				else if (with && (word == "insert" || word == "update" || word == "delete" || word == "merge")) {
+					return false;
+				}
+				prev = std::move(word);
+			}
+			return !first;
+		}
+
+		// [first, last] ranges covering [low, high], split at bounds or evenly
+		inline std::vector<std::pair<int64_t, int64_t>> split_range(int64_t low, int64_t high, const scan_options& opt) {
+			std::vector<std::pair<int64_t, int64_t>> ranges;
+			if (!opt.bounds.empty()) {
+				auto first = low;
+				for (auto bound : opt.bounds) {
+					if (bound > first && bound <= high) {
+						ranges.emplace_back(first, bound - 1);
+						first = bound;
+					}
+				}
+				ranges.emplace_back(first, high);
+				return ranges;
+			}
+
+			auto chunks = opt.chunks != 0 ? opt.chunks : (std::max)(opt.parallelism, (size_t)1) * 4;
+			auto span = (uint64_t)high - (uint64_t)low; //no overflow for any int64 pair
+			chunks = (size_t)(std::min)((uint64_t)chunks, span + 1 == 0 ? span : span + 1);
+			auto width = span / chunks + 1;
+			width = width == 0 ? span : width; //one range over the whole int64
+			for (uint64_t offset = 0; offset <= span; offset += width) {
+				auto last = span - offset < width ? span : offset + width - 1;
+				ranges.emplace_back((int64_t)((uint64_t)low + offset), (int64_t)((uint64_t)low + last));
+				if (last == span) {
+					break;
+				}
+			}
+			return ranges;
+		}
+	}
+
+	// ShardModel is the model of every shard when Model is sharded, see sharded_db.hpp
+	template<model Model, template<model M> typename ConnectionPool, model ShardModel = model::single>
 	class db {
+	public:
+		//the connection used for writing, also for reading cached results to avoid stale replicas
+		static constexpr conn_type write_conn_type = Model == model::single ? conn_type::general : conn_type::master;
 	private:
 		std::unique_ptr<ConnectionPool<Model>> pool_;
+		std::unique_ptr<result_cache> cache_;
+		std::atomic<uint64_t> transactions_ = 0;
+		std::atomic<uint64_t> retries_ = 0;
+		std::atomic<uint64_t> exhausted_ = 0;
+
+		//read/write routing of db::query
+		using write_conn_t = decltype(std::declval<ConnectionPool<Model>&>().template get_connection<write_conn_type>());
+		struct session {
+			write_conn_t* transaction = nullptr; //connection of the running transact on this thread
+			std::chrono::steady_clock::time_point last_write{};
+		};
+		std::chrono::milliseconds read_after_write_window_{ 1000 };
+		mutable std::shared_mutex route_mtx_;
+		std::unordered_map<uint64_t, bool> routes_; //statement id---read on replica
+		std::atomic<uint64_t> slave_reads_ = 0;
+		std::atomic<uint64_t> master_reads_ = 0;
+		std::atomic<uint64_t> writes_ = 0;
 	public:
 		db(std::vector<node_info> nodes, std::string user, std::string passwd) {
 			if constexpr (Model == model::single) {
@@ -23,12 +155,12 @@ namespace sqlcpp {
 			}
 		}
 
-		db(std::vector<node_info> nodes, std::string user, std::string passwd, std::string odbc_driver_name) {
+		db(std::vector<node_info> nodes, std::string user, std::string passwd, std::string odbc_driver_name, pool_options pool_opt = {}) {
 			if constexpr (Model == model::single) {
-				pool_ = std::make_unique<ConnectionPool<Model>>(std::move(nodes[0]), std::move(user), std::move(passwd), std::move(odbc_driver_name));
+				pool_ = std::make_unique<ConnectionPool<Model>>(std::move(nodes[0]), std::move(user), std::move(passwd), std::move(odbc_driver_name), pool_opt);
 			}
 			else if constexpr (Model == model::cluster) {
-				pool_ = std::make_unique<ConnectionPool<Model>>(std::move(nodes), std::move(user), std::move(passwd), std::move(odbc_driver_name));
+				pool_ = std::make_unique<ConnectionPool<Model>>(std::move(nodes), std::move(user), std::move(passwd), std::move(odbc_driver_name), pool_opt);
 			}
 			else {
 				static_assert(always_false_v<ConnectionPool<Model>>, "mode error");
@@ -40,5 +172,319 @@ namespace sqlcpp {
 		decltype(auto) get_conn() {
 			return pool_->template get_connection<Type>();
 		}
+
+#ifdef SQLCPP_TRACE
+		// per query phase timing of every connection of this db, see trace.hpp
+		void set_observer(std::shared_ptr<trace::observer> o) {
+			pool_->set_observer(std::move(o));
+		}
+#endif
+
+		// run fn(conn) in a transaction on master connection. if deadlock or lock timeout happened,
+		// roll back and run it again after a jittered exponential backoff
+		template<typename Fun>
+		auto transact(Fun&& fn, const retry_policy& policy = {}) {
+			constexpr auto type = write_conn_type;
+			using conn_t = decltype(get_conn<type>());
+			using return_t = std::invoke_result_t<Fun&, conn_t&>;
+
+			transactions_++;
+			for (uint32_t attempt = 0;; attempt++) {
+				auto conn = get_conn<type>();
+				//db::query of fn goes to this connection
+				auto& s = this_session();
+				auto outer = std::exchange(s.transaction, &conn);
+				scope_guard unpin([&s, outer]() {
+					s.transaction = outer;
+					s.last_write = std::chrono::steady_clock::now();
+				});
+				try {
+					conn->begin_transaction();
+					if constexpr (std::is_void_v<return_t>) {
+						fn(conn);
+						conn->commit_transaction();
+						return;
+					}
+					else {
+						return_t r = fn(conn);
+						conn->commit_transaction();
+						return r;
+					}
+				}
+				catch (const except::sql_exception& e) {
+					try {
+						conn->rollback();
+					}
+					catch (...) {} //connection is bad, it will be dropped when returned
+
+					if (!conn->is_retriable_error(e.get_error_code())) {
+						throw;
+					}
+					if (attempt >= policy.max_retries) {
+						exhausted_++;
+						throw;
+					}
+					retries_++;
+				}
+				std::this_thread::sleep_for(backoff_delay(policy, attempt));
+			}
+		}
+
+		transaction_stats get_transaction_stats() const {
+			return { transactions_.load(), retries_.load(), exhausted_.load() };
+		}
+
+		// db::query runs reads on a slave and everything else on master. reads of a thread stay on master
+		// inside transact and for this window after its last write, so it reads its own writes. set it before use
+		void set_read_after_write_window(std::chrono::milliseconds window) {
+			read_after_write_window_ = window;
+		}
+
+		routing_stats get_routing_stats() const {
+			return { slave_reads_.load(), master_reads_.load(), writes_.load() };
+		}
+
+		// connections per node and pool counters, to_prometheus(stats) for scraping
+		pool_stats get_pool_stats() {
+			return pool_->get_stats();
+		}
+
+		// cache results of query<T>, at most max_entries statements
+		void enable_result_cache(size_t max_entries = 10000) {
+			cache_ = std::make_unique<result_cache>(max_entries);
+		}
+
+		// query through the result cache, just a normal query if cache is not enabled
+		template<typename ReturnType, typename... Args>
+		std::vector<ReturnType> cached_query(const cache_options& opt, std::string_view statement_sql, Args&&...args) {
+			auto loader = [&]() {
+				auto conn = get_conn<write_conn_type>();
+				return conn->template query<ReturnType>(statement_sql, args...);
+			};
+			if (!cache_) {
+				return loader();
+			}
+			return cache_->template get_or_load<ReturnType>(opt, statement_sql, loader, args...);
+		}
+
+		// query routed by the statement: a select without locking clause goes to a slave in cluster model, others to master.
+		// writes through db invalidate cached results of the touched tables
+		template<typename ReturnType, typename... Args>
+		auto query(std::string_view statement_sql, Args&&...args) {
+			auto& s = this_session();
+			bool read = is_replica_read(statement_sql);
+			if (s.transaction != nullptr) {
+				return run_query<ReturnType>(*s.transaction, read, statement_sql, std::forward<Args>(args)...);
+			}
+			if constexpr (Model == model::cluster) {
+				if (read && std::chrono::steady_clock::now() - s.last_write >= read_after_write_window_) {
+					if (auto conn = get_slave_conn()) {
+						slave_reads_++;
+						return (*conn)->template query<ReturnType>(statement_sql, std::forward<Args>(args)...);
+					}
+				}
+			}
+			auto conn = get_conn<write_conn_type>();
+			return run_query<ReturnType>(conn, read, statement_sql, std::forward<Args>(args)...);
+		}
+
+		// for writes not going through db::query, like in transact
+		void invalidate(std::string_view table) {
+			if (cache_) {
+				cache_->invalidate(table);
+			}
+		}
+
+		cache_stats get_cache_stats() const {
+			return cache_ ? cache_->get_stats() : cache_stats{};
+		}
+
+		// read table by key ranges on several connections at once, slaves in cluster model.
+		// consumer(std::vector<T>&&) gets the rows of every range, one call at a time. returns rows read
+		template<typename T, typename Consumer>
+		uint64_t parallel_scan(std::string_view table, std::string_view key_column, Consumer&& consumer, scan_options opt = {}) {
+			std::string columns = !opt.columns.empty() ? opt.columns : std::string(default_columns<T>());
+			std::string filter = opt.where.empty() ? "" : " and (" + opt.where + ")";
+
+			//ranges of [first, last]
+			std::vector<std::pair<int64_t, int64_t>> ranges;
+			{
+				auto conn = get_read_conn();
+				auto r = conn->template query<std::tuple<std::optional<int64_t>, std::optional<int64_t>>>(
+					"select min(" + std::string(key_column) + "), max(" + std::string(key_column) + ") from " + std::string(table) +
+					(opt.where.empty() ? "" : " where " + opt.where));
+				if (r.empty() || !std::get<0>(r[0]) || !std::get<1>(r[0])) {
+					return 0; //no rows
+				}
+				ranges = detail::split_range(*std::get<0>(r[0]), *std::get<1>(r[0]), opt);
+			}
+
+			std::string statement = "select " + columns + " from " + std::string(table) + " where " + std::string(key_column) +
+				" >= ? and " + std::string(key_column) + " <= ?" + filter + (opt.ordered ? " order by " + std::string(key_column) : "");
+
+			std::atomic<size_t> next = 0;
+			std::atomic<bool> stop = false;
+			std::atomic<uint64_t> rows = 0;
+			std::mutex consumer_mtx;
+			std::condition_variable window_cond;
+			auto parallelism = (std::min)((std::max)(opt.parallelism, (size_t)1), ranges.size());
+			size_t next_to_deliver = 0; //ordered, ranges before it are delivered
+			std::vector<std::optional<std::vector<T>>> pending(opt.ordered ? ranges.size() : 0);
+			auto deliver = [&](size_t index, std::vector<T>&& part) {
+				std::lock_guard<std::mutex> lock(consumer_mtx);
+				if (stop) { //the consumer or another range failed
+					return;
+				}
+				if (!opt.ordered) {
+					consumer(std::move(part));
+					return;
+				}
+				pending[index] = std::move(part);
+				while (next_to_deliver < pending.size() && pending[next_to_deliver]) {
+					consumer(std::move(*pending[next_to_deliver]));
+					pending[next_to_deliver++].reset();
+					window_cond.notify_all();
+				}
+			};
+			//ordered, at most parallelism ranges are read ahead of the next one to deliver, so a slow range does not make
+			//the others pile up in memory
+			auto wait_window = [&](size_t index) {
+				std::unique_lock<std::mutex> lock(consumer_mtx);
+				window_cond.wait(lock, [&]() { return stop || index < next_to_deliver + parallelism; });
+			};
+
+			std::exception_ptr error;
+			std::mutex error_mtx;
+			auto work = [&]() {
+				try {
+					auto conn = get_read_conn();
+					for (size_t i = next++; i < ranges.size() && !stop; i = next++) {
+						if (opt.ordered) {
+							wait_window(i);
+							if (stop) {
+								break;
+							}
+						}
+						auto part = conn->template query<T>(statement, ranges[i].first, ranges[i].second);
+						rows += part.size();
+						deliver(i, std::move(part));
+					}
+				}
+				catch (...) {
+					{
+						std::lock_guard<std::mutex> lock(consumer_mtx);
+						stop = true;
+					}
+					window_cond.notify_all();
+					std::lock_guard<std::mutex> lock(error_mtx);
+					if (!error) {
+						error = std::current_exception();
+					}
+				}
+			};
+
+			std::vector<std::thread> workers;
+			for (size_t i = 1; i < parallelism; i++) {
+				workers.emplace_back(work);
+			}
+			work();
+			for (auto& t : workers) {
+				t.join();
+			}
+			if (error) {
+				std::rethrow_exception(error);
+			}
+			return rows;
+		}
+
+		// rows pushed are inserted into table by multi-row inserts in background. destroy it before db
+		template<typename T>
+		std::unique_ptr<write_behind<T>> make_write_behind(std::string table, write_behind_options opt = {}) {
+			using connection_t = typename decltype(get_conn<write_conn_type>())::connection_type;
+			opt.batch_size = (std::min)(opt.batch_size, connection_t::max_batch_params / row_size_v<T>);
+			return std::make_unique<write_behind<T>>(std::move(table), opt, [this](std::string_view statement_sql, const std::vector<T>& rows) {
+				auto conn = get_conn<write_conn_type>();
+				conn->query_batch(statement_sql, rows);
+				if (cache_) {
+					cache_->invalidate_tables(statement_sql);
+				}
+			});
+		}
+
+	private:
+		session& this_session() {
+			thread_local std::unordered_map<const db*, session> sessions;
+			return sessions[this];
+		}
+
+		bool is_replica_read(std::string_view statement_sql) {
+			auto id = sql::statement_id(statement_sql);
+			{
+				std::shared_lock<std::shared_mutex> lock(route_mtx_);
+				if (auto iter = routes_.find(id); iter != routes_.end()) {
+					return iter->second;
+				}
+			}
+			bool read = detail::is_replica_read(statement_sql);
+			std::unique_lock<std::shared_mutex> lock(route_mtx_);
+			if (routes_.size() < 10000) { //sql with literals is not cached forever
+				routes_.emplace(id, read);
+			}
+			return read;
+		}
+
+		// slave in cluster model, master if no slave
+		write_conn_t get_read_conn() {
+			if constexpr (Model == model::cluster) {
+				if (auto conn = get_slave_conn()) {
+					return std::move(*conn);
+				}
+			}
+			return get_conn<write_conn_type>();
+		}
+
+		template<typename T>
+		static std::string_view default_columns() {
+			if constexpr (reflection::is_reflection_v<T>) {
+				return sql::columns<T>();
+			}
+			else {
+				return "*";
+			}
+		}
+
+		// no slave node now, the read goes to master
+		std::optional<write_conn_t> get_slave_conn() {
+			try {
+				return get_conn<conn_type::slave>();
+			}
+			catch (const except::sql_exception&) {
+				return std::nullopt;
+			}
+		}
+
+		template<typename ReturnType, typename... Args>
+		auto run_query(write_conn_t& conn, bool read, std::string_view statement_sql, Args&&...args) {
+			if (read) {
+				master_reads_++;
+				return conn->template query<ReturnType>(statement_sql, std::forward<Args>(args)...);
+			}
+			writes_++;
+			scope_guard after_write([this, statement_sql]() {
+				this_session().last_write = std::chrono::steady_clock::now();
+				if (cache_) {
+					cache_->invalidate_tables(statement_sql);
+				}
+			});
+			return conn->template query<ReturnType>(statement_sql, std::forward<Args>(args)...);
+		}
+
+		static std::chrono::milliseconds backoff_delay(const retry_policy& policy, uint32_t attempt) {
+			thread_local std::mt19937 gen{ std::random_device{}() };
+			auto cap = policy.base_delay.count() << (std::min)(attempt, 16u);
+			cap = (std::max)((decltype(cap))1, (std::min)(cap, (decltype(cap))policy.max_delay.count()));
+			std::uniform_int_distribution<decltype(cap)> dist(cap / 2, cap);
+			return std::chrono::milliseconds(dist(gen));
+		}
 	};
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 #include <string>
+#include <vector>
 #include <memory>
+#include <chrono>
+#include <cstdint>
 
 namespace sqlcpp {
 	struct connection_options {
@@ -27,7 +30,42 @@ namespace sqlcpp {
 
 	enum class model {
 		single,
-		cluster
+		cluster,
+		sharded //db only, a pool of single or cluster model per shard
+	};
+
+	struct pool_options {
+		size_t min_size = 0; //connections created when the pool is constructed
+		size_t max_size = 0; //idle and in use connections, 0 means no limit
+		std::chrono::milliseconds wait_timeout{ 3000 }; //wait for a returned connection when max_size reached
+		std::chrono::milliseconds validate_after{ 30000 }; //check a connection idle longer than this before handing it out
+	};
+
+	struct retry_policy {
+		uint32_t max_retries = 5;
+		std::chrono::milliseconds base_delay{ 5 };
+		std::chrono::milliseconds max_delay{ 500 };
+	};
+
+	struct transaction_stats {
+		uint64_t transactions = 0;
+		uint64_t retries = 0; //retried because of deadlock or lock timeout
+		uint64_t exhausted = 0; //failed after all retries
+	};
+
+	struct scan_options {
+		size_t parallelism = 4; //connections reading at once
+		size_t chunks = 0; //key ranges, 0 is 4 per connection
+		std::vector<int64_t> bounds{}; //split points instead of even ranges between min and max, like from a histogram
+		bool ordered = false; //rows come to the consumer in key order
+		std::string columns{}; //select list, REFLECT members by default, * for others
+		std::string where{}; //filter of rows, without where
+	};
+
+	struct routing_stats {
+		uint64_t slave_reads = 0;
+		uint64_t master_reads = 0; //in a transaction, just after a write of the thread, or no slave
+		uint64_t writes = 0;
 	};
 
 	enum class conn_type {
@@ -39,6 +77,8 @@ namespace sqlcpp {
 	template <typename Conn, typename ConnPool>
 	class connection_guard {
 	public:
+		using connection_type = Conn;
+
 		connection_guard(connection_guard&&) = default;
 		connection_guard& operator=(connection_guard&& cg) noexcept {
 			if (this->conn_) {
@@ -68,6 +108,10 @@ namespace sqlcpp {
 			return conn_;
 		}
 
+		Conn& operator*() {
+			return *conn_;
+		}
+
 		bool operator!() {
 			return !conn_;
 		}
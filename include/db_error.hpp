@@ -0,0 +1,128 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <variant>
+#include <optional>
+#include <cstring>
+#include "exception.hpp"
+
+namespace sqlcpp {
+	//error back from try_query, no exception and no message formatting on the error path
+	class db_error {
+	private:
+		int code_ = 0; //native error code, mysql_errno or sqlserver native error
+		char sql_state_[6]{};
+		const char* where_ = ""; //static string, the failed step
+		std::string detail_{}; //raw driver message
+	public:
+		db_error() = default;
+
+		db_error(int code, std::string_view sql_state, const char* where, std::string detail)
+			:code_(code), where_(where), detail_(std::move(detail))
+		{
+			if (!sql_state.empty()) {
+				std::memcpy(sql_state_, sql_state.data(), (std::min)(sql_state.length(), sizeof(sql_state_) - 1));
+			}
+		}
+
+		int code() const {
+			return code_;
+		}
+
+		std::string_view sql_state() const {
+			return sql_state_;
+		}
+
+		//format only when somebody really wants to read it
+		std::string message() const {
+			return std::string("Failed to ") + where_ + " : " + detail_;
+		}
+
+		[[noreturn]] void rethrow() const {
+			throw except::sql_exception(message(), code_);
+		}
+	};
+
+	template<typename E>
+	struct unexpected {
+		E error;
+		explicit unexpected(E e) :error(std::move(e)) {}
+	};
+
+	//a tiny std::expected, value or error
+	template<typename T, typename E = db_error>
+	class expected {
+	private:
+		std::variant<T, E> v_;
+	public:
+		expected(T v) :v_(std::in_place_index<0>, std::move(v)) {}
+		expected(unexpected<E> e) :v_(std::in_place_index<1>, std::move(e.error)) {}
+
+		bool has_value() const {
+			return v_.index() == 0;
+		}
+
+		explicit operator bool() const {
+			return has_value();
+		}
+
+		T& value()& {
+			if (!has_value()) {
+				error().rethrow();
+			}
+			return std::get<0>(v_);
+		}
+
+		T&& value()&& {
+			if (!has_value()) {
+				error().rethrow();
+			}
+			return std::get<0>(std::move(v_));
+		}
+
+		T& operator*() {
+			return std::get<0>(v_);
+		}
+
+		T* operator->() {
+			return &std::get<0>(v_);
+		}
+
+		const E& error() const {
+			return std::get<1>(v_);
+		}
+	};
+
+	template<typename E>
+	class expected<void, E> {
+	private:
+		std::optional<E> e_;
+	public:
+		expected() = default;
+		expected(unexpected<E> e) :e_(std::move(e.error)) {}
+
+		bool has_value() const {
+			return !e_.has_value();
+		}
+
+		explicit operator bool() const {
+			return has_value();
+		}
+
+		void value() const {
+			if (!has_value()) {
+				error().rethrow();
+			}
+		}
+
+		const E& error() const {
+			return *e_;
+		}
+	};
+
+	template<typename ReturnType>
+	using query_result_t = std::conditional_t<std::is_void_v<ReturnType>, void, std::vector<ReturnType>>;
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <type_traits>
 #include <tuple>
+#include <utility>
 #include <optional>
 
 namespace sqlcpp {
@@ -58,5 +59,47 @@ namespace sqlcpp {
 	template<typename...T>
 	inline constexpr bool is_has_char_array_v = std::disjunction_v<has_char_array<T>...>;
 
+	//columns of a tuple or reflect struct row
+	template<typename T, typename = void>
+	struct row_size :std::tuple_size<T> {};
+
+	template<typename T>
+	struct row_size<T, std::void_t<typename T::args_size_t>> :T::args_size_t {};
+
+	template<typename T>
+	inline constexpr size_t row_size_v = row_size<std::decay_t<T>>::value;
+
+	template<typename T, typename = void>
+	struct is_row :is_tuple<T> {};
+
+	template<typename T>
+	struct is_row<T, std::void_t<typename std::decay_t<T>::args_size_t>> :std::true_type {};
+
+	//references to the members of a tuple or reflect struct row, no copy
+	template<typename T, size_t... I>
+	constexpr auto row_refs(const T& row, std::index_sequence<I...>) {
+		if constexpr (is_tuple_v<T>) {
+			return std::forward_as_tuple(std::get<I>(row)...);
+		}
+		else {
+			constexpr auto address = T::elements_address();
+			return std::forward_as_tuple(row.*std::get<I>(address)...);
+		}
+	}
+
+	//query params. one tuple or reflect struct is bound member by member, like query<void>(sql, obj)
+	template<typename... Args>
+	constexpr auto param_refs(Args&&... args) {
+		if constexpr (sizeof...(Args) == 1 && std::conjunction_v<is_row<Args>...>) {
+			return row_refs(args..., std::make_index_sequence<row_size_v<Args...>>());
+		}
+		else {
+			return std::forward_as_tuple(std::forward<Args>(args)...);
+		}
+	}
+
+	template<typename... Args>
+	inline constexpr size_t param_size_v = std::tuple_size_v<decltype(param_refs(std::declval<Args>()...))>;
+
 	
 }
\ No newline at end of file
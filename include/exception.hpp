@@ -66,6 +66,7 @@ namespace except
 	DECLARE_EXCEPTION(sql_exception, exception_base);
 	DECLARE_EXCEPTION(mysql_exception, sql_exception);
 	DECLARE_EXCEPTION(sqlserver_exception, sql_exception);
+	DECLARE_EXCEPTION(postgres_exception, sql_exception);
 }
 
 #endif
@@ -0,0 +1,81 @@
+#pragma once
+#include <string_view>
+#include <atomic>
+#include <cstdio>
+#include <cstdarg>
+
+//leveled logging of the library. SQLCPP_LOG(debug, "fmt", ...) formats nothing below the runtime level,
+//and levels below SQLCPP_LOG_MIN_LEVEL are compiled out
+#ifndef SQLCPP_LOG_MIN_LEVEL
+#define SQLCPP_LOG_MIN_LEVEL 0
+#endif
+
+#define SQLCPP_LOG(level, ...) \
+	do { \
+		if constexpr ((int)::sqlcpp::log_level::level >= SQLCPP_LOG_MIN_LEVEL) { \
+			if (::sqlcpp::log_enabled(::sqlcpp::log_level::level)) { \
+				::sqlcpp::detail::log_write(::sqlcpp::log_level::level, __VA_ARGS__); \
+			} \
+		} \
+	} while (0)
+
+namespace sqlcpp {
+	enum class log_level :int {
+		trace, //every connection created and released
+		debug,
+		info,
+		warn, //errors the library recovers from, like a failed discovery
+		error,
+		off
+	};
+
+	using log_sink = void(*)(log_level, std::string_view);
+
+	namespace detail {
+		inline std::atomic<log_level>& current_log_level() {
+			static std::atomic<log_level> level{ log_level::warn };
+			return level;
+		}
+
+		inline void stderr_sink(log_level level, std::string_view msg) {
+			static constexpr const char* names[] = { "trace", "debug", "info", "warn", "error" };
+			fprintf(stderr, "[sqlcpp %s] %.*s\n", names[(int)level], (int)msg.size(), msg.data());
+		}
+
+		inline std::atomic<log_sink>& current_log_sink() {
+			static std::atomic<log_sink> sink{ &stderr_sink };
+			return sink;
+		}
+
+		inline void log_write(log_level level, const char* fmt, ...) {
+			char buf[1024];
+			va_list args;
+			va_start(args, fmt);
+			auto len = vsnprintf(buf, sizeof(buf), fmt, args);
+			va_end(args);
+			if (len < 0) {
+				return;
+			}
+			auto size = (size_t)len < sizeof(buf) ? (size_t)len : sizeof(buf) - 1; //truncated
+			current_log_sink().load(std::memory_order_relaxed)(level, std::string_view(buf, size));
+		}
+	}
+
+	// warn by default, log_level::off for silence
+	inline void set_log_level(log_level level) {
+		detail::current_log_level().store(level, std::memory_order_relaxed);
+	}
+
+	inline log_level get_log_level() {
+		return detail::current_log_level().load(std::memory_order_relaxed);
+	}
+
+	inline bool log_enabled(log_level level) {
+		return level >= detail::current_log_level().load(std::memory_order_relaxed);
+	}
+
+	// stderr by default. called on the logging thread, must not throw
+	inline void set_log_sink(log_sink sink) {
+		detail::current_log_sink().store(sink != nullptr ? sink : &detail::stderr_sink, std::memory_order_relaxed);
+	}
+}
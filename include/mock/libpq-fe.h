@@ -0,0 +1,409 @@
+#pragma once
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <algorithm>
+#include <unordered_map>
+#include "mock_driver.hpp"
+
+//the part of libpq used by postgres_connection.hpp, answered by sqlcpp::mock::driver.
+//results are binary: integer columns are int8, real float8, text text and binary bytea.
+//in pipeline mode the statements of a sync pay their latency once, like one round trip
+typedef unsigned int Oid;
+
+typedef enum {
+	CONNECTION_OK,
+	CONNECTION_BAD
+} ConnStatusType;
+
+typedef enum {
+	PGRES_EMPTY_QUERY = 0,
+	PGRES_COMMAND_OK,
+	PGRES_TUPLES_OK,
+	PGRES_COPY_OUT,
+	PGRES_COPY_IN,
+	PGRES_BAD_RESPONSE,
+	PGRES_NONFATAL_ERROR,
+	PGRES_FATAL_ERROR,
+	PGRES_COPY_BOTH,
+	PGRES_SINGLE_TUPLE,
+	PGRES_PIPELINE_SYNC,
+	PGRES_PIPELINE_ABORTED
+} ExecStatusType;
+
+typedef enum {
+	PQTRANS_IDLE,
+	PQTRANS_ACTIVE,
+	PQTRANS_INTRANS,
+	PQTRANS_INERROR,
+	PQTRANS_UNKNOWN
+} PGTransactionStatusType;
+
+#define PG_DIAG_SQLSTATE 'C'
+
+struct pg_result {
+	ExecStatusType status = PGRES_COMMAND_OK;
+	std::string sql_state;
+	std::string message;
+	std::string cmd_status;
+	std::string cmd_tuples;
+	std::vector<std::string> names;
+	std::vector<Oid> types;
+	std::vector<std::vector<std::optional<std::string>>> rows; //binary values
+};
+typedef struct pg_result PGresult;
+
+struct pg_conn {
+	std::string host;
+	ConnStatusType status = CONNECTION_OK;
+	std::string error;
+	PGTransactionStatusType trans = PQTRANS_IDLE;
+	std::unordered_map<std::string, std::string> prepared; //name---sql
+	bool pipeline = false;
+	bool aborted = false; //pipeline, a statement before the next sync failed
+	std::deque<PGresult*> pending; //pipeline results, null after the results of each statement
+	std::chrono::microseconds pending_latency{ 0 };
+};
+typedef struct pg_conn PGconn;
+
+namespace sqlcpp::mock::detail {
+	inline PGresult* pg_error(PGconn* conn, std::string sql_state, std::string message) {
+		auto res = new PGresult;
+		res->status = PGRES_FATAL_ERROR;
+		res->sql_state = std::move(sql_state);
+		res->message = std::move(message) + "\n";
+		if (conn->trans == PQTRANS_INTRANS) {
+			conn->trans = PQTRANS_INERROR;
+		}
+		return res;
+	}
+
+	inline bool pg_lost(PGconn* conn) {
+		if (conn->status == CONNECTION_BAD || driver::instance().is_host_down(conn->host)) {
+			conn->status = CONNECTION_BAD;
+			conn->error = "server closed the connection unexpectedly\n";
+			return true;
+		}
+		return false;
+	}
+
+	inline std::string pg_binary(const cell& c, column_type type) {
+		uint64_t bits = 0;
+		switch (type) {
+		case column_type::integer:
+			bits = (uint64_t)c.integer;
+			break;
+		case column_type::real:
+			std::memcpy(&bits, &c.real, sizeof(bits));
+			break;
+		default:
+			return c.text;
+		}
+		std::string s(8, '\0');
+		for (size_t i = 0; i < 8; i++) {
+			s[i] = (char)(bits >> (8 * (7 - i)));
+		}
+		return s;
+	}
+
+	inline Oid pg_type_of(column_type type) {
+		switch (type) {
+		case column_type::integer:
+			return 20;
+		case column_type::real:
+			return 701;
+		case column_type::binary:
+			return 17;
+		default:
+			return 25;
+		}
+	}
+
+	// transaction statements move the transaction state, others are matched against the rules
+	inline PGresult* pg_run(PGconn* conn, std::string_view sql) {
+		if (pg_lost(conn)) {
+			return pg_error(conn, "08006", "server closed the connection unexpectedly");
+		}
+		auto text = lower(sql);
+		auto word = text.substr(0, text.find_first_of(" ;"));
+		auto res = new PGresult;
+		res->cmd_status = word;
+		std::transform(res->cmd_status.begin(), res->cmd_status.end(), res->cmd_status.begin(), [](char c) {
+			return (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+		});
+		if (word == "begin" || word == "start") {
+			conn->trans = PQTRANS_INTRANS;
+			return res;
+		}
+		if (word == "commit" || word == "end" || word == "rollback" || word == "abort") {
+			if (conn->trans == PQTRANS_INERROR) {
+				res->cmd_status = "ROLLBACK";
+			}
+			conn->trans = PQTRANS_IDLE;
+			return res;
+		}
+		if (conn->trans == PQTRANS_INERROR) {
+			delete res;
+			return pg_error(conn, "25P02", "ERROR:  current transaction is aborted, commands ignored until end of transaction block");
+		}
+		if (word == "deallocate") {
+			for (size_t pos = 0; (pos = text.find("deallocate ", pos)) != std::string::npos;) {
+				pos += 11;
+				auto end = text.find_first_of(" ;", pos);
+				conn->prepared.erase(std::string(sql.substr(pos, end == std::string::npos ? std::string::npos : end - pos)));
+			}
+			return res;
+		}
+
+		auto m = driver::instance().match(sql, conn->host);
+		if (conn->pipeline) {
+			conn->pending_latency = (std::max)(conn->pending_latency, m.latency);
+		}
+		else {
+			simulate_latency(m.latency);
+		}
+		driver::instance().on_execute(m);
+		if (m.fail) {
+			delete res;
+			return pg_error(conn, m.fail->sql_state, "ERROR:  " + m.fail->message);
+		}
+		if (m.result->columns.empty()) {
+			res->cmd_tuples = "0";
+			return res;
+		}
+		res->status = PGRES_TUPLES_OK;
+		res->cmd_tuples = std::to_string(m.result->rows.size());
+		for (const auto& c : m.result->columns) {
+			res->names.push_back(c.name);
+			res->types.push_back(pg_type_of(c.type));
+		}
+		for (const auto& row : m.result->rows) {
+			auto& values = res->rows.emplace_back();
+			for (size_t i = 0; i < m.result->columns.size(); i++) {
+				if (i >= row.size() || row[i].is_null) {
+					values.emplace_back();
+				}
+				else {
+					values.emplace_back(pg_binary(row[i], m.result->columns[i].type));
+				}
+			}
+		}
+		return res;
+	}
+
+	inline PGresult* pg_prepare(PGconn* conn, const char* name, const char* query) {
+		if (pg_lost(conn)) {
+			return pg_error(conn, "08006", "server closed the connection unexpectedly");
+		}
+		driver::instance().on_prepare();
+		if (*name != '\0' && conn->prepared.count(name) != 0) {
+			return pg_error(conn, "42P05", std::string("ERROR:  prepared statement \"") + name + "\" already exists");
+		}
+		conn->prepared[name] = query;
+		return new PGresult;
+	}
+
+	inline PGresult* pg_exec_prepared(PGconn* conn, const char* name) {
+		auto iter = conn->prepared.find(name);
+		if (iter == conn->prepared.end()) {
+			return pg_error(conn, "26000", std::string("ERROR:  prepared statement \"") + name + "\" does not exist");
+		}
+		return pg_run(conn, iter->second);
+	}
+
+	// pipeline mode, results wait in the queue. statements after a failed one are skipped until the sync
+	inline int pg_queue(PGconn* conn, PGresult* res) {
+		if (conn->aborted) {
+			res->status = PGRES_PIPELINE_ABORTED;
+		}
+		else if (res->status == PGRES_FATAL_ERROR) {
+			conn->aborted = true;
+		}
+		conn->pending.push_back(res);
+		conn->pending.push_back(nullptr);
+		return 1;
+	}
+}
+
+inline PGconn* PQconnectdbParams(const char* const* keywords, const char* const* values, int) {
+	using namespace sqlcpp::mock;
+	auto conn = new PGconn;
+	for (size_t i = 0; keywords[i] != nullptr; i++) {
+		if (std::strcmp(keywords[i], "host") == 0) {
+			conn->host = values[i];
+		}
+	}
+	driver::instance().on_connect();
+	if (driver::instance().is_host_down(conn->host)) {
+		conn->status = CONNECTION_BAD;
+		conn->error = "connection to server at \"" + conn->host + "\" failed: Connection refused\n";
+	}
+	return conn;
+}
+
+inline ConnStatusType PQstatus(const PGconn* conn) {
+	return conn->status;
+}
+
+inline char* PQerrorMessage(const PGconn* conn) {
+	return const_cast<char*>(conn->error.c_str());
+}
+
+inline void PQfinish(PGconn* conn) {
+	delete conn;
+}
+
+inline PGTransactionStatusType PQtransactionStatus(const PGconn* conn) {
+	return conn->status == CONNECTION_BAD ? PQTRANS_UNKNOWN : conn->trans;
+}
+
+inline int PQsocket(const PGconn*) {
+	return -1;
+}
+
+inline PGresult* PQexec(PGconn* conn, const char* query) {
+	using namespace sqlcpp::mock::detail;
+	if (*query == '\0') {
+		if (pg_lost(conn)) {
+			return pg_error(conn, "08006", "server closed the connection unexpectedly");
+		}
+		auto res = new PGresult;
+		res->status = PGRES_EMPTY_QUERY;
+		return res;
+	}
+	return pg_run(conn, query);
+}
+
+inline PGresult* PQprepare(PGconn* conn, const char* name, const char* query, int, const Oid*) {
+	return sqlcpp::mock::detail::pg_prepare(conn, name, query);
+}
+
+inline PGresult* PQexecPrepared(PGconn* conn, const char* name, int, const char* const*, const int*, const int*, int) {
+	return sqlcpp::mock::detail::pg_exec_prepared(conn, name);
+}
+
+inline PGresult* PQexecParams(PGconn* conn, const char* command, int, const Oid*, const char* const*, const int*, const int*, int) {
+	sqlcpp::mock::driver::instance().on_prepare();
+	return sqlcpp::mock::detail::pg_run(conn, command);
+}
+
+inline int PQenterPipelineMode(PGconn* conn) {
+	conn->pipeline = true;
+	return 1;
+}
+
+inline int PQexitPipelineMode(PGconn* conn) {
+	if (!conn->pending.empty()) {
+		return 0;
+	}
+	conn->pipeline = false;
+	return 1;
+}
+
+inline int PQsendPrepare(PGconn* conn, const char* name, const char* query, int, const Oid*) {
+	using namespace sqlcpp::mock::detail;
+	return pg_queue(conn, conn->aborted ? new PGresult : pg_prepare(conn, name, query));
+}
+
+inline int PQsendQueryPrepared(PGconn* conn, const char* name, int, const char* const*, const int*, const int*, int) {
+	using namespace sqlcpp::mock::detail;
+	return pg_queue(conn, conn->aborted ? new PGresult : pg_exec_prepared(conn, name));
+}
+
+inline int PQsendQueryParams(PGconn* conn, const char* command, int, const Oid*, const char* const*, const int*, const int*, int) {
+	using namespace sqlcpp::mock::detail;
+	return pg_queue(conn, conn->aborted ? new PGresult : pg_run(conn, command));
+}
+
+inline int PQpipelineSync(PGconn* conn) {
+	auto res = new PGresult;
+	res->status = PGRES_PIPELINE_SYNC;
+	conn->pending.push_back(res);
+	conn->aborted = false;
+	sqlcpp::mock::detail::simulate_latency(conn->pending_latency);
+	conn->pending_latency = std::chrono::microseconds(0);
+	return 1;
+}
+
+inline int PQsetnonblocking(PGconn*, int) {
+	return 0;
+}
+
+inline int PQflush(PGconn*) {
+	return 0;
+}
+
+inline int PQconsumeInput(PGconn*) {
+	return 1;
+}
+
+inline PGresult* PQgetResult(PGconn* conn) {
+	if (conn->pending.empty()) {
+		return nullptr;
+	}
+	auto res = conn->pending.front();
+	conn->pending.pop_front();
+	return res;
+}
+
+inline ExecStatusType PQresultStatus(const PGresult* res) {
+	return res != nullptr ? res->status : PGRES_FATAL_ERROR;
+}
+
+inline char* PQresultErrorField(const PGresult* res, int field) {
+	if (field != PG_DIAG_SQLSTATE || res->sql_state.empty()) {
+		return nullptr;
+	}
+	return const_cast<char*>(res->sql_state.c_str());
+}
+
+inline char* PQresultErrorMessage(const PGresult* res) {
+	return const_cast<char*>(res->message.c_str());
+}
+
+inline char* PQcmdStatus(PGresult* res) {
+	return const_cast<char*>(res->cmd_status.c_str());
+}
+
+inline char* PQcmdTuples(PGresult* res) {
+	return const_cast<char*>(res->cmd_tuples.c_str());
+}
+
+inline int PQntuples(const PGresult* res) {
+	return (int)res->rows.size();
+}
+
+inline int PQnfields(const PGresult* res) {
+	return (int)res->names.size();
+}
+
+inline char* PQfname(const PGresult* res, int column) {
+	return const_cast<char*>(res->names[(size_t)column].c_str());
+}
+
+inline Oid PQftype(const PGresult* res, int column) {
+	return res->types[(size_t)column];
+}
+
+inline int PQgetisnull(const PGresult* res, int row, int column) {
+	return res->rows[(size_t)row][(size_t)column].has_value() ? 0 : 1;
+}
+
+inline char* PQgetvalue(const PGresult* res, int row, int column) {
+	const auto& v = res->rows[(size_t)row][(size_t)column];
+	return const_cast<char*>(v ? v->c_str() : "");
+}
+
+inline int PQgetlength(const PGresult* res, int row, int column) {
+	const auto& v = res->rows[(size_t)row][(size_t)column];
+	return v ? (int)v->length() : 0;
+}
+
+inline void PQclear(PGresult* res) {
+	delete res;
+}
@@ -0,0 +1,231 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstdint>
+#include <array>
+#include <type_traits>
+#include <unordered_map>
+#include "../reflect_sql.hpp"
+
+//in-process fake of libmysqlclient and ODBC, build with SQLCPP_MOCK_DRIVER defined.
+//statements are answered from canned result sets in memory, nothing goes to network,
+//so the library's own bind, fetch and allocation costs can be measured alone
+namespace sqlcpp::mock {
+	enum class column_type {
+		integer,
+		real,
+		text,
+		binary
+	};
+
+	struct column {
+		std::string name;
+		column_type type = column_type::text;
+		size_t size = 255; //declared size of text or binary, 0 is (max)
+	};
+
+	//one value, numbers are parsed once when the result set is built
+	struct cell {
+		bool is_null = true;
+		std::string text;
+		int64_t integer = 0;
+		double real = 0;
+
+		cell() = default;
+		cell(std::nullopt_t) {}
+
+		template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+		cell(T v) :is_null(false), text(std::to_string(v)), integer((int64_t)v), real((double)v) {}
+
+		cell(std::string v) :is_null(false), text(std::move(v)) {
+			integer = std::strtoll(text.c_str(), nullptr, 10);
+			real = std::strtod(text.c_str(), nullptr);
+		}
+
+		cell(const char* v) :cell(std::string(v)) {}
+	};
+
+	struct result_set {
+		std::vector<column> columns;
+		std::vector<std::vector<cell>> rows;
+	};
+
+	struct error {
+		int code = 0; //native error
+		std::string sql_state = "HY000";
+		std::string message = "mock error";
+	};
+
+	struct driver_stats {
+		uint64_t connects = 0;
+		uint64_t prepares = 0;
+		uint64_t executes = 0;
+		uint64_t rows = 0; //rows of results served
+	};
+
+	class driver {
+	private:
+		struct rule {
+			std::string pattern;
+			std::shared_ptr<const result_set> result;
+			std::optional<std::chrono::microseconds> latency;
+			std::optional<error> fail;
+		};
+
+		std::mutex mtx_;
+		std::vector<rule> rules_;
+		std::unordered_map<std::string, std::chrono::microseconds> host_latency_;
+		std::unordered_map<std::string, bool> down_hosts_;
+		std::atomic<size_t> down_count_ = 0;
+		std::chrono::microseconds latency_{ 0 };
+		std::atomic<uint64_t> connects_ = 0;
+		std::atomic<uint64_t> prepares_ = 0;
+		std::atomic<uint64_t> executes_ = 0;
+		std::atomic<uint64_t> rows_ = 0;
+	public:
+		struct matched {
+			std::shared_ptr<const result_set> result;
+			std::chrono::microseconds latency{ 0 };
+			std::optional<error> fail;
+		};
+
+		static driver& instance() {
+			static driver d;
+			return d;
+		}
+
+		// statements containing pattern return result. the first added rule wins, so add specific ones first
+		void on(std::string pattern, result_set result, std::optional<std::chrono::microseconds> latency = {}) {
+			std::lock_guard<std::mutex> lock(mtx_);
+			rules_.push_back({ std::move(pattern), std::make_shared<const result_set>(std::move(result)), latency, {} });
+		}
+
+		// statements containing pattern fail with e, like a deadlock {1213, "40001", "..."}
+		void fail(std::string pattern, error e, std::optional<std::chrono::microseconds> latency = {}) {
+			std::lock_guard<std::mutex> lock(mtx_);
+			rules_.push_back({ std::move(pattern), std::make_shared<const result_set>(), latency, std::move(e) });
+		}
+
+		// latency of every statement without its own
+		void set_latency(std::chrono::microseconds latency) {
+			std::lock_guard<std::mutex> lock(mtx_);
+			latency_ = latency;
+		}
+
+		// slow node, used when the rule has no latency
+		void set_host_latency(const std::string& host, std::chrono::microseconds latency) {
+			std::lock_guard<std::mutex> lock(mtx_);
+			host_latency_[host] = latency;
+		}
+
+		// connecting to a down host fails, its connections are dead
+		void set_host_down(const std::string& host, bool down) {
+			std::lock_guard<std::mutex> lock(mtx_);
+			auto& d = down_hosts_[host];
+			if (d != down) {
+				d = down;
+				down ? down_count_++ : down_count_--;
+			}
+		}
+
+		bool is_host_down(const std::string& host) {
+			if (down_count_ == 0) {
+				return false;
+			}
+			std::lock_guard<std::mutex> lock(mtx_);
+			auto iter = down_hosts_.find(host);
+			return iter != down_hosts_.end() && iter->second;
+		}
+
+		// drop rules, latency, down hosts and stats
+		void reset() {
+			std::lock_guard<std::mutex> lock(mtx_);
+			rules_.clear();
+			host_latency_.clear();
+			down_hosts_.clear();
+			down_count_ = 0;
+			latency_ = std::chrono::microseconds(0);
+			connects_ = 0;
+			prepares_ = 0;
+			executes_ = 0;
+			rows_ = 0;
+		}
+
+		driver_stats get_stats() const {
+			return { connects_.load(), prepares_.load(), executes_.load(), rows_.load() };
+		}
+
+		// used by the shim
+		matched match(std::string_view sql, const std::string& host) {
+			static const auto empty = std::make_shared<const result_set>();
+			std::lock_guard<std::mutex> lock(mtx_);
+			matched m{ empty, latency_, {} };
+			if (auto iter = host_latency_.find(host); iter != host_latency_.end()) {
+				m.latency = iter->second;
+			}
+			for (const auto& r : rules_) {
+				if (sql.find(r.pattern) != std::string_view::npos) {
+					m.result = r.result;
+					m.latency = r.latency.value_or(m.latency);
+					m.fail = r.fail;
+					break;
+				}
+			}
+			return m;
+		}
+
+		void on_connect() {
+			connects_++;
+		}
+
+		void on_prepare() {
+			prepares_++;
+		}
+
+		void on_execute(const matched& m) {
+			executes_++;
+			rows_ += m.result->rows.size();
+		}
+	};
+
+	namespace detail {
+		inline void simulate_latency(std::chrono::microseconds latency) {
+			if (latency.count() > 0) {
+				std::this_thread::sleep_for(latency);
+			}
+		}
+
+		inline std::string lower(std::string_view s) {
+			std::string r(s);
+			for (auto& c : r) {
+				if (c >= 'A' && c <= 'Z') {
+					c = c - 'A' + 'a';
+				}
+			}
+			return r;
+		}
+
+		// YYYY-MM-DD hh:mm:ss.ffffff, missing parts are 0
+		inline std::array<unsigned int, 7> parse_time(const std::string& text) {
+			std::array<unsigned int, 7> parts{};
+			size_t index = 0;
+			for (size_t i = 0; i < text.length() && index < parts.size(); i++) {
+				if (text[i] >= '0' && text[i] <= '9') {
+					parts[index] = parts[index] * 10 + (unsigned int)(text[i] - '0');
+				}
+				else if (i > 0 && text[i - 1] >= '0' && text[i - 1] <= '9') {
+					index++;
+				}
+			}
+			return parts;
+		}
+	}
+}
@@ -0,0 +1,427 @@
+#pragma once
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include "mock_driver.hpp"
+
+//the part of libmysqlclient used by mysql_connection.hpp, answered by sqlcpp::mock::driver
+enum enum_field_types {
+	MYSQL_TYPE_DECIMAL, MYSQL_TYPE_TINY, MYSQL_TYPE_SHORT, MYSQL_TYPE_LONG, MYSQL_TYPE_FLOAT, MYSQL_TYPE_DOUBLE,
+	MYSQL_TYPE_NULL, MYSQL_TYPE_TIMESTAMP, MYSQL_TYPE_LONGLONG, MYSQL_TYPE_INT24, MYSQL_TYPE_DATE, MYSQL_TYPE_TIME,
+	MYSQL_TYPE_DATETIME, MYSQL_TYPE_YEAR, MYSQL_TYPE_NEWDATE, MYSQL_TYPE_VARCHAR, MYSQL_TYPE_BIT,
+	MYSQL_TYPE_JSON = 245, MYSQL_TYPE_NEWDECIMAL = 246, MYSQL_TYPE_ENUM = 247, MYSQL_TYPE_SET = 248,
+	MYSQL_TYPE_TINY_BLOB = 249, MYSQL_TYPE_MEDIUM_BLOB = 250, MYSQL_TYPE_LONG_BLOB = 251, MYSQL_TYPE_BLOB = 252,
+	MYSQL_TYPE_VAR_STRING = 253, MYSQL_TYPE_STRING = 254
+};
+
+enum mysql_option {
+	MYSQL_OPT_CONNECT_TIMEOUT,
+	MYSQL_OPT_RECONNECT = 20
+};
+
+#define SERVER_STATUS_IN_TRANS 1
+#define MYSQL_NO_DATA 100
+#define MYSQL_DATA_TRUNCATED 101
+
+struct MYSQL_TIME {
+	unsigned int year, month, day, hour, minute, second;
+	unsigned long second_part;
+	bool neg;
+	int time_type;
+};
+
+struct MYSQL_BIND {
+	unsigned long* length;
+	bool* is_null;
+	void* buffer;
+	bool* error;
+	unsigned long buffer_length;
+	enum enum_field_types buffer_type;
+	bool is_unsigned;
+};
+
+struct MYSQL_FIELD {
+	char* name;
+	unsigned int name_length;
+	enum enum_field_types type;
+};
+
+struct MYSQL {
+	unsigned int server_status = 0;
+	std::string host;
+	unsigned int error_code = 0;
+	std::string error;
+	std::string sql_state = "00000";
+	std::shared_ptr<const sqlcpp::mock::result_set> result; //of the last mysql_query, for mysql_use_result
+};
+
+struct MYSQL_STMT {
+	MYSQL* mysql = nullptr;
+	std::string sql;
+	unsigned long param_count = 0;
+	std::shared_ptr<const sqlcpp::mock::result_set> result;
+	size_t cursor = 0;
+	std::vector<MYSQL_BIND> result_binds;
+	unsigned int error_code = 0;
+	std::string error;
+	std::string sql_state = "00000";
+};
+
+struct MYSQL_RES {
+	std::vector<std::string> names;
+	std::vector<MYSQL_FIELD> fields;
+	//rows of mysql_use_result
+	std::shared_ptr<const sqlcpp::mock::result_set> result;
+	size_t cursor = 0;
+	std::vector<char*> row;
+	std::vector<unsigned long> lengths;
+};
+
+typedef char** MYSQL_ROW;
+
+namespace sqlcpp::mock::detail {
+	template<typename Handle>
+	inline void set_error(Handle* h, unsigned int code, std::string sql_state, std::string message) {
+		h->error_code = code;
+		h->sql_state = std::move(sql_state);
+		h->error = std::move(message);
+	}
+
+	// server errors of a statement are on its connection too, like libmysqlclient
+	inline void set_error(MYSQL_STMT* stmt, unsigned int code, std::string sql_state, std::string message) {
+		set_error(stmt->mysql, code, sql_state, message);
+		stmt->error_code = code;
+		stmt->sql_state = std::move(sql_state);
+		stmt->error = std::move(message);
+	}
+
+	template<typename Handle>
+	inline void clear_error(Handle* h) {
+		if (h->error_code != 0) {
+			set_error(h, 0, "00000", "");
+		}
+	}
+
+	template<typename Handle>
+	inline bool host_lost(Handle* h, const std::string& host) {
+		if (driver::instance().is_host_down(host)) {
+			set_error(h, 2013, "HY000", "Lost connection to MySQL server during query");
+			return true;
+		}
+		return false;
+	}
+
+	inline bool write_mysql_value(const cell& c, MYSQL_BIND& bind) {
+		if (bind.buffer_type == MYSQL_TYPE_NULL) { //dummy bind
+			return false;
+		}
+		if (bind.is_null != nullptr) {
+			*bind.is_null = c.is_null;
+		}
+		if (c.is_null) {
+			return false;
+		}
+
+		auto write = [&bind](auto v) {
+			std::memcpy(bind.buffer, &v, sizeof(v));
+		};
+		switch (bind.buffer_type) {
+		case MYSQL_TYPE_TINY:
+			write((int8_t)c.integer);
+			return false;
+		case MYSQL_TYPE_SHORT:
+			write((int16_t)c.integer);
+			return false;
+		case MYSQL_TYPE_LONG:
+			write((int32_t)c.integer);
+			return false;
+		case MYSQL_TYPE_LONGLONG:
+			write((int64_t)c.integer);
+			return false;
+		case MYSQL_TYPE_FLOAT:
+			write((float)c.real);
+			return false;
+		case MYSQL_TYPE_DOUBLE:
+			write(c.real);
+			return false;
+		case MYSQL_TYPE_TIMESTAMP:
+		case MYSQL_TYPE_DATETIME:
+		case MYSQL_TYPE_DATE: {
+			auto parts = parse_time(c.text);
+			MYSQL_TIME t{ parts[0], parts[1], parts[2], parts[3], parts[4], parts[5], parts[6], false, 0 };
+			write(t);
+			return false;
+		}
+		default: { //strings and blobs
+			auto length = (unsigned long)c.text.length();
+			std::memcpy(bind.buffer, c.text.data(), (std::min)(length, bind.buffer_length));
+			if (bind.length != nullptr) {
+				*bind.length = length;
+			}
+			return length > bind.buffer_length;
+		}
+		}
+	}
+}
+
+inline MYSQL* mysql_init(MYSQL*) {
+	return new MYSQL();
+}
+
+inline int mysql_options(MYSQL*, enum mysql_option, const void*) {
+	return 0;
+}
+
+inline MYSQL* mysql_real_connect(MYSQL* mysql, const char* host, const char*, const char*, const char*, unsigned int, const char*, unsigned long) {
+	using namespace sqlcpp::mock;
+	driver::instance().on_connect();
+	mysql->host = host == nullptr ? "" : host;
+	if (driver::instance().is_host_down(mysql->host)) {
+		detail::set_error(mysql, 2003, "HY000", "Can't connect to MySQL server on '" + mysql->host + "'");
+		return nullptr;
+	}
+	detail::clear_error(mysql);
+	return mysql;
+}
+
+inline void mysql_close(MYSQL* mysql) {
+	delete mysql;
+}
+
+inline int mysql_ping(MYSQL* mysql) {
+	using namespace sqlcpp::mock;
+	detail::clear_error(mysql);
+	return detail::host_lost(mysql, mysql->host) ? 1 : 0;
+}
+
+inline int mysql_query(MYSQL* mysql, const char* sql) {
+	using namespace sqlcpp::mock;
+	detail::clear_error(mysql);
+	if (detail::host_lost(mysql, mysql->host)) {
+		return 1;
+	}
+	auto m = driver::instance().match(sql, mysql->host);
+	detail::simulate_latency(m.latency);
+	driver::instance().on_execute(m);
+	if (m.fail) {
+		detail::set_error(mysql, (unsigned int)m.fail->code, m.fail->sql_state, m.fail->message);
+		return 1;
+	}
+	mysql->result = m.result;
+
+	auto statement = detail::lower(sql);
+	if (statement.rfind("start transaction", 0) == 0 || statement.rfind("begin", 0) == 0) {
+		mysql->server_status |= SERVER_STATUS_IN_TRANS;
+	}
+	else if (statement.rfind("commit", 0) == 0 || statement.rfind("rollback", 0) == 0) {
+		mysql->server_status &= ~SERVER_STATUS_IN_TRANS;
+	}
+	return 0;
+}
+
+inline int mysql_real_query(MYSQL* mysql, const char* sql, unsigned long length) {
+	return mysql_query(mysql, std::string(sql, length).c_str());
+}
+
+// text protocol result, every value is its text
+inline MYSQL_RES* mysql_use_result(MYSQL* mysql) {
+	using sqlcpp::mock::column_type;
+	if (mysql->result == nullptr || mysql->result->columns.empty()) {
+		return nullptr;
+	}
+	auto res = new MYSQL_RES();
+	res->result = std::move(mysql->result);
+	for (const auto& c : res->result->columns) {
+		res->names.push_back(c.name);
+	}
+	for (size_t i = 0; i < res->names.size(); i++) {
+		auto type = res->result->columns[i].type;
+		auto field_type = type == column_type::integer ? MYSQL_TYPE_LONGLONG
+			: type == column_type::real ? MYSQL_TYPE_DOUBLE
+			: type == column_type::binary ? MYSQL_TYPE_BLOB : MYSQL_TYPE_VAR_STRING;
+		res->fields.push_back({ res->names[i].data(), (unsigned int)res->names[i].length(), field_type });
+	}
+	res->row.resize(res->names.size());
+	res->lengths.resize(res->names.size());
+	return res;
+}
+
+inline MYSQL_ROW mysql_fetch_row(MYSQL_RES* res) {
+	if (res->result == nullptr || res->cursor >= res->result->rows.size()) {
+		return nullptr;
+	}
+	const auto& row = res->result->rows[res->cursor++];
+	for (size_t i = 0; i < res->row.size(); i++) {
+		auto null = i >= row.size() || row[i].is_null;
+		res->row[i] = null ? nullptr : const_cast<char*>(row[i].text.data());
+		res->lengths[i] = null ? 0 : (unsigned long)row[i].text.length();
+	}
+	return res->row.data();
+}
+
+inline unsigned long* mysql_fetch_lengths(MYSQL_RES* res) {
+	return res->lengths.data();
+}
+
+inline const char* mysql_error(MYSQL* mysql) {
+	return mysql->error.c_str();
+}
+
+inline unsigned int mysql_errno(MYSQL* mysql) {
+	return mysql->error_code;
+}
+
+inline int mysql_reset_connection(MYSQL* mysql) {
+	using namespace sqlcpp::mock;
+	detail::clear_error(mysql);
+	if (detail::host_lost(mysql, mysql->host)) {
+		return 1;
+	}
+	mysql->server_status = 0;
+	return 0;
+}
+
+inline MYSQL_STMT* mysql_stmt_init(MYSQL* mysql) {
+	auto stmt = new MYSQL_STMT();
+	stmt->mysql = mysql;
+	return stmt;
+}
+
+inline bool mysql_stmt_close(MYSQL_STMT* stmt) {
+	delete stmt;
+	return false;
+}
+
+inline int mysql_stmt_prepare(MYSQL_STMT* stmt, const char* sql, unsigned long length) {
+	using namespace sqlcpp::mock;
+	detail::clear_error(stmt);
+	if (detail::host_lost(stmt, stmt->mysql->host)) {
+		return 1;
+	}
+	driver::instance().on_prepare();
+	stmt->sql.assign(sql, length);
+	stmt->param_count = (unsigned long)sqlcpp::sql::count_placeholders(stmt->sql);
+	stmt->result = driver::instance().match(stmt->sql, stmt->mysql->host).result;
+	stmt->cursor = 0;
+	stmt->result_binds.clear();
+	return 0;
+}
+
+inline unsigned long mysql_stmt_param_count(MYSQL_STMT* stmt) {
+	return stmt->param_count;
+}
+
+inline unsigned int mysql_stmt_field_count(MYSQL_STMT* stmt) {
+	return stmt->result == nullptr ? 0 : (unsigned int)stmt->result->columns.size();
+}
+
+inline MYSQL_RES* mysql_stmt_result_metadata(MYSQL_STMT* stmt) {
+	using sqlcpp::mock::column_type;
+	if (mysql_stmt_field_count(stmt) == 0) { //no result set, like insert
+		return nullptr;
+	}
+	auto res = new MYSQL_RES();
+	for (const auto& c : stmt->result->columns) {
+		res->names.push_back(c.name);
+	}
+	for (size_t i = 0; i < res->names.size(); i++) {
+		auto type = stmt->result->columns[i].type;
+		auto field_type = type == column_type::integer ? MYSQL_TYPE_LONGLONG
+			: type == column_type::real ? MYSQL_TYPE_DOUBLE
+			: type == column_type::binary ? MYSQL_TYPE_BLOB : MYSQL_TYPE_VAR_STRING;
+		res->fields.push_back({ res->names[i].data(), (unsigned int)res->names[i].length(), field_type });
+	}
+	return res;
+}
+
+inline void mysql_free_result(MYSQL_RES* res) {
+	delete res;
+}
+
+inline unsigned int mysql_num_fields(MYSQL_RES* res) {
+	return (unsigned int)res->fields.size();
+}
+
+inline MYSQL_FIELD* mysql_fetch_fields(MYSQL_RES* res) {
+	return res->fields.data();
+}
+
+inline bool mysql_stmt_bind_param(MYSQL_STMT*, MYSQL_BIND*) {
+	return false;
+}
+
+inline bool mysql_stmt_bind_result(MYSQL_STMT* stmt, MYSQL_BIND* binds) {
+	stmt->result_binds.assign(binds, binds + mysql_stmt_field_count(stmt));
+	return false;
+}
+
+inline int mysql_stmt_execute(MYSQL_STMT* stmt) {
+	using namespace sqlcpp::mock;
+	detail::clear_error(stmt);
+	if (detail::host_lost(stmt, stmt->mysql->host)) {
+		return 1;
+	}
+	auto m = driver::instance().match(stmt->sql, stmt->mysql->host);
+	detail::simulate_latency(m.latency);
+	driver::instance().on_execute(m);
+	if (m.fail) {
+		detail::set_error(stmt, (unsigned int)m.fail->code, m.fail->sql_state, m.fail->message);
+		return 1;
+	}
+	stmt->result = m.result;
+	stmt->cursor = 0;
+	return 0;
+}
+
+inline int mysql_stmt_store_result(MYSQL_STMT*) {
+	return 0;
+}
+
+inline uint64_t mysql_stmt_num_rows(MYSQL_STMT* stmt) {
+	return stmt->result == nullptr ? 0 : stmt->result->rows.size();
+}
+
+inline int mysql_stmt_fetch(MYSQL_STMT* stmt) {
+	if (stmt->result == nullptr || stmt->cursor >= stmt->result->rows.size()) {
+		return MYSQL_NO_DATA;
+	}
+	const auto& row = stmt->result->rows[stmt->cursor++];
+	bool truncated = false;
+	for (size_t i = 0; i < stmt->result_binds.size() && i < row.size(); i++) {
+		truncated |= sqlcpp::mock::detail::write_mysql_value(row[i], stmt->result_binds[i]);
+	}
+	return truncated ? MYSQL_DATA_TRUNCATED : 0;
+}
+
+//the last fetched row again, offset is not supported
+inline int mysql_stmt_fetch_column(MYSQL_STMT* stmt, MYSQL_BIND* bind, unsigned int column, unsigned long) {
+	if (stmt->result == nullptr || stmt->cursor == 0 || column >= stmt->result->rows[stmt->cursor - 1].size()) {
+		return 1;
+	}
+	sqlcpp::mock::detail::write_mysql_value(stmt->result->rows[stmt->cursor - 1][column], *bind);
+	return 0;
+}
+
+inline bool mysql_stmt_free_result(MYSQL_STMT* stmt) {
+	if (stmt->result != nullptr) {
+		stmt->cursor = stmt->result->rows.size();
+	}
+	return false;
+}
+
+inline uint64_t mysql_stmt_insert_id(MYSQL_STMT*) {
+	return 0;
+}
+
+inline unsigned int mysql_stmt_errno(MYSQL_STMT* stmt) {
+	return stmt->error_code;
+}
+
+inline const char* mysql_stmt_error(MYSQL_STMT* stmt) {
+	return stmt->error.c_str();
+}
+
+inline const char* mysql_stmt_sqlstate(MYSQL_STMT* stmt) {
+	return stmt->sql_state.c_str();
+}
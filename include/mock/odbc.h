@@ -0,0 +1,604 @@
+#pragma once
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <optional>
+#include "mock_driver.hpp"
+
+//the part of ODBC(sql.h and sqlext.h) used by sqlserver_connection.hpp, answered by sqlcpp::mock::driver
+typedef short SQLSMALLINT;
+typedef unsigned short SQLUSMALLINT;
+typedef int SQLINTEGER;
+typedef unsigned int SQLUINTEGER;
+typedef int64_t SQLLEN;
+typedef uint64_t SQLULEN;
+typedef short SQLRETURN;
+typedef void* SQLPOINTER;
+typedef unsigned char SQLCHAR;
+typedef void* SQLHANDLE;
+typedef SQLHANDLE SQLHENV;
+typedef SQLHANDLE SQLHDBC;
+typedef SQLHANDLE SQLHSTMT;
+typedef void* SQLHWND;
+
+typedef struct {
+	SQLSMALLINT year;
+	SQLUSMALLINT month;
+	SQLUSMALLINT day;
+} SQL_DATE_STRUCT;
+
+typedef struct {
+	SQLSMALLINT year;
+	SQLUSMALLINT month;
+	SQLUSMALLINT day;
+	SQLUSMALLINT hour;
+	SQLUSMALLINT minute;
+	SQLUSMALLINT second;
+	SQLUINTEGER fraction;
+} SQL_TIMESTAMP_STRUCT;
+
+#define SQL_SUCCESS 0
+#define SQL_SUCCESS_WITH_INFO 1
+#define SQL_STILL_EXECUTING 2
+#define SQL_NO_DATA 100
+#define SQL_ERROR (-1)
+#define SQL_INVALID_HANDLE (-2)
+#define SQL_NULL_DATA (-1)
+#define SQL_NO_TOTAL (-4)
+#define SQL_NTS (-3)
+#define SQL_NULL_HANDLE 0
+#define SQL_NULL_HENV 0
+#define SQL_NULL_HDBC 0
+#define SQL_NULL_HSTMT 0
+#define SQL_HANDLE_ENV 1
+#define SQL_HANDLE_DBC 2
+#define SQL_HANDLE_STMT 3
+#define SQL_CLOSE 0
+#define SQL_UNBIND 2
+#define SQL_RESET_PARAMS 3
+#define SQL_SQLSTATE_SIZE 5
+#define SQL_IS_UINTEGER (-5)
+
+#define SQL_CHAR 1
+#define SQL_INTEGER 4
+#define SQL_SMALLINT 5
+#define SQL_REAL 7
+#define SQL_DOUBLE 8
+#define SQL_VARCHAR 12
+#define SQL_TYPE_DATE 91
+#define SQL_TYPE_TIMESTAMP 93
+#define SQL_LONGVARCHAR (-1)
+#define SQL_BINARY (-2)
+#define SQL_VARBINARY (-3)
+#define SQL_LONGVARBINARY (-4)
+#define SQL_BIGINT (-5)
+#define SQL_TINYINT (-6)
+#define SQL_NULLABLE 1
+
+#define SQL_C_CHAR SQL_CHAR
+#define SQL_C_BINARY SQL_BINARY
+#define SQL_C_STINYINT (-26)
+#define SQL_C_UTINYINT (-28)
+#define SQL_C_SSHORT (-15)
+#define SQL_C_USHORT (-17)
+#define SQL_C_SLONG (-16)
+#define SQL_C_ULONG (-18)
+#define SQL_C_FLOAT SQL_REAL
+#define SQL_C_DOUBLE SQL_DOUBLE
+#define SQL_C_SBIGINT (-25)
+#define SQL_C_UBIGINT (-27)
+#define SQL_C_TYPE_DATE SQL_TYPE_DATE
+#define SQL_C_TYPE_TIMESTAMP SQL_TYPE_TIMESTAMP
+
+#define SQL_ATTR_ODBC_VERSION 200
+#define SQL_ATTR_CONNECTION_POOLING 201
+#define SQL_ATTR_CP_MATCH 202
+#define SQL_OV_ODBC3 3UL
+#define SQL_CP_OFF 0UL
+#define SQL_CP_ONE_PER_DRIVER 1UL
+#define SQL_CP_ONE_PER_HENV 2UL
+#define SQL_CP_RELAXED_MATCH 1UL
+#define SQL_LOGIN_TIMEOUT 103
+#define SQL_ATTR_CONNECTION_DEAD 1209
+#define SQL_CD_TRUE 1L
+#define SQL_CD_FALSE 0L
+#define SQL_DRIVER_NOPROMPT 0
+#define SQL_PARAM_INPUT 1
+
+#define SQL_ATTR_ASYNC_ENABLE 4
+#define SQL_ASYNC_ENABLE_OFF 0UL
+#define SQL_ASYNC_ENABLE_ON 1UL
+#define SQL_ATTR_ROW_BIND_TYPE 5
+#define SQL_BIND_BY_COLUMN 0UL
+#define SQL_ATTR_PARAM_BIND_TYPE 18
+#define SQL_PARAM_BIND_BY_COLUMN 0UL
+#define SQL_ATTR_PARAM_STATUS_PTR 20
+#define SQL_ATTR_PARAMS_PROCESSED_PTR 21
+#define SQL_ATTR_PARAMSET_SIZE 22
+#define SQL_ATTR_ROW_STATUS_PTR 25
+#define SQL_ATTR_ROWS_FETCHED_PTR 26
+#define SQL_ATTR_ROW_ARRAY_SIZE 27
+#define SQL_PARAM_SUCCESS 0
+#define SQL_PARAM_ERROR 5
+#define SQL_ROW_SUCCESS 0
+#define SQL_ROW_ERROR 5
+#define SQL_ROW_NOROW 3
+
+namespace sqlcpp::mock::detail {
+	struct odbc_handle {
+		SQLSMALLINT type;
+		std::optional<error> diag;
+
+		explicit odbc_handle(SQLSMALLINT t) :type(t) {}
+
+		SQLRETURN set_error(std::string sql_state, int code, std::string message) {
+			diag = error{ code, std::move(sql_state), std::move(message) };
+			return SQL_ERROR;
+		}
+	};
+
+	struct odbc_dbc :odbc_handle {
+		std::string host;
+		odbc_dbc() :odbc_handle(SQL_HANDLE_DBC) {}
+
+		bool lost() {
+			return driver::instance().is_host_down(host);
+		}
+	};
+
+	struct odbc_stmt :odbc_handle {
+		struct bound_column {
+			SQLSMALLINT c_type = 0;
+			char* data = nullptr;
+			SQLLEN width = 0;
+			SQLLEN* ind = nullptr;
+		};
+
+		struct get_data_state {
+			size_t offset = 0;
+			bool done = false;
+		};
+
+		odbc_dbc* dbc;
+		std::string sql;
+		SQLSMALLINT param_count = 0;
+		std::shared_ptr<const result_set> result = std::make_shared<const result_set>();
+		bool cursor_open = false;
+		size_t cursor = 0; //next row to fetch
+		size_t current_row = 0; //row of SQLGetData
+		std::vector<bound_column> columns; //by column number
+		std::vector<get_data_state> get_data;
+		SQLULEN row_array_size = 1;
+		SQLULEN* rows_fetched = nullptr;
+		SQLUSMALLINT* row_status = nullptr;
+		SQLULEN paramset_size = 1;
+		SQLUSMALLINT* param_status = nullptr;
+		SQLULEN* params_processed = nullptr;
+		bool async = false;
+		std::optional<std::chrono::steady_clock::time_point> async_deadline;
+
+		explicit odbc_stmt(odbc_dbc* d) :odbc_handle(SQL_HANDLE_STMT), dbc(d) {}
+
+		SQLRETURN lost() {
+			return set_error("08S01", 10054, "Communication link failure");
+		}
+	};
+
+	inline odbc_handle* odbc_cast(SQLHANDLE h) {
+		auto handle = (odbc_handle*)h;
+		handle->diag.reset(); //every call clears diagnostics of its handle
+		return handle;
+	}
+
+	// fixed size c types write sizeof bytes, char and binary write up to width and give the full length in ind
+	inline bool write_odbc_value(const cell& c, SQLSMALLINT c_type, char* p, SQLLEN width, SQLLEN* ind) {
+		auto write = [p, ind](auto v) {
+			std::memcpy(p, &v, sizeof(v));
+			if (ind != nullptr) {
+				*ind = (SQLLEN)sizeof(v);
+			}
+			return false;
+		};
+		if (c.is_null) {
+			if (ind != nullptr) {
+				*ind = SQL_NULL_DATA;
+			}
+			return false;
+		}
+		switch (c_type) {
+		case SQL_C_STINYINT:
+		case SQL_C_UTINYINT:
+			return write((int8_t)c.integer);
+		case SQL_C_SSHORT:
+		case SQL_C_USHORT:
+			return write((int16_t)c.integer);
+		case SQL_C_SLONG:
+		case SQL_C_ULONG:
+			return write((int32_t)c.integer);
+		case SQL_C_SBIGINT:
+		case SQL_C_UBIGINT:
+			return write((int64_t)c.integer);
+		case SQL_C_FLOAT:
+			return write((float)c.real);
+		case SQL_C_DOUBLE:
+			return write(c.real);
+		case SQL_C_TYPE_DATE: {
+			auto parts = parse_time(c.text);
+			return write(SQL_DATE_STRUCT{ (SQLSMALLINT)parts[0], (SQLUSMALLINT)parts[1], (SQLUSMALLINT)parts[2] });
+		}
+		case SQL_C_TYPE_TIMESTAMP: {
+			auto parts = parse_time(c.text);
+			return write(SQL_TIMESTAMP_STRUCT{ (SQLSMALLINT)parts[0], (SQLUSMALLINT)parts[1], (SQLUSMALLINT)parts[2],
+				(SQLUSMALLINT)parts[3], (SQLUSMALLINT)parts[4], (SQLUSMALLINT)parts[5], parts[6] * 1000 });
+		}
+		default: { //SQL_C_CHAR and SQL_C_BINARY
+			auto terminator = c_type == SQL_C_CHAR ? 1 : 0;
+			auto capacity = (size_t)(width > terminator ? width - terminator : 0);
+			auto length = (std::min)(c.text.length(), capacity);
+			std::memcpy(p, c.text.data(), length);
+			if (terminator != 0 && width > 0) {
+				p[length] = '\0';
+			}
+			if (ind != nullptr) {
+				*ind = (SQLLEN)c.text.length();
+			}
+			return c.text.length() > capacity;
+		}
+		}
+	}
+
+	inline SQLSMALLINT sql_type_of(const column& c) {
+		switch (c.type) {
+		case column_type::integer:
+			return SQL_BIGINT;
+		case column_type::real:
+			return SQL_DOUBLE;
+		case column_type::binary:
+			return c.size == 0 ? SQL_LONGVARBINARY : SQL_VARBINARY;
+		default:
+			return c.size == 0 ? SQL_LONGVARCHAR : SQL_VARCHAR;
+		}
+	}
+
+	inline SQLRETURN prepare(odbc_stmt* stmt, SQLCHAR* sql, SQLINTEGER length) {
+		if (stmt->dbc->lost()) {
+			return stmt->lost();
+		}
+		driver::instance().on_prepare();
+		stmt->sql = length == SQL_NTS ? std::string((char*)sql) : std::string((char*)sql, (size_t)length);
+		stmt->param_count = (SQLSMALLINT)sqlcpp::sql::count_placeholders(stmt->sql);
+		stmt->result = driver::instance().match(stmt->sql, stmt->dbc->host).result;
+		stmt->cursor_open = false;
+		stmt->async_deadline.reset();
+		return SQL_SUCCESS;
+	}
+
+	inline SQLRETURN execute(odbc_stmt* stmt) {
+		if (stmt->dbc->lost()) {
+			stmt->async_deadline.reset();
+			return stmt->lost();
+		}
+		auto m = driver::instance().match(stmt->sql, stmt->dbc->host);
+		if (stmt->async && m.latency.count() > 0) { //polled by SQLExecute until the latency passed
+			auto now = std::chrono::steady_clock::now();
+			if (!stmt->async_deadline) {
+				stmt->async_deadline = now + m.latency;
+			}
+			if (now < *stmt->async_deadline) {
+				return SQL_STILL_EXECUTING;
+			}
+			stmt->async_deadline.reset();
+		}
+		else {
+			simulate_latency(m.latency);
+		}
+
+		driver::instance().on_execute(m);
+		if (m.fail) {
+			for (SQLULEN i = 0; stmt->param_status != nullptr && i < stmt->paramset_size; i++) {
+				stmt->param_status[i] = SQL_PARAM_ERROR;
+			}
+			return stmt->set_error(m.fail->sql_state, m.fail->code, m.fail->message);
+		}
+		for (SQLULEN i = 0; stmt->param_status != nullptr && i < stmt->paramset_size; i++) {
+			stmt->param_status[i] = SQL_PARAM_SUCCESS;
+		}
+		if (stmt->params_processed != nullptr) {
+			*stmt->params_processed = stmt->paramset_size;
+		}
+		stmt->result = m.result;
+		stmt->cursor_open = true;
+		stmt->cursor = 0;
+		return SQL_SUCCESS;
+	}
+}
+
+inline SQLRETURN SQLAllocHandle(SQLSMALLINT type, SQLHANDLE input, SQLHANDLE* output) {
+	using namespace sqlcpp::mock::detail;
+	switch (type) {
+	case SQL_HANDLE_ENV:
+		*output = new odbc_handle(SQL_HANDLE_ENV);
+		return SQL_SUCCESS;
+	case SQL_HANDLE_DBC:
+		*output = new odbc_dbc();
+		return SQL_SUCCESS;
+	case SQL_HANDLE_STMT:
+		*output = new odbc_stmt((odbc_dbc*)input);
+		return SQL_SUCCESS;
+	default:
+		return SQL_ERROR;
+	}
+}
+
+inline SQLRETURN SQLFreeHandle(SQLSMALLINT type, SQLHANDLE handle) {
+	using namespace sqlcpp::mock::detail;
+	if (handle == nullptr) {
+		return SQL_INVALID_HANDLE;
+	}
+	if (type == SQL_HANDLE_DBC) {
+		delete (odbc_dbc*)handle;
+	}
+	else if (type == SQL_HANDLE_STMT) {
+		delete (odbc_stmt*)handle;
+	}
+	else {
+		delete (odbc_handle*)handle;
+	}
+	return SQL_SUCCESS;
+}
+
+inline SQLRETURN SQLSetEnvAttr(SQLHENV, SQLINTEGER, SQLPOINTER, SQLINTEGER) {
+	return SQL_SUCCESS;
+}
+
+inline SQLRETURN SQLSetConnectAttr(SQLHDBC, SQLINTEGER, SQLPOINTER, SQLINTEGER) {
+	return SQL_SUCCESS;
+}
+
+inline SQLRETURN SQLGetConnectAttr(SQLHDBC handle, SQLINTEGER attr, SQLPOINTER value, SQLINTEGER, SQLINTEGER*) {
+	auto dbc = (sqlcpp::mock::detail::odbc_dbc*)sqlcpp::mock::detail::odbc_cast(handle);
+	if (attr == SQL_ATTR_CONNECTION_DEAD) {
+		*(SQLUINTEGER*)value = dbc->lost() ? SQL_CD_TRUE : SQL_CD_FALSE;
+	}
+	return SQL_SUCCESS;
+}
+
+// the host is SERVER= of the connection string, without port
+inline SQLRETURN SQLDriverConnect(SQLHDBC handle, SQLHWND, SQLCHAR* in, SQLSMALLINT in_length, SQLCHAR*, SQLSMALLINT, SQLSMALLINT*, SQLUSMALLINT) {
+	using namespace sqlcpp::mock;
+	auto dbc = (detail::odbc_dbc*)detail::odbc_cast(handle);
+	std::string conn_str = in_length == SQL_NTS ? std::string((char*)in) : std::string((char*)in, (size_t)in_length);
+	auto lower = detail::lower(conn_str);
+	auto begin = lower.find("server=");
+	if (begin != std::string::npos) {
+		begin += 7;
+		dbc->host = conn_str.substr(begin, lower.find_first_of(";,", begin) - begin);
+	}
+	driver::instance().on_connect();
+	if (dbc->lost()) {
+		return dbc->set_error("08001", 53, "Server <" + dbc->host + "> is not found or not accessible");
+	}
+	return SQL_SUCCESS;
+}
+
+inline SQLRETURN SQLDisconnect(SQLHDBC) {
+	return SQL_SUCCESS;
+}
+
+inline SQLRETURN SQLPrepare(SQLHSTMT handle, SQLCHAR* sql, SQLINTEGER length) {
+	using namespace sqlcpp::mock::detail;
+	return prepare((odbc_stmt*)odbc_cast(handle), sql, length);
+}
+
+inline SQLRETURN SQLExecute(SQLHSTMT handle) {
+	using namespace sqlcpp::mock::detail;
+	return execute((odbc_stmt*)odbc_cast(handle));
+}
+
+inline SQLRETURN SQLExecDirect(SQLHSTMT handle, SQLCHAR* sql, SQLINTEGER length) {
+	using namespace sqlcpp::mock::detail;
+	auto stmt = (odbc_stmt*)odbc_cast(handle);
+	auto retcode = prepare(stmt, sql, length);
+	return retcode == SQL_SUCCESS ? execute(stmt) : retcode;
+}
+
+inline SQLRETURN SQLNumParams(SQLHSTMT handle, SQLSMALLINT* count) {
+	*count = ((sqlcpp::mock::detail::odbc_stmt*)handle)->param_count;
+	return SQL_SUCCESS;
+}
+
+inline SQLRETURN SQLNumResultCols(SQLHSTMT handle, SQLSMALLINT* count) {
+	*count = (SQLSMALLINT)((sqlcpp::mock::detail::odbc_stmt*)handle)->result->columns.size();
+	return SQL_SUCCESS;
+}
+
+inline SQLRETURN SQLDescribeCol(SQLHSTMT handle, SQLUSMALLINT number, SQLCHAR* name, SQLSMALLINT buffer_length,
+	SQLSMALLINT* name_length, SQLSMALLINT* data_type, SQLULEN* column_size, SQLSMALLINT* decimal_digits, SQLSMALLINT* nullable) {
+	using namespace sqlcpp::mock;
+	auto stmt = (detail::odbc_stmt*)detail::odbc_cast(handle);
+	if (number == 0 || number > stmt->result->columns.size()) {
+		return stmt->set_error("07009", 0, "Invalid descriptor index");
+	}
+	const auto& c = stmt->result->columns[number - 1];
+	if (name != nullptr && buffer_length > 0) {
+		auto length = (std::min)(c.name.length(), (size_t)buffer_length - 1);
+		std::memcpy(name, c.name.data(), length);
+		name[length] = '\0';
+	}
+	if (name_length != nullptr) {
+		*name_length = (SQLSMALLINT)c.name.length();
+	}
+	if (data_type != nullptr) {
+		*data_type = detail::sql_type_of(c);
+	}
+	if (column_size != nullptr) {
+		*column_size = c.type == column_type::integer ? 19 : c.type == column_type::real ? 15 : c.size;
+	}
+	if (decimal_digits != nullptr) {
+		*decimal_digits = 0;
+	}
+	if (nullable != nullptr) {
+		*nullable = SQL_NULLABLE;
+	}
+	return SQL_SUCCESS;
+}
+
+inline SQLRETURN SQLBindParameter(SQLHSTMT, SQLUSMALLINT, SQLSMALLINT, SQLSMALLINT, SQLSMALLINT, SQLULEN, SQLSMALLINT, SQLPOINTER, SQLLEN, SQLLEN*) {
+	return SQL_SUCCESS;
+}
+
+inline SQLRETURN SQLBindCol(SQLHSTMT handle, SQLUSMALLINT number, SQLSMALLINT c_type, SQLPOINTER value, SQLLEN width, SQLLEN* ind) {
+	using namespace sqlcpp::mock::detail;
+	auto stmt = (odbc_stmt*)odbc_cast(handle);
+	if (number == 0) {
+		return stmt->set_error("07009", 0, "Invalid descriptor index");
+	}
+	if (stmt->columns.size() < number) {
+		stmt->columns.resize(number);
+	}
+	stmt->columns[number - 1] = { c_type, (char*)value, width, ind };
+	return SQL_SUCCESS;
+}
+
+inline SQLRETURN SQLSetStmtAttr(SQLHSTMT handle, SQLINTEGER attr, SQLPOINTER value, SQLINTEGER) {
+	auto stmt = (sqlcpp::mock::detail::odbc_stmt*)handle;
+	switch (attr) {
+	case SQL_ATTR_ROW_ARRAY_SIZE:
+		stmt->row_array_size = (SQLULEN)(uintptr_t)value;
+		break;
+	case SQL_ATTR_ROWS_FETCHED_PTR:
+		stmt->rows_fetched = (SQLULEN*)value;
+		break;
+	case SQL_ATTR_ROW_STATUS_PTR:
+		stmt->row_status = (SQLUSMALLINT*)value;
+		break;
+	case SQL_ATTR_PARAMSET_SIZE:
+		stmt->paramset_size = (SQLULEN)(uintptr_t)value;
+		break;
+	case SQL_ATTR_PARAM_STATUS_PTR:
+		stmt->param_status = (SQLUSMALLINT*)value;
+		break;
+	case SQL_ATTR_PARAMS_PROCESSED_PTR:
+		stmt->params_processed = (SQLULEN*)value;
+		break;
+	case SQL_ATTR_ASYNC_ENABLE:
+		stmt->async = (SQLULEN)(uintptr_t)value == SQL_ASYNC_ENABLE_ON;
+		break;
+	default: //column-wise binding is the only one
+		break;
+	}
+	return SQL_SUCCESS;
+}
+
+// block cursor, column-wise binding
+inline SQLRETURN SQLFetch(SQLHSTMT handle) {
+	using namespace sqlcpp::mock::detail;
+	auto stmt = (odbc_stmt*)odbc_cast(handle);
+	if (!stmt->cursor_open) {
+		return stmt->set_error("24000", 0, "Invalid cursor state");
+	}
+	if (stmt->dbc->lost()) {
+		return stmt->lost();
+	}
+	const auto& rows = stmt->result->rows;
+	auto count = stmt->cursor >= rows.size() ? 0 : (std::min)((size_t)stmt->row_array_size, rows.size() - stmt->cursor);
+	if (stmt->rows_fetched != nullptr) {
+		*stmt->rows_fetched = count;
+	}
+	if (count == 0) {
+		return SQL_NO_DATA;
+	}
+
+	bool truncated = false;
+	for (size_t r = 0; r < count; r++) {
+		const auto& row = rows[stmt->cursor + r];
+		for (size_t i = 0; i < stmt->columns.size() && i < row.size(); i++) {
+			const auto& col = stmt->columns[i];
+			if (col.data != nullptr) {
+				truncated |= write_odbc_value(row[i], col.c_type, col.data + r * col.width, col.width,
+					col.ind == nullptr ? nullptr : col.ind + r);
+			}
+		}
+	}
+	for (SQLULEN r = 0; stmt->row_status != nullptr && r < stmt->row_array_size; r++) {
+		stmt->row_status[r] = r < count ? SQL_ROW_SUCCESS : SQL_ROW_NOROW;
+	}
+	stmt->current_row = stmt->cursor + count - 1;
+	stmt->cursor += count;
+	stmt->get_data.assign(stmt->result->columns.size(), {});
+	return truncated ? SQL_SUCCESS_WITH_INFO : SQL_SUCCESS;
+}
+
+// char and binary are returned in chunks, SQL_SUCCESS_WITH_INFO until the last one, then SQL_NO_DATA
+inline SQLRETURN SQLGetData(SQLHSTMT handle, SQLUSMALLINT number, SQLSMALLINT c_type, SQLPOINTER value, SQLLEN buffer_length, SQLLEN* ind) {
+	using namespace sqlcpp::mock::detail;
+	auto stmt = (odbc_stmt*)odbc_cast(handle);
+	if (!stmt->cursor_open || stmt->cursor == 0 || number == 0 || number > stmt->get_data.size()) {
+		return stmt->set_error("07009", 0, "Invalid descriptor index");
+	}
+	auto& state = stmt->get_data[number - 1];
+	if (state.done) {
+		return SQL_NO_DATA;
+	}
+	const auto& c = stmt->result->rows[stmt->current_row][number - 1];
+	if (c.is_null || (c_type != SQL_C_CHAR && c_type != SQL_C_BINARY)) {
+		state.done = true;
+		write_odbc_value(c, c_type, (char*)value, buffer_length, ind);
+		return SQL_SUCCESS;
+	}
+
+	auto terminator = c_type == SQL_C_CHAR ? 1 : 0;
+	auto capacity = (size_t)(buffer_length > terminator ? buffer_length - terminator : 0);
+	auto left = c.text.length() - state.offset;
+	auto length = (std::min)(left, capacity);
+	std::memcpy(value, c.text.data() + state.offset, length);
+	if (terminator != 0 && buffer_length > 0) {
+		((char*)value)[length] = '\0';
+	}
+	if (ind != nullptr) {
+		*ind = (SQLLEN)left;
+	}
+	state.offset += length;
+	state.done = left <= capacity;
+	return state.done ? SQL_SUCCESS : SQL_SUCCESS_WITH_INFO;
+}
+
+inline SQLRETURN SQLFreeStmt(SQLHSTMT handle, SQLUSMALLINT option) {
+	using namespace sqlcpp::mock::detail;
+	auto stmt = (odbc_stmt*)odbc_cast(handle);
+	if (option == SQL_CLOSE) {
+		stmt->cursor_open = false;
+	}
+	else if (option == SQL_UNBIND) {
+		stmt->columns.clear();
+	}
+	return SQL_SUCCESS;
+}
+
+inline SQLRETURN SQLGetDiagRec(SQLSMALLINT, SQLHANDLE handle, SQLSMALLINT record, SQLCHAR* sql_state, SQLINTEGER* native_error,
+	SQLCHAR* message, SQLSMALLINT buffer_length, SQLSMALLINT* text_length) {
+	auto h = (sqlcpp::mock::detail::odbc_handle*)handle;
+	if (h == nullptr || record != 1 || !h->diag) {
+		return SQL_NO_DATA;
+	}
+	const auto& e = *h->diag;
+	if (sql_state != nullptr) {
+		std::memset(sql_state, 0, SQL_SQLSTATE_SIZE + 1);
+		std::memcpy(sql_state, e.sql_state.data(), (std::min)(e.sql_state.length(), (size_t)SQL_SQLSTATE_SIZE));
+	}
+	if (native_error != nullptr) {
+		*native_error = e.code;
+	}
+	if (message != nullptr && buffer_length > 0) {
+		auto length = (std::min)(e.message.length(), (size_t)buffer_length - 1);
+		std::memcpy(message, e.message.data(), length);
+		message[length] = '\0';
+	}
+	if (text_length != nullptr) {
+		*text_length = (SQLSMALLINT)e.message.length();
+	}
+	return SQL_SUCCESS;
+}
@@ -2,7 +2,9 @@
 #include <ctime>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <optional>
 #include <tuple>
 #include <array>
 #include <typeinfo>
@@ -10,12 +12,23 @@
 #include <mutex>
 #include <atomic>
 #include <functional>
+#include <memory>
+#include <unordered_map>
 #include <cassert>
+#include <algorithm>
+#ifdef SQLCPP_MOCK_DRIVER
+#include "mock/mysql.h"
+#else
 #include "mysql.h"
+#endif
 #include "db_meta.hpp"
 #include "exception.hpp"
 #include "reflection.hpp"
+#include "reflect_sql.hpp"
 #include "db_common.h"
+#include "db_error.hpp"
+#include "trace.hpp"
+#include "logger.hpp"
 
 namespace sqlcpp::mysql {
 	struct mysql_timestamp {
@@ -30,6 +43,11 @@ namespace sqlcpp::mysql {
 			mt.minute = (unsigned int)s->tm_min;
 			mt.second = (unsigned int)s->tm_sec;
 		}
+
+		// the value field by field, for cache keys
+		auto key_fields() const {
+			return std::make_tuple(mt.year, mt.month, mt.day, mt.hour, mt.minute, mt.second, mt.second_part, mt.neg);
+		}
 	};
 
 	struct mysql_mediumtext {
@@ -40,15 +58,29 @@ namespace sqlcpp::mysql {
 		}
 	};
 
+	// a row of query_raw in text protocol, null columns are empty
+	using raw_row = std::vector<std::optional<std::string_view>>;
+
 	class connection {
+	public:
+		static constexpr size_t max_batch_params = 65535; //placeholders limit of one prepared statement
 	private:
 		std::string ip_;
 		bool is_health_ = false;
+		bool session_dirty_ = false; //session state may be changed by raw sql
 		MYSQL* ctx_ = nullptr;
 		MYSQL_STMT* smt_ctx_ = nullptr;
 		scope_guard<std::function<void()>> deleter_{};
 		inline static std::mutex mtx_{};
 		inline static std::atomic<int> conn_count_ = 0;
+		//member to result column mappings of query_by_name, keyed by struct name and sql
+		struct column_mapping {
+			std::vector<std::string> names; //result columns the mapping was made for
+			std::vector<unsigned int> column_of;
+		};
+		std::unordered_map<std::string, column_mapping> column_maps_;
+		static constexpr size_t max_column_maps = 256;
+		trace::recorder recorder_{ "mysql" };
 
 	public:
 		connection(const connection&) = delete;
@@ -75,14 +107,15 @@ namespace sqlcpp::mysql {
 			smt_ctx_ = mysql_stmt_init(ctx_);
 			assert(smt_ctx_);
 			is_health_ = true;
+			recorder_.set_node(ip_);
 			conn_count_++;
-			printf("mysql create conn <%s>, count:%d\n", ip_.c_str(), conn_count_.load());
+			SQLCPP_LOG(trace, "mysql create conn <%s>, count:%d", ip_.c_str(), conn_count_.load());
 		}
 
 		~connection()
 		{
 			conn_count_--;
-			printf("mysql release conn <%s>, count:%d\n", ip_.c_str(), conn_count_.load());
+			SQLCPP_LOG(trace, "mysql release conn <%s>, count:%d", ip_.c_str(), conn_count_.load());
 		}
 
 		std::string& get_ip() {
@@ -94,24 +127,50 @@ namespace sqlcpp::mysql {
 		}
 
 		void execute(const std::string& sql) {
-			auto ret = mysql_query(ctx_, sql.c_str());
-			if (ret != 0) {
-				is_health_ = false;
-				auto error_msg = std::string("Failed to excute sql<") + sql + ">: " + mysql_error_msg();
-				throw except::mysql_exception(std::move(error_msg));
-			}
+			session_dirty_ = true;
+			execute_sql(sql);
 		}
 
 		void begin_transaction() {
-			execute("START TRANSACTION");
+			execute_sql("START TRANSACTION");
 		}
 
 		void commit_transaction() {
-			execute("COMMIT");
+			execute_sql("COMMIT");
 		}
 
 		void rollback() {
-			execute("ROLLBACK");
+			execute_sql("ROLLBACK");
+		}
+
+		// make the session clean before going back to pool. false means the connection should be dropped
+		bool reset_session() {
+			if (!is_health_) {
+				return false;
+			}
+
+			bool in_trans = (ctx_->server_status & SERVER_STATUS_IN_TRANS) != 0;
+			if (!in_trans && !session_dirty_) {
+				return true;
+			}
+
+			if (in_trans && mysql_query(ctx_, "ROLLBACK") != 0) {
+				return false;
+			}
+
+			if (session_dirty_) {
+				if (mysql_reset_connection(ctx_) != 0) {
+					return false;
+				}
+				//server side prepared statements are closed by reset, renew the stmt handle
+				mysql_stmt_close(smt_ctx_);
+				smt_ctx_ = mysql_stmt_init(ctx_);
+				if (!smt_ctx_) {
+					return false;
+				}
+				session_dirty_ = false;
+			}
+			return true;
 		}
 
 		uint64_t get_last_insert_id() {
@@ -122,21 +181,40 @@ namespace sqlcpp::mysql {
 			return is_health_;
 		}
 
+#ifdef SQLCPP_TRACE
+		// queries are reported to o, null stops it. pools set their observer on every checkout
+		void set_observer(std::shared_ptr<trace::observer> o) {
+			recorder_.set_observer(std::move(o));
+		}
+
+		void trace_acquired(std::shared_ptr<trace::observer> o, std::chrono::nanoseconds wait) {
+			recorder_.acquired(std::move(o), wait);
+		}
+#endif
+
 		auto get_conn_count() {
 			return conn_count_.load();
 		}
 
+		// deadlock or lock wait timeout, the transaction can be run again
+		static bool is_retriable_error(int error_code) {
+			return error_code == 1213 /*ER_LOCK_DEADLOCK*/ || error_code == 1205 /*ER_LOCK_WAIT_TIMEOUT*/;
+		}
+
 		// this query has data back from mysql
 		template<typename ReturnType, typename... Args>
 		std::enable_if_t<is_tuple_v<ReturnType> || reflection::is_reflection_v<ReturnType>, std::vector<ReturnType>>
 			query(std::string_view statement_sql, Args&&...args) {
+			auto span = recorder_.start(statement_sql);
 			before_execute<ReturnType>(statement_sql, std::forward<Args>(args)...);
 			//execute
 			auto ret = mysql_stmt_execute(smt_ctx_);
+			recorder_.mark(trace::phase::execute);
 			if (ret != 0) {
-				is_health_ = false;
+				auto error_code = mysql_stmt_errno(smt_ctx_);
+				check_health(error_code);
 				auto error_msg = std::string("Failed to stmt_execute : ") + mysql_error_msg();
-				throw except::mysql_exception(std::move(error_msg));
+				throw except::mysql_exception(std::move(error_msg), (int)error_code);
 			}
 
 			if constexpr (is_tuple_v<ReturnType>) {
@@ -151,14 +229,17 @@ namespace sqlcpp::mysql {
 		template<typename ReturnType, typename... Args>
 		std::enable_if_t<!is_tuple_v<ReturnType> && !reflection::is_reflection_v<ReturnType> && !std::is_same_v<ReturnType, void>,
 			std::vector<ReturnType>> query(std::string_view statement_sql, Args&&...args) {
+			auto span = recorder_.start(statement_sql);
 			before_execute<ReturnType>(statement_sql, std::forward<Args>(args)...);
 
 			//execute
 			auto ret = mysql_stmt_execute(smt_ctx_);
+			recorder_.mark(trace::phase::execute);
 			if (ret != 0) {
-				is_health_ = false;
+				auto error_code = mysql_stmt_errno(smt_ctx_);
+				check_health(error_code);
 				auto error_msg = std::string("failed to stmt_execute : ") + mysql_error_msg();
-				throw except::mysql_exception(std::move(error_msg));
+				throw except::mysql_exception(std::move(error_msg), (int)error_code);
 			}
 
 			return after_execute<1, ReturnType>();
@@ -168,13 +249,248 @@ namespace sqlcpp::mysql {
 		template<typename ReturnType, typename... Args>
 		std::enable_if_t<std::is_same_v<ReturnType, void>>
 			query(std::string_view statement_sql, Args&&...args) {
+			auto span = recorder_.start(statement_sql);
 			before_execute<void>(statement_sql, std::forward<Args>(args)...);
 			auto ret = mysql_stmt_execute(smt_ctx_);
+			recorder_.mark(trace::phase::execute);
 			if (ret != 0) {
-				is_health_ = false;
+				auto error_code = mysql_stmt_errno(smt_ctx_);
+				check_health(error_code);
 				auto error_msg = std::string("failed to stmt_execute : ") + mysql_error_msg();
+				throw except::mysql_exception(std::move(error_msg), (int)error_code);
+			}
+		}
+
+		// columns are matched to members by name(case insensitive), not by position. extra columns are ignored.
+		// the mapping is made once for a sql and cached, so select * keeps working after schema changes
+		template<typename ReturnType, typename... Args>
+		std::vector<ReturnType> query_by_name(std::string_view statement_sql, Args&&...args) {
+			static_assert(reflection::is_reflection_v<ReturnType>, "query_by_name needs REFLECT struct");
+			auto span = recorder_.start(statement_sql);
+			before_execute<ReturnType, true>(statement_sql, std::forward<Args>(args)...);
+			const auto& column_map = mapped_columns<ReturnType>(statement_sql);
+			recorder_.mark(trace::phase::bind);
+			//execute
+			auto ret = mysql_stmt_execute(smt_ctx_);
+			recorder_.mark(trace::phase::execute);
+			if (ret != 0) {
+				auto error_code = mysql_stmt_errno(smt_ctx_);
+				check_health(error_code);
+				auto error_msg = std::string("Failed to stmt_execute : ") + mysql_error_msg();
+				throw except::mysql_exception(std::move(error_msg), (int)error_code);
+			}
+
+			return after_execute<ReturnType::args_size_t::value, ReturnType>(column_map.data(), mysql_stmt_field_count(smt_ctx_));
+		}
+
+		// rows are read from the network while fetching instead of buffered to client first, memory stays one row for any table size.
+		// fn(ReturnType&&) is called for every row. the connection can not run other statements until it returns the row count
+		template<typename ReturnType, typename Fun, typename... Args>
+		uint64_t query_each(std::string_view statement_sql, Fun&& fn, Args&&...args) {
+			static_assert(!std::is_same_v<ReturnType, void>, "query_each needs a row type");
+			auto span = recorder_.start(statement_sql);
+			before_execute<ReturnType>(statement_sql, std::forward<Args>(args)...);
+			auto ret = mysql_stmt_execute(smt_ctx_);
+			recorder_.mark(trace::phase::execute);
+			if (ret != 0) {
+				auto error_code = mysql_stmt_errno(smt_ctx_);
+				check_health(error_code);
+				auto error_msg = std::string("Failed to stmt_execute : ") + mysql_error_msg();
+				throw except::mysql_exception(std::move(error_msg), (int)error_code);
+			}
+
+			//rows left by a throwing fn are read and dropped, or the connection is out of sync
+			scope_guard free_result([this]() { mysql_stmt_free_result(smt_ctx_); });
+			uint64_t count = 0;
+			if constexpr (is_tuple_v<ReturnType>) {
+				count = fetch_rows<std::tuple_size_v<ReturnType>, ReturnType, false>(fn, [](uint64_t) {});
+			}
+			else if constexpr (reflection::is_reflection_v<ReturnType>) {
+				count = fetch_rows<ReturnType::args_size_t::value, ReturnType, false>(fn, [](uint64_t) {});
+			}
+			else {
+				count = fetch_rows<1, ReturnType, false>(fn, [](uint64_t) {});
+			}
+			recorder_.rows(count);
+			return count;
+		}
+
+		// text protocol streaming of any statement without a row type, like select * for a dump.
+		// fn(const raw_row&) for every row, views are valid during the call. column names are set before the first row
+		template<typename Fun>
+		uint64_t query_raw(std::string_view statement_sql, Fun&& fn, std::vector<std::string>* column_names = nullptr) {
+			auto span = recorder_.start(statement_sql);
+			session_dirty_ = true; //raw sql may change the session
+			if (mysql_real_query(ctx_, statement_sql.data(), (unsigned long)statement_sql.length()) != 0) {
+				auto error_code = mysql_errno(ctx_);
+				check_health(error_code);
+				auto error_msg = std::string("Failed to excute sql<") + std::string(statement_sql) + ">: " + mysql_error_msg();
+				throw except::mysql_exception(std::move(error_msg), (int)error_code);
+			}
+			recorder_.mark(trace::phase::execute);
+
+			//freeing an unfinished result reads the rest of it
+			auto result = std::unique_ptr<MYSQL_RES, void(*)(MYSQL_RES*)>(mysql_use_result(ctx_), [](MYSQL_RES* p) {if (p) mysql_free_result(p); });
+			if (!result) {
+				if (auto error_code = mysql_errno(ctx_); error_code != 0) {
+					check_health(error_code);
+					auto error_msg = std::string("Failed to use_result : ") + mysql_error_msg();
+					throw except::mysql_exception(std::move(error_msg), (int)error_code);
+				}
+				return 0; //no result set
+			}
+
+			auto field_count = mysql_num_fields(result.get());
+			if (column_names != nullptr) {
+				auto fields = mysql_fetch_fields(result.get());
+				column_names->clear();
+				for (unsigned int i = 0; i < field_count; i++) {
+					column_names->emplace_back(fields[i].name, fields[i].name_length);
+				}
+			}
+			raw_row row(field_count);
+			uint64_t count = 0;
+			while (auto values = mysql_fetch_row(result.get())) {
+				auto lengths = mysql_fetch_lengths(result.get());
+				for (unsigned int i = 0; i < field_count; i++) {
+					row[i] = values[i] == nullptr ? std::nullopt : std::optional<std::string_view>(std::in_place, values[i], lengths[i]);
+				}
+				fn(static_cast<const raw_row&>(row));
+				count++;
+			}
+			if (auto error_code = mysql_errno(ctx_); error_code != 0) { //network read failed in the middle
+				check_health(error_code);
+				auto error_msg = std::string("Failed to fetch_row : ") + mysql_error_msg();
+				throw except::mysql_exception(std::move(error_msg), (int)error_code);
+			}
+			recorder_.mark(trace::phase::fetch);
+			recorder_.rows(count);
+			return count;
+		}
+
+#ifdef SQLCPP_HAS_FIXED_STRING
+		// sql is a template argument, placeholders are counted at compile time
+		template<typename ReturnType, sql::fixed_string Sql, typename... Args>
+		query_result_t<ReturnType> query(Args&&...args) {
+			using statement = sql::statement<Sql>;
+			static_assert(sql::count_placeholders(statement::text, true) == param_size_v<Args...>, "param size do not match placeholder size");
+			auto span = recorder_.start(statement::text);
+			before_execute<ReturnType>(statement::text, std::forward<Args>(args)...);
+			auto ret = mysql_stmt_execute(smt_ctx_);
+			recorder_.mark(trace::phase::execute);
+			if (ret != 0) {
+				auto error_code = mysql_stmt_errno(smt_ctx_);
+				check_health(error_code);
+				auto error_msg = std::string("failed to stmt_execute : ") + mysql_error_msg();
+				throw except::mysql_exception(std::move(error_msg), (int)error_code);
+			}
+
+			if constexpr (std::is_same_v<ReturnType, void>) {
+				return;
+			}
+			else if constexpr (is_tuple_v<ReturnType>) {
+				return after_execute<std::tuple_size_v<ReturnType>, ReturnType>();
+			}
+			else if constexpr (reflection::is_reflection_v<ReturnType>) {
+				return after_execute<ReturnType::args_size_t::value, ReturnType>();
+			}
+			else {
+				return after_execute<1, ReturnType>();
+			}
+		}
+#endif
+
+		// same as query, but errors are returned instead of thrown. for hot paths expecting errors, like duplicate key
+		template<typename ReturnType, typename... Args>
+		expected<query_result_t<ReturnType>> try_query(std::string_view statement_sql, Args&&...args) {
+			auto span = recorder_.start(statement_sql);
+			auto prepared = mysql_stmt_prepare(smt_ctx_, statement_sql.data(), (unsigned long)statement_sql.length());
+			recorder_.mark(trace::phase::prepare);
+			if (prepared != 0) {
+				return stmt_error("stmt_prepare");
+			}
+
+			try {
+				check_and_bind<ReturnType>(std::forward<Args>(args)...);
+				recorder_.mark(trace::phase::bind);
+				auto ret = mysql_stmt_execute(smt_ctx_);
+				recorder_.mark(trace::phase::execute);
+				if (ret != 0) {
+					return stmt_error("stmt_execute");
+				}
+
+				if constexpr (std::is_same_v<ReturnType, void>) {
+					return {};
+				}
+				else if constexpr (is_tuple_v<ReturnType>) {
+					return after_execute<std::tuple_size_v<ReturnType>, ReturnType>();
+				}
+				else if constexpr (reflection::is_reflection_v<ReturnType>) {
+					return after_execute<ReturnType::args_size_t::value, ReturnType>();
+				}
+				else {
+					return after_execute<1, ReturnType>();
+				}
+			}
+			catch (const except::sql_exception& e) { //param mismatch or fetch failed, rare
+				return unexpected(db_error(mysql_stmt_errno(smt_ctx_), mysql_stmt_sqlstate(smt_ctx_), "query", e.what()));
+			}
+		}
+
+		// bind rows one after another to a multi-row statement, like insert into t(a,b) values(?,?),(?,?)
+		template<typename T>
+		void query_batch(std::string_view statement_sql, const std::vector<T>& rows) {
+			static_assert(is_tuple_v<T> || reflection::is_reflection_v<T>, "row type must be tuple or reflect struct");
+			auto span = recorder_.start(statement_sql);
+			auto ret = mysql_stmt_prepare(smt_ctx_, statement_sql.data(), (unsigned long)statement_sql.length());
+			recorder_.mark(trace::phase::prepare);
+			if (ret != 0) {
+				auto error_code = mysql_stmt_errno(smt_ctx_);
+				check_health(error_code);
+				auto error_msg = std::string("Failed to stmt_prepare sql<") + std::string(statement_sql) + ">: " + mysql_error_msg();
+				throw except::mysql_exception(std::move(error_msg), (int)error_code);
+			}
+
+			constexpr size_t field_count = row_size_v<T>;
+			if (mysql_stmt_param_count(smt_ctx_) != rows.size() * field_count) {
+				throw except::mysql_exception("param size do not match placeholder size");
+			}
+			if (rows.empty()) {
+				return;
+			}
+
+			std::vector<MYSQL_BIND> param_binds(rows.size() * field_count);
+			auto bind = param_binds.begin();
+			for (const auto& row : rows) {
+				if constexpr (is_tuple_v<T>) {
+					for_each_tuple([&row, &bind, this](auto index) {
+						this->build_bind_param(*bind++, std::get<index>(row));
+					}, std::make_index_sequence<field_count>());
+				}
+				else {
+					constexpr auto address = T::elements_address();
+					for_each_tuple([&row, &bind, &address, this](auto index) {
+						this->build_bind_param(*bind++, row.*std::get<index>(address));
+					}, std::make_index_sequence<field_count>());
+				}
+			}
+
+			ret = mysql_stmt_bind_param(smt_ctx_, param_binds.data());
+			recorder_.mark(trace::phase::bind);
+			if (ret != 0) {
+				auto error_msg = std::string("Failed to stmt_bind_param : ") + mysql_error_msg();
 				throw except::mysql_exception(std::move(error_msg));
 			}
+			recorder_.rows((uint64_t)rows.size());
+
+			ret = mysql_stmt_execute(smt_ctx_);
+			recorder_.mark(trace::phase::execute);
+			if (ret != 0) {
+				auto error_code = mysql_stmt_errno(smt_ctx_);
+				check_health(error_code);
+				auto error_msg = std::string("failed to stmt_execute : ") + mysql_error_msg();
+				throw except::mysql_exception(std::move(error_msg), (int)error_code);
+			}
 		}
 
 	private:
@@ -182,6 +498,49 @@ namespace sqlcpp::mysql {
 			return std::string(mysql_error(ctx_));
 		}
 
+		void execute_sql(const std::string& sql) {
+			auto ret = mysql_query(ctx_, sql.c_str());
+			if (ret != 0) {
+				auto error_code = mysql_errno(ctx_);
+				check_health(error_code);
+				auto error_msg = std::string("Failed to excute sql<") + sql + ">: " + mysql_error_msg();
+				throw except::mysql_exception(std::move(error_msg), (int)error_code);
+			}
+		}
+
+		// errors like duplicate key are statement level, the connection is still usable
+		static bool is_connection_error(unsigned int error_code) {
+			switch (error_code) {
+			case 1053: //ER_SERVER_SHUTDOWN
+			case 1927: //ER_CONNECTION_KILLED
+			case 2002: //CR_CONNECTION_ERROR
+			case 2003: //CR_CONN_HOST_ERROR
+			case 2006: //CR_SERVER_GONE_ERROR
+			case 2013: //CR_SERVER_LOST
+			case 2014: //CR_COMMANDS_OUT_OF_SYNC
+			case 2048: //CR_INVALID_CONN_HANDLE
+			case 2055: //CR_SERVER_LOST_EXTENDED
+			case 2056: //CR_STMT_CLOSED
+			case 3169: //ER_SESSION_WAS_KILLED
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		void check_health(unsigned int error_code) {
+			recorder_.error((int)error_code);
+			if (is_connection_error(error_code)) {
+				is_health_ = false;
+			}
+		}
+
+		unexpected<db_error> stmt_error(const char* where) {
+			auto error_code = mysql_stmt_errno(smt_ctx_);
+			check_health(error_code);
+			return unexpected(db_error((int)error_code, mysql_stmt_sqlstate(smt_ctx_), where, mysql_stmt_error(smt_ctx_)));
+		}
+
 		void connect(const connection_options& opt) {
 			int timeout = 3; //3s
 			mysql_options(ctx_, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
@@ -412,26 +771,75 @@ namespace sqlcpp::mysql {
 			}
 		}
 
-		template<typename ReturnType, typename... Args>
+		// member to result column mapping of the prepared sql, column names come from the result metadata
+		template<typename ReturnType>
+		const std::vector<unsigned int>& mapped_columns(std::string_view statement_sql) {
+			auto meta_result = std::unique_ptr<MYSQL_RES, void(*)(MYSQL_RES*)>(mysql_stmt_result_metadata(smt_ctx_), [](MYSQL_RES* p) {if (p) mysql_free_result(p); });
+			if (!meta_result) {
+				auto error_msg = std::string("Failed to stmt_result_metadata : ") + mysql_error_msg();
+				throw except::mysql_exception(std::move(error_msg));
+			}
+			auto fields = mysql_fetch_fields(meta_result.get());
+			auto field_count = mysql_num_fields(meta_result.get());
+			auto same_columns = [fields, field_count](const std::vector<std::string>& names) {
+				if (names.size() != field_count) {
+					return false;
+				}
+				for (unsigned int i = 0; i < field_count; i++) {
+					if (names[i] != std::string_view(fields[i].name, fields[i].name_length)) {
+						return false;
+					}
+				}
+				return true;
+			};
+
+			auto key = std::string(typeid(ReturnType).name()).append(1, '\n').append(statement_sql);
+			if (auto iter = column_maps_.find(key); iter != column_maps_.end()) {
+				if (same_columns(iter->second.names)) {
+					return iter->second.column_of;
+				}
+				column_maps_.erase(iter); //columns renamed or reordered under the same sql, map again
+			}
+
+			column_mapping mapping;
+			for (unsigned int i = 0; i < field_count; i++) {
+				mapping.names.emplace_back(fields[i].name, fields[i].name_length);
+			}
+			mapping.column_of = sql::map_columns<ReturnType, unsigned int>(mapping.names);
+			if (column_maps_.size() >= max_column_maps) {
+				column_maps_.clear();
+			}
+			return column_maps_.emplace(std::move(key), std::move(mapping)).first->second.column_of;
+		}
+
+		template<typename ReturnType, bool ByName = false, typename... Args>
 		void before_execute(std::string_view statement_sql, Args&&...args) {
 			//last_active_ = std::chrono::steady_clock::now();
 			//prepare
 			auto ret = mysql_stmt_prepare(smt_ctx_, statement_sql.data(), (unsigned long)statement_sql.length());
+			recorder_.mark(trace::phase::prepare);
 			if (ret != 0) {
-				is_health_ = false;
+				auto error_code = mysql_stmt_errno(smt_ctx_);
+				check_health(error_code);
 				auto error_msg = std::string("Failed to stmt_prepare sql<") + std::string(statement_sql) + ">: " + mysql_error_msg();
-				throw except::mysql_exception(std::move(error_msg));
+				throw except::mysql_exception(std::move(error_msg), (int)error_code);
 			}
+			check_and_bind<ReturnType, ByName>(std::forward<Args>(args)...);
+			recorder_.mark(trace::phase::bind);
+		}
 
-			//check input size match
+		// ByName: columns are mapped by name later, the count is not checked
+		template<typename ReturnType, bool ByName = false, typename... Args>
+		void check_and_bind(Args&&...args) {
+			//check input size match. also for fixed string sql, the count of the server is free and exact
+			constexpr auto args_size = param_size_v<Args...>; //members of one tuple or reflect struct arg count
 			auto placeholder_size = mysql_stmt_param_count(smt_ctx_);
-			constexpr auto args_size = sizeof...(args);
 			if (placeholder_size != args_size) {
 				throw except::mysql_exception("param size do not match placeholder size");
 			}
 
 			//check output size match
-			if constexpr (!std::is_same_v<ReturnType, void>) { //tuple or reflect struct or single type
+			if constexpr (!std::is_same_v<ReturnType, void> && !ByName) { //tuple or reflect struct or single type
 				auto meta_result = std::unique_ptr<MYSQL_RES, void(*)(MYSQL_RES*)>(mysql_stmt_result_metadata(smt_ctx_), [](MYSQL_RES* p) {if (p) mysql_free_result(p); });
 				if (!meta_result) {
 					auto error_msg = std::string("Failed to stmt_result_metadata : ") + mysql_error_msg();
@@ -459,13 +867,13 @@ namespace sqlcpp::mysql {
 			if constexpr (args_size > 0) {
 				//initialize
 				std::array<MYSQL_BIND, args_size> param_binds{};
-				auto param_tup = std::forward_as_tuple(std::forward<Args>(args)...);
+				auto param_tup = param_refs(std::forward<Args>(args)...);
 				for_each_tuple([&param_tup, &param_binds, this](auto index) {
 					this->build_bind_param(param_binds[index], std::get<index>(param_tup));
 				}, std::make_index_sequence<args_size>());
 
 				//bind
-				ret = mysql_stmt_bind_param(smt_ctx_, &param_binds[0]);
+				auto ret = mysql_stmt_bind_param(smt_ctx_, &param_binds[0]);
 				if (ret != 0) {
 					auto error_msg = std::string("Failed to stmt_bind_param : ") + mysql_error_msg();
 					throw except::mysql_exception(std::move(error_msg));
@@ -505,12 +913,31 @@ namespace sqlcpp::mysql {
 			}
 		}
 
+		// column_map gives the result column index of every element, null means by position.
+		// columns not mapped are bound as MYSQL_TYPE_NULL and skipped
 		template<size_t ElementSize, typename ReturnType>
-		auto after_execute() {
+		auto after_execute(const unsigned int* column_map = nullptr, size_t column_count = ElementSize) {
+			std::vector<ReturnType> back_data{};
+			fetch_rows<ElementSize, ReturnType, true>([&back_data](ReturnType&& r) { back_data.emplace_back(std::move(r)); },
+				[&back_data](uint64_t row_count) { back_data.reserve((std::size_t)row_count); }, column_map, column_count);
+			recorder_.rows(back_data);
+			return back_data;
+		}
+
+		// on_row(ReturnType&&) for every row. Buffered stores the whole result to client first and tells on_stored the row count,
+		// otherwise rows are read from the network while fetching
+		template<size_t ElementSize, typename ReturnType, bool Buffered, typename RowFn, typename StoredFn>
+		uint64_t fetch_rows(RowFn&& on_row, StoredFn&& on_stored, const unsigned int* column_map = nullptr, size_t column_count = ElementSize) {
+			auto column_of = [column_map](size_t index) {
+				return column_map == nullptr ? index : (size_t)column_map[index];
+			};
 			//initialize results bind
-			std::array<bool, ElementSize> is_null{};
+			std::unique_ptr<bool[]> is_null(new bool[column_count]{});
 			std::vector<std::pair<std::vector<char>, unsigned long>> buf_keeper; buf_keeper.reserve(ElementSize);
-			std::array<MYSQL_BIND, ElementSize> param_binds{};
+			std::vector<MYSQL_BIND> param_binds(column_count);
+			for (auto& bind : param_binds) {
+				bind.buffer_type = MYSQL_TYPE_NULL;
+			}
 			ReturnType r{};
 			if constexpr (is_tuple_v<ReturnType>) {
 				for_each_tuple([&r, &buf_keeper, &param_binds, &is_null, this](auto index) {
@@ -519,8 +946,9 @@ namespace sqlcpp::mysql {
 			}
 			else if constexpr (reflection::is_reflection_v<ReturnType>) { //reflect
 				constexpr auto address = ReturnType::elements_address();
-				for_each_tuple([&r, &buf_keeper, &address, &param_binds, &is_null, this](auto index) {
-					this->build_result_param(buf_keeper, param_binds[index], r.*std::get<index>(address), &is_null[index]);
+				for_each_tuple([&r, &buf_keeper, &address, &param_binds, &is_null, &column_of, this](auto index) {
+					auto column = column_of(index);
+					this->build_result_param(buf_keeper, param_binds[column], r.*std::get<index>(address), &is_null[column]);
 				}, std::make_index_sequence<ElementSize>());
 			}
 			else { //single type	
@@ -534,19 +962,24 @@ namespace sqlcpp::mysql {
 				throw except::mysql_exception(std::move(error_msg));
 			}
 
-			//buffer all results to client
-			auto r_ret = mysql_stmt_store_result(smt_ctx_);
-			if (r_ret != 0) {
-				auto error_msg = std::string("Failed to stmt_store_result : ") + mysql_error_msg();
-				throw except::mysql_exception(std::move(error_msg));
+			if constexpr (Buffered) {
+				//buffer all results to client
+				auto r_ret = mysql_stmt_store_result(smt_ctx_);
+				recorder_.mark(trace::phase::store);
+				if (r_ret != 0) {
+					auto error_msg = std::string("Failed to stmt_store_result : ") + mysql_error_msg();
+					throw except::mysql_exception(std::move(error_msg));
+				}
+				on_stored(mysql_stmt_num_rows(smt_ctx_));
 			}
 
 			//get back data
-			auto row_count = mysql_stmt_num_rows(smt_ctx_);
-			std::vector<ReturnType> back_data{};
-			back_data.reserve((std::size_t)row_count);
-
-			while (!mysql_stmt_fetch(smt_ctx_)) {
+			uint64_t fetched = 0;
+			int fetch_ret = 0;
+			while ((fetch_ret = mysql_stmt_fetch(smt_ctx_)) == 0 || fetch_ret == MYSQL_DATA_TRUNCATED) {
+				if (fetch_ret == MYSQL_DATA_TRUNCATED) {
+					fetch_truncated(param_binds, buf_keeper);
+				}
 				auto iter = buf_keeper.begin();
 				if constexpr (is_tuple_v<ReturnType>) {
 					for_each_tuple([&r, &iter, &is_null, this](auto index) {
@@ -555,16 +988,47 @@ namespace sqlcpp::mysql {
 				}
 				else if constexpr (reflection::is_reflection_v<ReturnType>) {
 					constexpr auto address = ReturnType::elements_address();
-					for_each_tuple([&r, &address, &iter, &is_null, this](auto index) {
-						this->assign_result(is_null[index], r.*std::get<index>(address), iter);
+					for_each_tuple([&r, &address, &iter, &is_null, &column_of, this](auto index) {
+						this->assign_result(is_null[column_of(index)], r.*std::get<index>(address), iter);
 					}, std::make_index_sequence<ElementSize>());
 				}
 				else { //single type
 					this->assign_result(is_null[0], r, iter);
 				}
-				back_data.emplace_back(std::move(r));
+				on_row(std::move(r));
+				fetched++;
+			}
+			if (fetch_ret != MYSQL_NO_DATA) { //like network read failed in the middle
+				auto error_code = mysql_stmt_errno(smt_ctx_);
+				check_health(error_code);
+				auto error_msg = std::string("Failed to stmt_fetch : ") + std::string(mysql_stmt_error(smt_ctx_));
+				throw except::mysql_exception(std::move(error_msg), (int)error_code);
+			}
+			recorder_.mark(trace::phase::fetch);
+			return fetched;
+		}
+
+		// string columns longer than their buffer are read again into a larger one, which stays bound for the next rows
+		void fetch_truncated(std::vector<MYSQL_BIND>& binds, std::vector<std::pair<std::vector<char>, unsigned long>>& buf_keeper) {
+			for (unsigned int column = 0; column < (unsigned int)binds.size(); column++) {
+				auto& bind = binds[column];
+				if (bind.length == nullptr || *bind.length <= bind.buffer_length) {
+					continue;
+				}
+				auto buf = std::find_if(buf_keeper.begin(), buf_keeper.end(),
+					[&bind](const auto& b) { return &b.second == bind.length; });
+				buf->first.resize(*bind.length);
+				bind.buffer = buf->first.data();
+				bind.buffer_length = *bind.length;
+				if (mysql_stmt_fetch_column(smt_ctx_, &bind, column, 0) != 0) {
+					auto error_msg = std::string("Failed to stmt_fetch_column : ") + std::string(mysql_stmt_error(smt_ctx_));
+					throw except::mysql_exception(std::move(error_msg), (int)mysql_stmt_errno(smt_ctx_));
+				}
+			}
+			if (mysql_stmt_bind_result(smt_ctx_, binds.data()) != 0) {
+				auto error_msg = std::string("Failed to stmt_bind_result : ") + mysql_error_msg();
+				throw except::mysql_exception(std::move(error_msg));
 			}
-			return back_data;
 		}
 	};
 }
\ No newline at end of file
@@ -10,6 +10,8 @@
 #include "db_meta.hpp"
 #include "mysql_connection.hpp"
 #include "mysql_sentinel.hpp"
+#include "trace.hpp"
+#include "pool_metrics.hpp"
 #include "db_common.h"
 
 namespace sqlcpp::mysql {
@@ -20,6 +22,10 @@ namespace sqlcpp::mysql {
 		using slave_pool = std::unordered_map<std::string, std::queue<std::unique_ptr<connection>>>; // ip---conn
 		using general_pool = std::queue<std::unique_ptr<connection>>;
 	private:
+#ifdef SQLCPP_TRACE
+		std::shared_ptr<trace::observer> observer_;
+		std::mutex observer_mtx_;
+#endif
 		std::unique_ptr<sentinel> sentine_;
 		std::thread update_cluster_connections_thread_;
 		std::atomic<bool> run_ = true;
@@ -42,6 +48,8 @@ namespace sqlcpp::mysql {
 		general_pool pool_;
 		std::string user_;
 		std::string passwd_;
+
+		pool_metrics metrics_;
 	public:
 		connection_pool(const connection_pool&) = delete;
 		connection_pool& operator=(const connection_pool&) = delete;
@@ -70,6 +78,93 @@ namespace sqlcpp::mysql {
 		
 		template<conn_type Type>
 		decltype(auto) get_connection() {
+			auto begin = std::chrono::steady_clock::now();
+			try {
+				auto conn = acquire_connection<Type>();
+				auto wait = std::chrono::steady_clock::now() - begin;
+				metrics_.acquired(wait);
+#ifdef SQLCPP_TRACE
+				conn->trace_acquired(get_observer(), wait);
+#endif
+				return conn;
+			}
+			catch (...) {
+				metrics_.acquire_failed();
+				throw;
+			}
+		}
+
+		// idle and busy connections per node, and counters since the pool was created
+		pool_stats get_stats() {
+			std::vector<node_pool_stats> nodes;
+			if constexpr (Model == model::cluster) {
+				std::scoped_lock lock(master_mtx_, slave_mtx_);
+				for (const auto& [ip, q] : master_pool_) {
+					nodes.push_back({ ip, "master", q.size() });
+				}
+				for (const auto& [ip, q] : slave_pool_) {
+					nodes.push_back({ ip, "slave", q.size() });
+				}
+			}
+			else {
+				std::lock_guard<std::mutex> lock(mtx_);
+				nodes.push_back({ node_.ip, "general", pool_.size() });
+			}
+			return metrics_.snapshot("mysql", std::move(nodes));
+		}
+
+#ifdef SQLCPP_TRACE
+		// connections checked out from now on report their queries and the wait to get them to o.
+		// ones out already keep the previous observer alive until they are returned
+		void set_observer(std::shared_ptr<trace::observer> o) {
+			std::lock_guard<std::mutex> lock(observer_mtx_);
+			observer_.swap(o);
+		}
+
+		std::shared_ptr<trace::observer> get_observer() {
+			std::lock_guard<std::mutex> lock(observer_mtx_);
+			return observer_;
+		}
+#endif
+
+		void return_back(std::unique_ptr<connection>&& p) {
+#ifdef SQLCPP_TRACE
+			p->set_observer(nullptr); //the observer of the checkout is released
+#endif
+			if (!p->reset_session()) {
+				metrics_.destroyed(p->get_ip(), 1, true);
+				return; //broken connection or session can not be cleaned, just drop it
+			}
+
+			if constexpr (Model == model::cluster) {
+				{
+					std::lock_guard<std::mutex> lock_slave(slave_mtx_);
+					if (auto iter = slave_pool_.find(p->get_ip()); iter != slave_pool_.end()) {
+						iter->second.emplace(std::move(p));
+						return;
+					}
+				}
+				{
+					std::lock_guard<std::mutex> master_slave(master_mtx_);
+					if (auto iter = master_pool_.find(p->get_ip()); iter != master_pool_.end()) {
+						iter->second.emplace(std::move(p));
+						return;
+					}
+				}
+				metrics_.destroyed(p->get_ip()); //node is gone
+			}
+			else if constexpr (Model == model::single) {
+				std::lock_guard<std::mutex> lock(mtx_);
+				pool_.emplace(std::move(p));
+			}
+			else {
+				static_assert(always_false_v<Model>, "unknown launch_model");
+			}
+		}
+
+	private:
+		template<conn_type Type>
+		decltype(auto) acquire_connection() {
 			std::unique_ptr<connection> conn;
 			int index = 0;
 
@@ -121,49 +216,22 @@ namespace sqlcpp::mysql {
 				if (conn->is_health()) {
 					return connection_guard(std::move(conn), *this);
 				}
+				metrics_.destroyed(conn->get_ip(), 1, true);
+				conn.reset();
 			}
 
 			//create new connection 
 			if constexpr (Type == conn_type::general) {
-				printf("general ");
-				return connection_guard(create_connection(), *this);
+				return connection_guard(create_connection(node_), *this);
 			}
 			else if constexpr (Type == conn_type::master) {
-				printf("master ");
-				return connection_guard(sentine_->create_connection(masters_[index]), *this);
+				return connection_guard(create_connection(masters_[index]), *this);
 			}
 			else if constexpr (Type == conn_type::slave) {
-				printf("slave ");
-				return connection_guard(sentine_->create_connection(slaves_[index]), *this);
-			}
-		}
-		
-		void return_back(std::unique_ptr<connection>&& p) {
-			if constexpr (Model == model::cluster) {
-				{
-					std::lock_guard<std::mutex> lock_slave(slave_mtx_);
-					if (auto iter = slave_pool_.find(p->get_ip()); iter != slave_pool_.end()) {
-						iter->second.emplace(std::move(p));
-						return;
-					}
-				}
-				{
-					std::lock_guard<std::mutex> master_slave(master_mtx_);
-					if (auto iter = master_pool_.find(p->get_ip()); iter != master_pool_.end()) {
-						iter->second.emplace(std::move(p));
-					}
-				}
-			}
-			else if constexpr (Model == model::single) {
-				std::lock_guard<std::mutex> lock(mtx_);
-				pool_.emplace(std::move(p));
-			}
-			else {
-				static_assert(always_false_v<Model>, "unknown launch_model");
+				return connection_guard(create_connection(slaves_[index]), *this);
 			}
 		}
 
-	private:
 		void update_cluster_connections() {
 			while (run_) {
 				auto changed_cluster = sentine_->wait_for_cluster_change();
@@ -202,14 +270,38 @@ namespace sqlcpp::mysql {
 						slaves_.emplace_back(std::move(node));
 					}
 				}
+				//connections of nodes gone are dropped
+				for (const auto& [ip, q] : master_pool_) {
+					metrics_.destroyed(ip, q.size());
+				}
+				for (const auto& [ip, q] : slave_pool_) {
+					metrics_.destroyed(ip, q.size());
+				}
+				if (!master_pool_.empty() || !slave_pool_.empty()) {
+					metrics_.topology_changed();
+				}
 				//replace old pool
 				master_pool_ = std::move(master_pool); masters_count_ = (uint8_t)master_pool_.size();
 				slave_pool_ = std::move(slave_pool); slaves_count_ = (uint8_t)slave_pool_.size();
 			}
 		}
 
-		std::unique_ptr<connection> create_connection() {
-			return std::make_unique<connection>(connection_options{ node_.ip, node_.port, user_, passwd_ });
+		std::unique_ptr<connection> create_connection(const node_info& node) {
+			try {
+				std::unique_ptr<connection> conn;
+				if constexpr (Model == model::cluster) {
+					conn = sentine_->create_connection(node);
+				}
+				else {
+					conn = std::make_unique<connection>(connection_options{ node.ip, node.port, user_, passwd_ });
+				}
+				metrics_.created(node.ip);
+				return conn;
+			}
+			catch (...) {
+				metrics_.create_failed();
+				throw;
+			}
 		}
 	};
 }
\ No newline at end of file
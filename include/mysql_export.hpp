@@ -0,0 +1,295 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include "db.hpp"
+#include "mysql_connection.hpp"
+
+//many connections reading one point in time, for backups and warehouse loads like mydumper
+namespace sqlcpp::mysql {
+	enum class snapshot_lock {
+		flush_tables, //FLUSH TABLES WITH READ LOCK while the snapshots start, writes wait for that moment
+		backup_lock, //LOCK INSTANCE FOR BACKUP during the export, ddl waits. snapshots are synced without FTWRL where the server tells their gtid
+		none //nothing is written meanwhile, like a stopped replica
+	};
+
+	struct export_options {
+		size_t connections = 4;
+		snapshot_lock lock = snapshot_lock::flush_tables;
+		size_t sync_attempts = 3; //backup_lock, snapshots started again when they differ, then FTWRL
+		std::chrono::seconds lock_wait_timeout{ 30 }; //gives up taking the lock instead of blocking writes behind it
+	};
+
+	struct snapshot_info {
+		std::string gtid_executed; //transactions in the snapshot, empty without gtid_mode
+		snapshot_lock synced_by = snapshot_lock::none; //backup_lock if no FTWRL was needed
+	};
+
+	struct export_table {
+		std::string name;
+		std::string key_column{}; //integer column to split the table into chunks by, empty is one chunk
+		size_t chunks = 0; //key ranges, 0 is 4 per connection
+		std::vector<int64_t> bounds{}; //split points instead of even ranges
+		std::string columns{}; //select list, REFLECT members by default, * for others
+		std::string where{}; //filter of rows, without where
+	};
+
+	// a chunk handed to the sink factory, rows of one chunk come from one thread in order
+	struct export_chunk {
+		const export_table* table = nullptr;
+		size_t index = 0; //of the chunks of the table
+		std::string where; //rows of the chunk, empty is the whole table
+		std::vector<std::string> columns; //dump_raw, set before the first row
+	};
+
+	// N connections of db on one server, each in a transaction WITH CONSISTENT SNAPSHOT of the same moment.
+	// dumps split tables into chunks and read them on all connections at once with streaming fetch
+	template<typename Db>
+	class snapshot_export {
+	private:
+		using conn_t = decltype(std::declval<Db&>().template get_conn<Db::write_conn_type>());
+
+		std::vector<conn_t> conns_;
+		export_options opt_;
+		snapshot_info info_;
+		bool backup_locked_ = false;
+	public:
+		snapshot_export(const snapshot_export&) = delete;
+		snapshot_export& operator=(const snapshot_export&) = delete;
+
+		snapshot_export(Db& db, export_options opt = {})
+			:opt_(opt) {
+			acquire(db);
+			auto& locker = conns_[0];
+			locker->execute("SET SESSION lock_wait_timeout = " + std::to_string(opt_.lock_wait_timeout.count()));
+			for (auto& conn : conns_) {
+				conn->execute("SET SESSION TRANSACTION ISOLATION LEVEL REPEATABLE READ");
+			}
+
+			if (opt_.lock == snapshot_lock::backup_lock) {
+				locker->execute("LOCK INSTANCE FOR BACKUP");
+				backup_locked_ = true;
+				if (start_synced()) {
+					info_.synced_by = snapshot_lock::backup_lock;
+					return;
+				}
+			}
+			if (opt_.lock == snapshot_lock::none) {
+				start_all();
+				info_.gtid_executed = scalar(locker, "SELECT @@GLOBAL.gtid_executed");
+				return;
+			}
+
+			//writes are blocked from here, keep it short
+			locker->execute("FLUSH TABLES WITH READ LOCK");
+			start_all();
+			info_.gtid_executed = scalar(locker, "SELECT @@GLOBAL.gtid_executed");
+			locker->execute("UNLOCK TABLES");
+			info_.synced_by = snapshot_lock::flush_tables;
+		}
+
+		~snapshot_export() {
+			if (backup_locked_) {
+				try {
+					conns_[0]->execute("UNLOCK INSTANCE");
+				}
+				catch (const except::sql_exception&) {} //the session is reset by the pool anyway
+			}
+		}
+
+		const snapshot_info& snapshot() const {
+			return info_;
+		}
+
+		size_t connections() const {
+			return conns_.size();
+		}
+
+		// rows of table as T, REFLECT struct, tuple or single type.
+		// open_chunk(const export_chunk&) returns fn(T&&) for the rows of the chunk, it is called on several threads at once
+		template<typename T, typename SinkFactory>
+		uint64_t dump(const export_table& table, SinkFactory&& open_chunk) {
+			std::string columns = table.columns;
+			if (columns.empty()) {
+				if constexpr (reflection::is_reflection_v<T>) {
+					columns = sql::columns<T>();
+				}
+				else {
+					columns = "*";
+				}
+			}
+			std::vector<export_table> tables{ table }; //chunks point to it
+			return run(plan(tables), [&columns, &open_chunk](conn_t& conn, export_chunk& chunk) {
+				auto sink = open_chunk(static_cast<const export_chunk&>(chunk));
+				return conn->template query_each<T>(select_of(chunk, columns), sink);
+			});
+		}
+
+		// rows of tables in text protocol, whatever their columns.
+		// open_chunk(const export_chunk&) returns fn(const raw_row&) for the rows of the chunk, it is called on several threads at once
+		template<typename SinkFactory>
+		uint64_t dump_raw(const std::vector<export_table>& tables, SinkFactory&& open_chunk) {
+			return run(plan(tables), [&open_chunk](conn_t& conn, export_chunk& chunk) {
+				auto sink = open_chunk(static_cast<const export_chunk&>(chunk));
+				auto columns = chunk.table->columns.empty() ? std::string("*") : chunk.table->columns;
+				return conn->query_raw(select_of(chunk, columns), sink, &chunk.columns);
+			});
+		}
+	private:
+		// connections of one server, multi primary clusters may hand out another master
+		void acquire(Db& db) {
+			auto count = (std::max)(opt_.connections, (size_t)1);
+			std::vector<conn_t> others; //held so round robin moves on
+			for (size_t tries = 0; conns_.size() < count && tries < count * 8; tries++) {
+				auto conn = db.template get_conn<Db::write_conn_type>();
+				if (conns_.empty() || conn->get_ip() == conns_[0]->get_ip()) {
+					conns_.emplace_back(std::move(conn));
+				}
+				else {
+					others.emplace_back(std::move(conn));
+				}
+			}
+			if (conns_.size() < count) {
+				throw except::mysql_exception("snapshot connections of one server not available");
+			}
+		}
+
+		void start_all() {
+			for (auto& conn : conns_) {
+				conn->execute("START TRANSACTION WITH CONSISTENT SNAPSHOT, READ ONLY");
+			}
+		}
+
+		// the snapshots are one moment if all of them report the same gtid set. needs binlog_snapshot_gtid_executed
+		// of Percona Server, other servers go on with FTWRL
+		bool start_synced() {
+			for (size_t attempt = 0; attempt < opt_.sync_attempts; attempt++) {
+				start_all();
+				std::optional<std::string> first;
+				bool same = true;
+				for (auto& conn : conns_) {
+					auto gtid = status(conn, "binlog_snapshot_gtid_executed");
+					if (!gtid) {
+						rollback_all();
+						return false;
+					}
+					if (!first) {
+						first = std::move(gtid);
+					}
+					else if (*gtid != *first) {
+						same = false;
+						break;
+					}
+				}
+				if (same) {
+					info_.gtid_executed = std::move(*first);
+					return true;
+				}
+				rollback_all(); //a commit landed between them
+			}
+			return false;
+		}
+
+		void rollback_all() {
+			for (auto& conn : conns_) {
+				conn->rollback();
+			}
+		}
+
+		static std::string scalar(conn_t& conn, std::string_view statement_sql) {
+			std::string value;
+			conn->query_raw(statement_sql, [&value](const raw_row& row) {
+				if (!row.empty() && row[0]) {
+					value.assign(*row[0]);
+				}
+			});
+			return value;
+		}
+
+		static std::optional<std::string> status(conn_t& conn, std::string_view name) {
+			std::optional<std::string> value;
+			conn->query_raw("SHOW SESSION STATUS LIKE '" + std::string(name) + "'", [&value](const raw_row& row) {
+				if (row.size() > 1 && row[1]) {
+					value.emplace(*row[1]);
+				}
+			});
+			return value;
+		}
+
+		// chunks of all tables, ranges come from the snapshot itself. rows with a null key are a chunk of their own
+		std::vector<export_chunk> plan(const std::vector<export_table>& tables) {
+			std::vector<export_chunk> chunks;
+			for (const auto& table : tables) {
+				std::string filter = table.where.empty() ? "" : " and (" + table.where + ")";
+				if (table.key_column.empty()) {
+					chunks.push_back({ &table, 0, table.where, {} });
+					continue;
+				}
+
+				size_t index = 0;
+				auto r = conns_[0]->template query<std::tuple<std::optional<int64_t>, std::optional<int64_t>>>(
+					"select min(" + table.key_column + "), max(" + table.key_column + ") from " + table.name +
+					(table.where.empty() ? "" : " where " + table.where));
+				if (!r.empty() && std::get<0>(r[0]) && std::get<1>(r[0])) {
+					scan_options split{ conns_.size(), table.chunks, table.bounds };
+					for (auto [first, last] : detail::split_range(*std::get<0>(r[0]), *std::get<1>(r[0]), split)) {
+						chunks.push_back({ &table, index++, table.key_column + " >= " + std::to_string(first) + " and " +
+							table.key_column + " <= " + std::to_string(last) + filter, {} });
+					}
+				}
+				chunks.push_back({ &table, index, table.key_column + " is null" + filter, {} });
+			}
+			return chunks;
+		}
+
+		static std::string select_of(const export_chunk& chunk, const std::string& columns) {
+			return "select " + columns + " from " + chunk.table->name + (chunk.where.empty() ? "" : " where " + chunk.where);
+		}
+
+		// chunks are taken by the connections in order, the first error stops the others
+		template<typename Fun>
+		uint64_t run(std::vector<export_chunk> chunks, Fun&& read_chunk) {
+			std::atomic<size_t> next = 0;
+			std::atomic<bool> stop = false;
+			std::atomic<uint64_t> rows = 0;
+			std::exception_ptr error;
+			std::mutex error_mtx;
+			auto work = [&](size_t conn_index) {
+				try {
+					for (size_t i = next++; i < chunks.size() && !stop; i = next++) {
+						rows += read_chunk(conns_[conn_index], chunks[i]);
+					}
+				}
+				catch (...) {
+					stop = true;
+					std::lock_guard<std::mutex> lock(error_mtx);
+					if (!error) {
+						error = std::current_exception();
+					}
+				}
+			};
+
+			std::vector<std::thread> workers;
+			auto parallelism = (std::min)(conns_.size(), chunks.size());
+			for (size_t i = 1; i < parallelism; i++) {
+				workers.emplace_back(work, i);
+			}
+			work(0);
+			for (auto& t : workers) {
+				t.join();
+			}
+			if (error) {
+				std::rethrow_exception(error);
+			}
+			return rows;
+		}
+	};
+}
@@ -11,6 +11,7 @@
 #include <condition_variable>
 #include "db_meta.hpp"
 #include "db_common.h"
+#include "logger.hpp"
 
 namespace sqlcpp::mysql {
 	class connection;
@@ -70,7 +71,7 @@ namespace sqlcpp::mysql {
 							break; // go to sleep
 						}
 						catch (const std::exception& e) {
-							printf("make monitor connection error: %s\n", e.what());
+							SQLCPP_LOG(warn, "mysql make monitor connection error: %s", e.what());
 							conn_.reset();
 							std::this_thread::sleep_for(std::chrono::milliseconds(3000));//maybe network is bad
 							continue; //ingnore error
@@ -0,0 +1,233 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <unordered_map>
+#include <type_traits>
+
+namespace sqlcpp {
+	struct node_pool_stats {
+		std::string node;
+		std::string role; //general, master or slave. empty for a node gone with connections still checked out
+		size_t idle = 0;
+		size_t busy = 0; //checked out
+	};
+
+	struct pool_stats {
+		//upper bounds of the acquire wait buckets, microseconds
+		static constexpr std::array<uint64_t, 16> wait_bounds_us{ 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+			100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000 };
+
+		std::string backend; //mysql or sqlserver
+		std::string name; //pool label of prometheus output, set it to tell pools apart
+		std::vector<node_pool_stats> nodes;
+		uint64_t acquires = 0;
+		uint64_t acquire_failures = 0; //no node, pool exhausted or connecting failed
+		uint64_t created = 0;
+		uint64_t destroyed = 0;
+		uint64_t create_failures = 0;
+		uint64_t evictions = 0; //found broken by health check, or session could not be reset
+		uint64_t topology_changes = 0; //cluster members or roles changed
+		std::array<uint64_t, wait_bounds_us.size() + 1> acquire_wait_buckets{}; //not cumulative, the last one is above all bounds
+		std::chrono::nanoseconds acquire_wait_sum{ 0 };
+	};
+
+	// counters kept by a connection pool, all updates are lock free except creating and destroying connections
+	class pool_metrics {
+	private:
+		std::atomic<uint64_t> acquires_ = 0;
+		std::atomic<uint64_t> acquire_failures_ = 0;
+		std::atomic<uint64_t> created_ = 0;
+		std::atomic<uint64_t> destroyed_ = 0;
+		std::atomic<uint64_t> create_failures_ = 0;
+		std::atomic<uint64_t> evictions_ = 0;
+		std::atomic<uint64_t> topology_changes_ = 0;
+		std::array<std::atomic<uint64_t>, pool_stats::wait_bounds_us.size() + 1> wait_buckets_{};
+		std::atomic<uint64_t> wait_sum_ns_ = 0;
+
+		mutable std::mutex mtx_;
+		std::unordered_map<std::string, int64_t> live_; //node---connections not destroyed
+	public:
+		void acquired(std::chrono::nanoseconds wait) {
+			acquires_.fetch_add(1, std::memory_order_relaxed);
+			wait_sum_ns_.fetch_add((uint64_t)wait.count(), std::memory_order_relaxed);
+			auto us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(wait).count();
+			size_t i = 0;
+			while (i < pool_stats::wait_bounds_us.size() && us > pool_stats::wait_bounds_us[i]) {
+				i++;
+			}
+			wait_buckets_[i].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void acquire_failed() {
+			acquire_failures_++;
+		}
+
+		void created(const std::string& node) {
+			created_++;
+			std::lock_guard<std::mutex> lock(mtx_);
+			live_[node]++;
+		}
+
+		void create_failed() {
+			create_failures_++;
+		}
+
+		// count connections of node dropped by the pool, evicted if they were found broken
+		void destroyed(const std::string& node, size_t count = 1, bool evicted = false) {
+			if (count == 0) {
+				return;
+			}
+			destroyed_ += count;
+			if (evicted) {
+				evictions_ += count;
+			}
+			std::lock_guard<std::mutex> lock(mtx_);
+			if (auto iter = live_.find(node); iter != live_.end() && (iter->second -= (int64_t)count) <= 0) {
+				live_.erase(iter);
+			}
+		}
+
+		void topology_changed() {
+			topology_changes_++;
+		}
+
+		// nodes come with idle counts, busy ones are the live connections not idle
+		pool_stats snapshot(std::string backend, std::vector<node_pool_stats> nodes) const {
+			pool_stats s;
+			s.backend = std::move(backend);
+			s.acquires = acquires_.load();
+			s.acquire_failures = acquire_failures_.load();
+			s.created = created_.load();
+			s.destroyed = destroyed_.load();
+			s.create_failures = create_failures_.load();
+			s.evictions = evictions_.load();
+			s.topology_changes = topology_changes_.load();
+			for (size_t i = 0; i < wait_buckets_.size(); i++) {
+				s.acquire_wait_buckets[i] = wait_buckets_[i].load();
+			}
+			s.acquire_wait_sum = std::chrono::nanoseconds(wait_sum_ns_.load());
+
+			std::lock_guard<std::mutex> lock(mtx_);
+			auto live = live_;
+			for (auto& n : nodes) {
+				if (auto iter = live.find(n.node); iter != live.end()) {
+					n.busy = iter->second > (int64_t)n.idle ? (size_t)iter->second - n.idle : 0;
+					live.erase(iter);
+				}
+			}
+			for (const auto& [node, count] : live) {
+				nodes.push_back({ node, "", 0, (size_t)count });
+			}
+			s.nodes = std::move(nodes);
+			return s;
+		}
+	};
+
+	namespace detail {
+		inline void append_label_value(std::string& out, std::string_view v) {
+			for (char c : v) {
+				switch (c) {
+				case '\\': out += "\\\\"; break;
+				case '"': out += "\\\""; break;
+				case '\n': out += "\\n"; break;
+				default: out += c;
+				}
+			}
+		}
+
+		inline std::string pool_labels(const pool_stats& s) {
+			std::string labels = "backend=\"";
+			append_label_value(labels, s.backend);
+			labels += '"';
+			if (!s.name.empty()) {
+				labels += ",pool=\"";
+				append_label_value(labels, s.name);
+				labels += '"';
+			}
+			return labels;
+		}
+	}
+
+	// prometheus text exposition of pools, each metric family is written once for all of them
+	inline std::string to_prometheus(const std::vector<pool_stats>& pools) {
+		std::string out;
+		char num[64];
+		auto sample = [&out, &num](std::string_view metric, const std::string& labels, auto value) {
+			if constexpr (std::is_floating_point_v<decltype(value)>) {
+				snprintf(num, sizeof(num), "%.9g", value);
+			}
+			else {
+				snprintf(num, sizeof(num), "%llu", (unsigned long long)value);
+			}
+			out.append(metric).append("{").append(labels).append("} ").append(num).append("\n");
+		};
+		auto header = [&out](std::string_view metric, std::string_view type, std::string_view help) {
+			out.append("# HELP ").append(metric).append(" ").append(help).append("\n");
+			out.append("# TYPE ").append(metric).append(" ").append(type).append("\n");
+		};
+
+		header("sqlcpp_pool_connections", "gauge", "Connections of the pool by node and state.");
+		for (const auto& s : pools) {
+			auto labels = detail::pool_labels(s);
+			for (const auto& n : s.nodes) {
+				std::string node_labels = labels + ",node=\"";
+				detail::append_label_value(node_labels, n.node);
+				node_labels += "\",role=\"";
+				detail::append_label_value(node_labels, n.role);
+				node_labels += '"';
+				sample("sqlcpp_pool_connections", node_labels + ",state=\"idle\"", n.idle);
+				sample("sqlcpp_pool_connections", node_labels + ",state=\"busy\"", n.busy);
+			}
+		}
+
+		struct counter {
+			std::string_view metric;
+			std::string_view help;
+			uint64_t pool_stats::* value;
+		};
+		static constexpr counter counters[] = {
+			{ "sqlcpp_pool_acquires_total", "Connections checked out.", &pool_stats::acquires },
+			{ "sqlcpp_pool_acquire_failures_total", "Check outs failed, no node, pool exhausted or connecting failed.", &pool_stats::acquire_failures },
+			{ "sqlcpp_pool_connections_created_total", "Connections created.", &pool_stats::created },
+			{ "sqlcpp_pool_connections_destroyed_total", "Connections dropped by the pool.", &pool_stats::destroyed },
+			{ "sqlcpp_pool_connection_create_failures_total", "Connections failed to create.", &pool_stats::create_failures },
+			{ "sqlcpp_pool_evictions_total", "Connections dropped by health check or failed session reset.", &pool_stats::evictions },
+			{ "sqlcpp_pool_topology_changes_total", "Cluster member or role changes.", &pool_stats::topology_changes },
+		};
+		for (const auto& c : counters) {
+			header(c.metric, "counter", c.help);
+			for (const auto& s : pools) {
+				sample(c.metric, detail::pool_labels(s), s.*c.value);
+			}
+		}
+
+		header("sqlcpp_pool_acquire_wait_seconds", "histogram", "Time to check out a connection.");
+		for (const auto& s : pools) {
+			auto labels = detail::pool_labels(s);
+			uint64_t cumulative = 0;
+			for (size_t i = 0; i < s.acquire_wait_buckets.size(); i++) {
+				cumulative += s.acquire_wait_buckets[i];
+				std::string le = "+Inf";
+				if (i < pool_stats::wait_bounds_us.size()) {
+					snprintf(num, sizeof(num), "%g", (double)pool_stats::wait_bounds_us[i] / 1e6);
+					le = num;
+				}
+				sample("sqlcpp_pool_acquire_wait_seconds_bucket", labels + ",le=\"" + le + "\"", cumulative);
+			}
+			sample("sqlcpp_pool_acquire_wait_seconds_sum", labels, std::chrono::duration<double>(s.acquire_wait_sum).count());
+			sample("sqlcpp_pool_acquire_wait_seconds_count", labels, cumulative);
+		}
+		return out;
+	}
+
+	inline std::string to_prometheus(const pool_stats& pool) {
+		return to_prometheus(std::vector<pool_stats>{ pool });
+	}
+}
@@ -0,0 +1,1370 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <list>
+#include <unordered_map>
+#include <optional>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <tuple>
+#include <typeinfo>
+#include <type_traits>
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <poll.h>
+#endif
+#ifdef SQLCPP_MOCK_DRIVER
+#include "mock/libpq-fe.h"
+#else
+#include <libpq-fe.h>
+#endif
+#include "db_common.h"
+#include "db_error.hpp"
+#include "trace.hpp"
+#include "logger.hpp"
+#include "db_meta.hpp"
+#include "exception.hpp"
+#include "reflection.hpp"
+#include "reflect_sql.hpp"
+
+namespace sqlcpp::postgres {
+	struct statement_cache_stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0; //PQprepare round trips were made
+		uint64_t evictions = 0;
+		size_t size = 0;
+	};
+
+	// SQLSTATE as an int, packed like postgres' MAKE_SQLSTATE. error codes of this backend are these
+	constexpr int sqlstate_code(std::string_view sql_state) {
+		int code = 0;
+		for (size_t i = 0; i < sql_state.length() && i < 5; i++) {
+			code += ((sql_state[i] - '0') & 0x3F) << (6 * i);
+		}
+		return code;
+	}
+
+	namespace detail {
+		//oids of built-in types, fixed in pg_type
+		constexpr Oid bool_oid = 16;
+		constexpr Oid bytea_oid = 17;
+		constexpr Oid char_oid = 18;
+		constexpr Oid name_oid = 19;
+		constexpr Oid int8_oid = 20;
+		constexpr Oid int2_oid = 21;
+		constexpr Oid int4_oid = 23;
+		constexpr Oid text_oid = 25;
+		constexpr Oid oid_oid = 26;
+		constexpr Oid json_oid = 114;
+		constexpr Oid xml_oid = 142;
+		constexpr Oid float4_oid = 700;
+		constexpr Oid float8_oid = 701;
+		constexpr Oid unknown_oid = 705;
+		constexpr Oid bpchar_oid = 1042;
+		constexpr Oid varchar_oid = 1043;
+		constexpr Oid date_oid = 1082;
+		constexpr Oid time_oid = 1083;
+		constexpr Oid timestamp_oid = 1114;
+		constexpr Oid timestamptz_oid = 1184;
+		constexpr Oid numeric_oid = 1700;
+		constexpr Oid uuid_oid = 2950;
+		constexpr Oid jsonb_oid = 3802;
+
+		constexpr int64_t pg_epoch = 946684800; //2000-01-01 in unix seconds, dates and timestamps count from it
+
+		struct result_deleter {
+			void operator()(PGresult* res) const {
+				PQclear(res);
+			}
+		};
+		using result_ptr = std::unique_ptr<PGresult, result_deleter>;
+
+		// ? to $1, $2... and ?? to a literal ?, like jsonb operators. quoted text, dollar quotes and comments are kept.
+		// return the placeholder count
+		inline size_t to_positional(std::string_view sql, std::string& out) {
+			out.clear();
+			out.reserve(sql.length() + 16);
+			size_t count = 0;
+			size_t i = 0;
+			auto copy_through = [&sql, &out, &i](std::string_view end, size_t from) {
+				auto pos = sql.find(end, from);
+				pos = pos == std::string_view::npos ? sql.length() : pos + end.length();
+				out.append(sql.substr(i, pos - i));
+				i = pos;
+			};
+			auto is_word = [](char c) {
+				return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+			};
+
+			while (i < sql.length()) {
+				char c = sql[i];
+				char next = i + 1 < sql.length() ? sql[i + 1] : '\0';
+				if (c == '\'') {
+					bool escapes = i > 0 && (sql[i - 1] == 'E' || sql[i - 1] == 'e'); //E'it\'s'
+					size_t j = i + 1;
+					while (j < sql.length() && sql[j] != '\'') {
+						j += escapes && sql[j] == '\\' ? 2 : 1;
+					}
+					j = (std::min)(j + 1, sql.length());
+					out.append(sql.substr(i, j - i));
+					i = j;
+				}
+				else if (c == '"') {
+					copy_through("\"", i + 1);
+				}
+				else if (c == '-' && next == '-') {
+					copy_through("\n", i + 2);
+				}
+				else if (c == '/' && next == '*') {
+					copy_through("*/", i + 2);
+				}
+				else if (c == '$' && !(next >= '0' && next <= '9')) { //$tag$ ... $tag$, $1 is a placeholder
+					size_t j = i + 1;
+					while (j < sql.length() && is_word(sql[j])) {
+						j++;
+					}
+					if (j < sql.length() && sql[j] == '$') {
+						copy_through(sql.substr(i, j + 1 - i), j + 1);
+					}
+					else {
+						out += c;
+						i++;
+					}
+				}
+				else if (c == '?') {
+					if (next == '?') {
+						out += '?';
+						i += 2;
+					}
+					else {
+						out.append("$").append(std::to_string(++count));
+						i++;
+					}
+				}
+				else {
+					out += c;
+					i++;
+				}
+			}
+			return count;
+		}
+
+		// placeholders to_positional finds at compile time: ? but not ??, or $1, $2... by the highest number like postgres.
+		// quoted text, dollar quotes and comments are skipped
+		constexpr size_t count_placeholders(std::string_view sql) {
+			size_t count = 0;
+			size_t highest = 0;
+			size_t i = 0;
+			auto skip_through = [&sql, &i](std::string_view end, size_t from) {
+				auto pos = sql.find(end, from);
+				i = pos == std::string_view::npos ? sql.length() : pos + end.length();
+			};
+			auto is_word = [](char c) {
+				return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+			};
+
+			while (i < sql.length()) {
+				char c = sql[i];
+				char next = i + 1 < sql.length() ? sql[i + 1] : '\0';
+				if (c == '\'') {
+					bool escapes = i > 0 && (sql[i - 1] == 'E' || sql[i - 1] == 'e');
+					size_t j = i + 1;
+					while (j < sql.length() && sql[j] != '\'') {
+						j += escapes && sql[j] == '\\' ? 2 : 1;
+					}
+					i = (std::min)(j + 1, sql.length());
+				}
+				else if (c == '"') {
+					skip_through("\"", i + 1);
+				}
+				else if (c == '-' && next == '-') {
+					skip_through("\n", i + 2);
+				}
+				else if (c == '/' && next == '*') {
+					skip_through("*/", i + 2);
+				}
+				else if (c == '$' && next >= '0' && next <= '9') {
+					size_t n = 0;
+					while (++i < sql.length() && sql[i] >= '0' && sql[i] <= '9') {
+						n = n * 10 + (size_t)(sql[i] - '0');
+					}
+					highest = (std::max)(highest, n);
+				}
+				else if (c == '$') {
+					size_t j = i + 1;
+					while (j < sql.length() && is_word(sql[j])) {
+						j++;
+					}
+					if (j < sql.length() && sql[j] == '$') {
+						skip_through(sql.substr(i, j + 1 - i), j + 1);
+					}
+					else {
+						i++;
+					}
+				}
+				else if (c == '?') {
+					count += next == '?' ? 0 : 1;
+					i += next == '?' ? 2 : 1;
+				}
+				else {
+					i++;
+				}
+			}
+			return (std::max)(count, highest);
+		}
+
+		template<typename T>
+		constexpr Oid type_of() {
+			if constexpr (is_optional_v<T>) {
+				return type_of<typename T::value_type>();
+			}
+			else if constexpr (std::is_same_v<T, bool>) {
+				return bool_oid;
+			}
+			else if constexpr (std::is_integral_v<T>) {
+				if constexpr (sizeof(T) == 1 || (sizeof(T) == 2 && std::is_signed_v<T>)) {
+					return int2_oid;
+				}
+				else if constexpr (sizeof(T) == 2 || (sizeof(T) == 4 && std::is_signed_v<T>)) {
+					return int4_oid;
+				}
+				else if constexpr (std::is_signed_v<T> || sizeof(T) == 4) {
+					return int8_oid;
+				}
+				else {
+					return numeric_oid; //uint64 above int8
+				}
+			}
+			else if constexpr (std::is_same_v<T, float>) {
+				return float4_oid;
+			}
+			else if constexpr (std::is_same_v<T, double>) {
+				return float8_oid;
+			}
+			else if constexpr (is_char_pointer_v<T> || is_char_array_v<T> || std::is_convertible_v<T, std::string> || std::is_same_v<T, std::string_view>) {
+				return 0; //unknown, the server takes the type of where it is used, like '2024-01-01' for a date
+			}
+			else {
+				static_assert(always_false_v<T>, "can not map to postgres type");
+			}
+		}
+
+		// parameters of one statement in libpq arrays. numbers are sent binary, strings as text
+		class param_buffer {
+		private:
+			std::vector<Oid> types_;
+			std::vector<const char*> values_;
+			std::vector<int> lengths_;
+			std::vector<int> formats_;
+			std::vector<std::array<char, 8>> binary_; //reserved, so values_ can point into it
+			std::vector<std::string> text_; //reserved too
+			bool copy_ = false; //strings are copied too, values outlive the args
+		public:
+			param_buffer(const param_buffer&) = delete;
+			param_buffer& operator=(const param_buffer&) = delete;
+			param_buffer(param_buffer&&) = default;
+			param_buffer& operator=(param_buffer&&) = default;
+
+			explicit param_buffer(size_t count, bool copy = false) :copy_(copy) {
+				types_.reserve(count);
+				values_.reserve(count);
+				lengths_.reserve(count);
+				formats_.reserve(count);
+				binary_.reserve(count);
+				text_.reserve(count);
+			}
+
+			template<typename T>
+			void add(const T& v) {
+				using U = std::remove_cv_t<T>;
+				if constexpr (is_optional_v<U>) {
+					if (v.has_value()) {
+						add(*v);
+					}
+					else {
+						push(type_of<U>(), nullptr, 0, 0);
+					}
+				}
+				else if constexpr (std::is_same_v<U, float>) {
+					uint32_t bits = 0;
+					std::memcpy(&bits, &v, sizeof(bits));
+					put_binary(float4_oid, bits, 4);
+				}
+				else if constexpr (std::is_same_v<U, double>) {
+					uint64_t bits = 0;
+					std::memcpy(&bits, &v, sizeof(bits));
+					put_binary(float8_oid, bits, 8);
+				}
+				else if constexpr (std::is_integral_v<U> && type_of<U>() == numeric_oid) {
+					put_text(numeric_oid, std::to_string(v));
+				}
+				else if constexpr (std::is_integral_v<U>) {
+					constexpr Oid type = type_of<U>();
+					put_binary(type, (uint64_t)(int64_t)v, type == int2_oid ? 2 : (type == int4_oid ? 4 : (type == bool_oid ? 1 : 8)));
+				}
+				else if constexpr (is_char_pointer_v<U>) {
+					if (v == nullptr) {
+						push(0, nullptr, 0, 0);
+					}
+					else if (copy_) {
+						put_text(0, v);
+					}
+					else {
+						push(0, v, 0, 0);
+					}
+				}
+				else if constexpr (std::is_same_v<U, std::string>) {
+					if (copy_) {
+						put_text(0, v);
+					}
+					else {
+						push(0, v.c_str(), 0, 0);
+					}
+				}
+				else {
+					static_assert(type_of<U>() == 0, "can not map to postgres type");
+					put_text(0, std::string(std::string_view(v))); //text params need a terminating zero
+				}
+			}
+
+			size_t size() const {
+				return types_.size();
+			}
+
+			const std::vector<Oid>& types() const {
+				return types_;
+			}
+
+			const char* const* values() const {
+				return values_.data();
+			}
+
+			const int* lengths() const {
+				return lengths_.data();
+			}
+
+			const int* formats() const {
+				return formats_.data();
+			}
+		private:
+			void push(Oid type, const char* value, int length, int format) {
+				types_.push_back(type);
+				values_.push_back(value);
+				lengths_.push_back(length);
+				formats_.push_back(format);
+			}
+
+			// network byte order
+			void put_binary(Oid type, uint64_t v, int length) {
+				auto& b = binary_.emplace_back();
+				for (int i = 0; i < length; i++) {
+					b[(size_t)i] = (char)(v >> (8 * (length - 1 - i)));
+				}
+				push(type, b.data(), length, 1);
+			}
+
+			void put_text(Oid type, std::string s) {
+				auto& t = text_.emplace_back(std::move(s));
+				push(type, t.c_str(), 0, 0);
+			}
+		};
+
+		// big endian, sign extended
+		inline int64_t read_int(const char* p, int length) {
+			uint64_t v = 0;
+			for (int i = 0; i < length; i++) {
+				v = (v << 8) | (unsigned char)p[i];
+			}
+			if (length > 0 && length < 8 && ((v >> (length * 8 - 1)) & 1)) {
+				v |= ~uint64_t(0) << (length * 8);
+			}
+			return (int64_t)v;
+		}
+
+		inline double read_float(Oid type, const char* p) {
+			if (type == float4_oid) {
+				auto bits = (uint32_t)read_int(p, 4);
+				float f = 0;
+				std::memcpy(&f, &bits, sizeof(f));
+				return f;
+			}
+			auto bits = (uint64_t)read_int(p, 8);
+			double d = 0;
+			std::memcpy(&d, &bits, sizeof(d));
+			return d;
+		}
+
+		// ndigits, weight, sign, dscale, then base 10000 digits
+		inline std::string numeric_text(const char* p, int length) {
+			if (length < 8) {
+				throw except::postgres_exception("bad numeric value");
+			}
+			auto ndigits = (int)read_int(p, 2);
+			auto weight = (int)read_int(p + 2, 2);
+			auto sign = (uint16_t)read_int(p + 4, 2);
+			auto dscale = (int)read_int(p + 6, 2);
+			if (sign == 0xC000) {
+				return "NaN";
+			}
+			if (sign == 0xD000 || sign == 0xF000) {
+				return sign == 0xD000 ? "Infinity" : "-Infinity";
+			}
+			auto digit = [p, length, ndigits](int i) {
+				return i >= 0 && i < ndigits && 8 + i * 2 + 2 <= length ? (int)read_int(p + 8 + i * 2, 2) : 0;
+			};
+
+			std::string s = sign == 0x4000 ? "-" : "";
+			char buf[8];
+			if (weight < 0) {
+				s += '0';
+			}
+			for (int i = 0; i <= weight; i++) {
+				snprintf(buf, sizeof(buf), i == 0 ? "%d" : "%04d", digit(i));
+				s += buf;
+			}
+			if (dscale > 0) {
+				std::string fraction;
+				for (int i = weight + 1; (int)fraction.length() < dscale; i++) {
+					snprintf(buf, sizeof(buf), "%04d", digit(i));
+					fraction += buf;
+				}
+				s.append(".").append(fraction, 0, (size_t)dscale);
+			}
+			return s;
+		}
+
+		// days since 1970-01-01 to yyyy-mm-dd
+		inline std::string date_text(int64_t days) {
+			days += 719468;
+			auto era = (days >= 0 ? days : days - 146096) / 146097;
+			auto doe = (unsigned)(days - era * 146097);
+			auto yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+			auto doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+			auto mp = (5 * doy + 2) / 153;
+			auto day = doy - (153 * mp + 2) / 5 + 1;
+			auto month = mp < 10 ? mp + 3 : mp - 9;
+			auto year = (int64_t)yoe + era * 400 + (month <= 2);
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%04lld-%02u-%02u", (long long)year, month, day);
+			return buf;
+		}
+
+		// microseconds of a day to hh:mm:ss.ffffff, trailing zeros of the fraction dropped
+		inline std::string time_text(int64_t us) {
+			char buf[32];
+			auto seconds = us / 1000000;
+			snprintf(buf, sizeof(buf), "%02lld:%02lld:%02lld", (long long)(seconds / 3600), (long long)(seconds / 60 % 60), (long long)(seconds % 60));
+			std::string s = buf;
+			if (auto fraction = us % 1000000; fraction != 0) {
+				snprintf(buf, sizeof(buf), ".%06lld", (long long)fraction);
+				s += buf;
+				while (s.back() == '0') {
+					s.pop_back();
+				}
+			}
+			return s;
+		}
+
+		inline int64_t floor_div(int64_t a, int64_t b) {
+			return a / b - (a % b != 0 && (a < 0) != (b < 0));
+		}
+
+		inline std::string timestamp_text(int64_t us) {
+			if (us == INT64_MAX || us == INT64_MIN) {
+				return us == INT64_MAX ? "infinity" : "-infinity";
+			}
+			auto days = floor_div(us, 86400000000LL);
+			return date_text(days + pg_epoch / 86400) + " " + time_text(us - days * 86400000000LL);
+		}
+
+		inline bool is_text(Oid type) {
+			return type == text_oid || type == varchar_oid || type == bpchar_oid || type == name_oid || type == char_oid
+				|| type == unknown_oid || type == json_oid || type == xml_oid;
+		}
+
+		// binary value of type as text, like the server would print it. timestamptz is in UTC
+		inline std::string text_of(Oid type, const char* p, int length) {
+			char buf[64];
+			switch (type) {
+			case bool_oid:
+				return p[0] ? "t" : "f";
+			case int2_oid:
+			case int4_oid:
+			case int8_oid:
+				return std::to_string(read_int(p, length));
+			case oid_oid:
+				return std::to_string((uint32_t)read_int(p, 4));
+			case float4_oid:
+			case float8_oid:
+				snprintf(buf, sizeof(buf), type == float4_oid ? "%.9g" : "%.17g", read_float(type, p));
+				return buf;
+			case numeric_oid:
+				return numeric_text(p, length);
+			case date_oid: {
+				auto days = read_int(p, 4);
+				if (days == INT32_MAX || days == INT32_MIN) {
+					return days == INT32_MAX ? "infinity" : "-infinity";
+				}
+				return date_text(days + pg_epoch / 86400);
+			}
+			case time_oid:
+				return time_text(read_int(p, 8));
+			case timestamp_oid:
+				return timestamp_text(read_int(p, 8));
+			case timestamptz_oid:
+				return timestamp_text(read_int(p, 8)) + "+00";
+			case uuid_oid: {
+				std::string s;
+				for (int i = 0; i < length; i++) {
+					snprintf(buf, sizeof(buf), "%02x", (unsigned char)p[i]);
+					s.append(i == 4 || i == 6 || i == 8 || i == 10 ? "-" : "").append(buf);
+				}
+				return s;
+			}
+			case jsonb_oid:
+				return length > 0 ? std::string(p + 1, (size_t)length - 1) : std::string(); //version byte first
+			default:
+				if (is_text(type) || type == bytea_oid) { //bytea as raw bytes
+					return std::string(p, (size_t)length);
+				}
+				//binary forms of arrays, interval, inet, enums and others are not text, cast them in sql like col::text
+				throw except::postgres_exception("can not convert column type " + std::to_string(type) + " to a string, cast it to text");
+			}
+		}
+
+		// numbers from numeric types, bool, text, and dates or timestamps as unix seconds
+		inline int64_t int_of(Oid type, const char* p, int length) {
+			switch (type) {
+			case bool_oid:
+				return p[0] ? 1 : 0;
+			case int2_oid:
+			case int4_oid:
+			case int8_oid:
+				return read_int(p, length);
+			case oid_oid:
+				return (uint32_t)read_int(p, 4);
+			case float4_oid:
+			case float8_oid:
+				return (int64_t)read_float(type, p);
+			case numeric_oid:
+				return std::strtoll(numeric_text(p, length).c_str(), nullptr, 10);
+			case date_oid:
+				return read_int(p, 4) * 86400 + pg_epoch;
+			case timestamp_oid:
+			case timestamptz_oid:
+				return floor_div(read_int(p, 8), 1000000) + pg_epoch;
+			default:
+				if (is_text(type)) {
+					return std::strtoll(std::string(p, (size_t)length).c_str(), nullptr, 10);
+				}
+				throw except::postgres_exception("can not convert column type " + std::to_string(type) + " to a number");
+			}
+		}
+
+		inline double double_of(Oid type, const char* p, int length) {
+			switch (type) {
+			case float4_oid:
+			case float8_oid:
+				return read_float(type, p);
+			case numeric_oid:
+				return std::strtod(numeric_text(p, length).c_str(), nullptr);
+			case timestamp_oid:
+			case timestamptz_oid:
+				return (double)read_int(p, 8) / 1e6 + (double)pg_epoch;
+			default:
+				if (is_text(type)) {
+					return std::strtod(std::string(p, (size_t)length).c_str(), nullptr);
+				}
+				return (double)int_of(type, p, length);
+			}
+		}
+
+		template<typename T>
+		void assign(T& out, Oid type, const char* p, int length) {
+			if constexpr (std::is_same_v<T, bool>) {
+				out = int_of(type, p, length) != 0;
+			}
+			else if constexpr (std::is_integral_v<T>) {
+				out = (T)int_of(type, p, length);
+			}
+			else if constexpr (std::is_floating_point_v<T>) {
+				out = (T)double_of(type, p, length);
+			}
+			else if constexpr (std::is_same_v<T, std::string>) {
+				out = text_of(type, p, length);
+			}
+			else {
+				static_assert(always_false_v<T>, "can not map from postgres type");
+			}
+		}
+
+		template<typename T>
+		void read_cell(T& value, const PGresult* res, int row, int column, Oid type) {
+			if (PQgetisnull(res, row, column)) {
+				if constexpr (is_optional_v<T>) {
+					value.reset();
+				}
+				return; //default value
+			}
+			auto p = PQgetvalue(res, row, column);
+			auto length = PQgetlength(res, row, column);
+			if constexpr (is_optional_v<T>) {
+				typename T::value_type v{};
+				assign(v, type, p, length);
+				value = std::move(v);
+			}
+			else {
+				assign(value, type, p, length);
+			}
+		}
+
+		template<typename T>
+		constexpr size_t column_count() {
+			if constexpr (is_row<T>::value) {
+				return row_size_v<T>;
+			}
+			else {
+				return 1;
+			}
+		}
+
+		// rows of a binary result. columns by position, or column_map[i] for member i
+		template<typename ReturnType>
+		std::vector<ReturnType> read_rows(const PGresult* res, const int* column_map = nullptr) {
+			constexpr size_t element_size = column_count<ReturnType>();
+			if (column_map == nullptr && (size_t)PQnfields(res) != element_size) {
+				throw except::postgres_exception("columns in the query do not match return type, " + std::to_string(PQnfields(res)) +
+					" columns but " + std::to_string(element_size) + " expected");
+			}
+			std::array<int, element_size> columns{};
+			std::array<Oid, element_size> types{};
+			for (size_t i = 0; i < element_size; i++) {
+				columns[i] = column_map != nullptr ? column_map[i] : (int)i;
+				types[i] = PQftype(res, columns[i]);
+			}
+
+			auto count = PQntuples(res);
+			std::vector<ReturnType> rows;
+			rows.reserve((size_t)count);
+			for (int r = 0; r < count; r++) {
+				ReturnType row{};
+				if constexpr (is_tuple_v<ReturnType>) {
+					for_each_tuple([&](auto index) {
+						read_cell(std::get<index>(row), res, r, columns[index], types[index]);
+					}, std::make_index_sequence<element_size>());
+				}
+				else if constexpr (reflection::is_reflection_v<ReturnType>) {
+					constexpr auto address = ReturnType::elements_address();
+					for_each_tuple([&](auto index) {
+						read_cell(row.*std::get<index>(address), res, r, columns[index], types[index]);
+					}, std::make_index_sequence<element_size>());
+				}
+				else {
+					read_cell(row, res, r, columns[0], types[0]);
+				}
+				rows.emplace_back(std::move(row));
+			}
+			return rows;
+		}
+
+		template<typename... Args>
+		param_buffer make_params(bool copy, Args&&...args) {
+			param_buffer params(param_size_v<Args...>, copy);
+			std::apply([&params](const auto&... v) {
+				(params.add(v), ...);
+			}, param_refs(std::forward<Args>(args)...));
+			return params;
+		}
+
+		// wait until the socket is readable or writable
+		inline bool wait_socket(int fd) {
+#ifdef _WIN32
+			WSAPOLLFD pfd{ (SOCKET)fd, POLLIN | POLLOUT, 0 };
+			return WSAPoll(&pfd, 1, -1) > 0;
+#else
+			pollfd pfd{ fd, POLLIN | POLLOUT, 0 };
+			return poll(&pfd, 1, -1) > 0;
+#endif
+		}
+	}
+
+	class pipeline;
+
+	class connection {
+	public:
+		static constexpr size_t max_batch_params = 65535; //parameters limit of one postgres statement
+	private:
+		friend class pipeline;
+
+		bool is_health_ = false;
+		bool session_dirty_ = false; //session state may be changed by raw sql
+		inline static std::atomic<int> conn_count_ = 0;
+		std::string ip_;
+		PGconn* conn_ = nullptr;
+		scope_guard<std::function<void()>> deleter_{};
+
+		//named prepared statements keyed by sql, keys point to the sql in lru list
+		struct prepared_stmt {
+			std::string name;
+			std::vector<Oid> param_types{};
+			std::list<std::string>::iterator lru_iter{};
+			const std::type_info* mapped_type = nullptr; //struct of column_map, see query_by_name
+			std::vector<int> column_map{}; //result column index of every member
+		};
+		size_t stmt_cache_size_ = 256;
+		std::list<std::string> stmt_lru_; //front is the newest
+		std::unordered_map<std::string_view, prepared_stmt> stmt_cache_;
+		std::vector<std::string> deallocate_; //evicted statements still prepared on the server
+		uint64_t stmt_seq_ = 0;
+		prepared_stmt* prepared_ = nullptr; //of the last query, null when the cache is off
+		std::vector<int> uncached_map_{};
+		std::string positional_{};
+		statement_cache_stats stmt_stats_{};
+		trace::recorder recorder_{ "postgres" };
+
+	public:
+		connection(const connection&) = delete;
+		connection& operator=(const connection&) = delete;
+
+		// conninfo is appended to the options, like "dbname=app sslmode=require"
+		connection(const connection_options& opt, const std::string& conninfo = "") {
+			ip_ = opt.ip;
+			deleter_.set_releaser([this]() {
+				if (conn_ != nullptr) {
+					PQfinish(conn_);
+				}
+			});
+
+			//expand_dbname parses the first dbname as a connection string, its keywords win over the ones before
+			const char* keywords[] = { "host", "port", "user", "password", "connect_timeout", "dbname", nullptr };
+			const char* values[] = { opt.ip.c_str(), opt.port.c_str(), opt.user.c_str(), opt.passwd.c_str(), "3", conninfo.c_str(), nullptr };
+			conn_ = PQconnectdbParams(keywords, values, 1);
+			if (conn_ == nullptr) {
+				throw except::postgres_exception("PQconnectdbParams error: out of memory");
+			}
+			if (PQstatus(conn_) != CONNECTION_OK) {
+				throw except::postgres_exception("Failed to connect to database:" + trimmed(PQerrorMessage(conn_)));
+			}
+			is_health_ = true;
+			recorder_.set_node(ip_);
+			conn_count_++;
+			SQLCPP_LOG(trace, "postgres create conn <%s>, count:%d", ip_.c_str(), conn_count_.load());
+		}
+
+		~connection() {
+			conn_count_--;
+			SQLCPP_LOG(trace, "postgres release conn <%s>, count:%d", ip_.c_str(), conn_count_.load());
+		}
+
+		void execute(const std::string& sql) {
+			session_dirty_ = true;
+			execute_sql(sql);
+		}
+
+		void begin_transaction() {
+			execute_sql("BEGIN");
+		}
+
+		void commit_transaction() {
+			//COMMIT of a failed transaction rolls back without an error
+			if (execute_sql("COMMIT") == "ROLLBACK") {
+				constexpr auto code = sqlstate_code("25P02");
+				recorder_.error(code);
+				throw except::postgres_exception("transaction was aborted by an earlier error, rolled back", code);
+			}
+		}
+
+		void rollback() {
+			execute_sql("ROLLBACK");
+		}
+
+		// make the session clean before going back to pool. false means the connection should be dropped.
+		// prepared statements are kept, unlike DISCARD ALL, so the statement cache stays valid
+		bool reset_session() {
+			if (!is_health_ || PQstatus(conn_) != CONNECTION_OK) {
+				return false;
+			}
+
+			auto status = PQtransactionStatus(conn_);
+			if (status == PQTRANS_IDLE && !session_dirty_) {
+				return true;
+			}
+			if (status != PQTRANS_IDLE && status != PQTRANS_INTRANS && status != PQTRANS_INERROR) {
+				return false; //busy or unknown
+			}
+
+			if (status != PQTRANS_IDLE && !simple_ok("ROLLBACK")) {
+				return false;
+			}
+			if (session_dirty_ && !simple_ok("CLOSE ALL; SET SESSION AUTHORIZATION DEFAULT; RESET ALL; UNLISTEN *; "
+				"SELECT pg_advisory_unlock_all(); DISCARD TEMP; DISCARD SEQUENCES")) {
+				return false;
+			}
+			session_dirty_ = false;
+			return true;
+		}
+
+		bool is_health() {
+			return is_health_;
+		}
+
+		const std::string& get_ip() const {
+			return ip_;
+		}
+
+		// a round trip with an empty query, pools call it only for connections idle for a while
+		bool is_alive() {
+			detail::result_ptr res(PQexec(conn_, ""));
+			if (PQresultStatus(res.get()) != PGRES_EMPTY_QUERY || PQstatus(conn_) != CONNECTION_OK) {
+				is_health_ = false;
+			}
+			return is_health_;
+		}
+
+#ifdef SQLCPP_TRACE
+		// queries are reported to o, null stops it. pools set their observer on every checkout
+		void set_observer(std::shared_ptr<trace::observer> o) {
+			recorder_.set_observer(std::move(o));
+		}
+
+		void trace_acquired(std::shared_ptr<trace::observer> o, std::chrono::nanoseconds wait) {
+			recorder_.acquired(std::move(o), wait);
+		}
+
+#endif
+		// max prepared statements kept by this connection, 0 disables the cache and every query is parsed again
+		void set_statement_cache_size(size_t size) {
+			stmt_cache_size_ = size;
+			while (stmt_cache_.size() > stmt_cache_size_) {
+				evict_stmt();
+			}
+		}
+
+		statement_cache_stats get_statement_cache_stats() const {
+			auto stats = stmt_stats_;
+			stats.size = stmt_cache_.size();
+			return stats;
+		}
+
+		// serialization failure, deadlock or lock not available, the transaction can be run again
+		static bool is_retriable_error(int error_code) {
+			return error_code == sqlstate_code("40001") || error_code == sqlstate_code("40P01") || error_code == sqlstate_code("55P03");
+		}
+
+		// ? placeholders, or $1, $2... as postgres writes them. the statement is prepared once per connection
+		// and the results come back binary
+		template<typename ReturnType, typename... Args>
+		query_result_t<ReturnType> query(std::string_view statement_sql, Args&&...args) {
+			auto span = recorder_.start(statement_sql);
+			auto params = detail::make_params(false, std::forward<Args>(args)...);
+			recorder_.mark(trace::phase::bind);
+			auto res = run_or_throw(statement_sql, params);
+			return read_result<ReturnType>(res.get());
+		}
+
+		// columns are matched to members by name(case insensitive), not by position. extra columns are ignored.
+		// the mapping is made once and cached with the prepared statement
+		template<typename ReturnType, typename... Args>
+		std::vector<ReturnType> query_by_name(std::string_view statement_sql, Args&&...args) {
+			static_assert(reflection::is_reflection_v<ReturnType>, "query_by_name needs REFLECT struct");
+			auto span = recorder_.start(statement_sql);
+			auto params = detail::make_params(false, std::forward<Args>(args)...);
+			recorder_.mark(trace::phase::bind);
+			auto res = run_or_throw(statement_sql, params);
+			return read_result<ReturnType>(res.get(), mapped_columns<ReturnType>(res.get()).data());
+		}
+
+#ifdef SQLCPP_HAS_FIXED_STRING
+		// sql is a template argument, placeholders are counted at compile time
+		template<typename ReturnType, sql::fixed_string Sql, typename... Args>
+		query_result_t<ReturnType> query(Args&&...args) {
+			using statement = sql::statement<Sql>;
+			static_assert(detail::count_placeholders(statement::text) == param_size_v<Args...>, "param size do not match placeholder size");
+			return query<ReturnType>(statement::text, std::forward<Args>(args)...);
+		}
+#endif
+
+		// same as query, but errors are returned instead of thrown. for hot paths expecting errors, like duplicate key
+		template<typename ReturnType, typename... Args>
+		expected<query_result_t<ReturnType>> try_query(std::string_view statement_sql, Args&&...args) {
+			auto span = recorder_.start(statement_sql);
+			try {
+				auto params = detail::make_params(false, std::forward<Args>(args)...);
+				recorder_.mark(trace::phase::bind);
+				const char* where = "";
+				auto res = run(statement_sql, params, where);
+				if (!is_ok(res.get())) {
+					return unexpected(result_error(res.get(), where));
+				}
+				if constexpr (std::is_same_v<ReturnType, void>) {
+					return {};
+				}
+				else {
+					return read_result<ReturnType>(res.get());
+				}
+			}
+			catch (const except::sql_exception& e) { //param mismatch or decode failed, rare
+				return unexpected(db_error(e.get_error_code(), {}, "query", e.what()));
+			}
+		}
+
+		// bind rows one after another to a multi-row statement, like insert into t(a,b) values(?,?),(?,?)
+		template<typename T>
+		void query_batch(std::string_view statement_sql, const std::vector<T>& rows) {
+			static_assert(is_tuple_v<T> || reflection::is_reflection_v<T>, "row type must be tuple or reflect struct");
+			auto span = recorder_.start(statement_sql);
+			detail::param_buffer params(rows.size() * row_size_v<T>);
+			for (const auto& row : rows) {
+				std::apply([&params](const auto&... v) {
+					(params.add(v), ...);
+				}, row_refs(row, std::make_index_sequence<row_size_v<T>>()));
+			}
+			recorder_.mark(trace::phase::bind);
+			recorder_.rows((uint64_t)rows.size());
+			run_or_throw(statement_sql, params);
+		}
+
+	private:
+		static std::string trimmed(const char* message) {
+			std::string s = message != nullptr ? message : "";
+			while (!s.empty() && (s.back() == '\n' || s.back() == ' ')) {
+				s.pop_back();
+			}
+			return s;
+		}
+
+		static bool is_ok(const PGresult* res) {
+			auto status = PQresultStatus(res);
+			return status == PGRES_TUPLES_OK || status == PGRES_COMMAND_OK;
+		}
+
+		// error of a failed result. connection errors and server shutdown make the connection unhealthy
+		db_error result_error(const PGresult* res, const char* where) {
+			const char* state = res != nullptr ? PQresultErrorField(res, PG_DIAG_SQLSTATE) : nullptr;
+			std::string_view sql_state = state != nullptr ? state : "";
+			auto message = trimmed(res != nullptr ? PQresultErrorMessage(res) : PQerrorMessage(conn_));
+			if (PQstatus(conn_) != CONNECTION_OK || sql_state.substr(0, 2) == "08" || sql_state.substr(0, 3) == "57P") {
+				is_health_ = false;
+			}
+			auto code = sqlstate_code(sql_state);
+			recorder_.error(code);
+			return db_error(code, sql_state, where, std::move(message));
+		}
+
+		// simple query protocol, return the command tag
+		std::string execute_sql(const std::string& sql) {
+			detail::result_ptr res(PQexec(conn_, sql.c_str()));
+			if (!is_ok(res.get()) && PQresultStatus(res.get()) != PGRES_EMPTY_QUERY) {
+				auto e = result_error(res.get(), "PQexec");
+				throw except::postgres_exception("Failed to excute sql<" + sql + ">: " + e.message(), e.code());
+			}
+			return PQcmdStatus(res.get());
+		}
+
+		bool simple_ok(const char* sql) {
+			detail::result_ptr res(PQexec(conn_, sql));
+			if (!is_ok(res.get())) {
+				result_error(res.get(), "PQexec");
+				return false;
+			}
+			return true;
+		}
+
+		detail::result_ptr run_or_throw(std::string_view statement_sql, const detail::param_buffer& params) {
+			const char* where = "";
+			auto res = run(statement_sql, params, where);
+			if (!is_ok(res.get())) {
+				auto e = result_error(res.get(), where);
+				throw except::postgres_exception(std::string(where) == "PQprepare" ?
+					"Failed to PQprepare sql<" + std::string(statement_sql) + ">: " + e.message() : e.message(), e.code());
+			}
+			return res;
+		}
+
+		// prepared on a cache miss, then executed with binary results. a failed result is returned, where tells the step
+		detail::result_ptr run(std::string_view statement_sql, const detail::param_buffer& params, const char*& where) {
+			auto cached = find_stmt(statement_sql, params.types());
+			auto res = execute_prepared(statement_sql, params, cached, where);
+			//select * plans are invalid after the table changed, the statement fails every time until prepared again.
+			//retried at once unless a transaction was aborted by it
+			if (cached != nullptr && is_stale_plan(res.get())) {
+				drop_stmt(statement_sql);
+				if (PQtransactionStatus(conn_) == PQTRANS_IDLE) {
+					res = execute_prepared(statement_sql, params, nullptr, where);
+				}
+			}
+			return res;
+		}
+
+		// cached plan must not change result type
+		static bool is_stale_plan(const PGresult* res) {
+			const char* state = res != nullptr ? PQresultErrorField(res, PG_DIAG_SQLSTATE) : nullptr;
+			return state != nullptr && std::string_view(state) == "0A000";
+		}
+
+		detail::result_ptr execute_prepared(std::string_view statement_sql, const detail::param_buffer& params, prepared_stmt* stmt, const char*& where) {
+			auto count = (int)params.size();
+			prepared_ = stmt;
+			if (stmt == nullptr) {
+				stmt_stats_.misses++;
+				auto placeholders = detail::to_positional(statement_sql, positional_);
+				if (placeholders != 0 && placeholders != params.size()) {
+					throw except::postgres_exception("param size do not match placeholder size");
+				}
+				if (stmt_cache_size_ == 0) { //unnamed statement, parsed and run in one round trip
+					where = "PQexecParams";
+					detail::result_ptr res(PQexecParams(conn_, positional_.c_str(), count, params.types().data(),
+						params.values(), params.lengths(), params.formats(), 1));
+					recorder_.mark(trace::phase::execute);
+					return res;
+				}
+
+				deallocate_evicted();
+				auto name = next_stmt_name();
+				where = "PQprepare";
+				detail::result_ptr res(PQprepare(conn_, name.c_str(), positional_.c_str(), count, params.types().data()));
+				recorder_.mark(trace::phase::prepare);
+				if (!is_ok(res.get())) {
+					return res;
+				}
+				stmt = prepared_ = &cache_stmt(statement_sql, std::move(name), params.types());
+			}
+
+			where = "PQexecPrepared";
+			detail::result_ptr res(PQexecPrepared(conn_, stmt->name.c_str(), count, params.values(), params.lengths(), params.formats(), 1));
+			recorder_.mark(trace::phase::execute);
+			return res;
+		}
+
+		template<typename ReturnType>
+		query_result_t<ReturnType> read_result(const PGresult* res, const int* column_map = nullptr) {
+			if constexpr (!std::is_same_v<ReturnType, void>) {
+				auto rows = detail::read_rows<ReturnType>(res, column_map);
+				recorder_.mark(trace::phase::fetch);
+				recorder_.rows(rows);
+				return rows;
+			}
+		}
+
+		// member to result column mapping of the prepared statement, column names come from the result
+		template<typename ReturnType>
+		const std::vector<int>& mapped_columns(const PGresult* res) {
+			auto& column_map = prepared_ != nullptr ? prepared_->column_map : uncached_map_;
+			if (prepared_ != nullptr && prepared_->mapped_type != nullptr && *prepared_->mapped_type == typeid(ReturnType)) {
+				return column_map;
+			}
+
+			std::vector<std::string_view> names((size_t)PQnfields(res));
+			for (size_t i = 0; i < names.size(); i++) {
+				names[i] = PQfname(res, (int)i);
+			}
+			column_map = sql::map_columns<ReturnType, int>(names);
+			if (prepared_ != nullptr) {
+				prepared_->mapped_type = &typeid(ReturnType);
+			}
+			return column_map;
+		}
+
+		// the cached statement of sql prepared for these parameter types
+		prepared_stmt* find_stmt(std::string_view statement_sql, const std::vector<Oid>& types) {
+			auto iter = stmt_cache_.find(statement_sql);
+			if (iter == stmt_cache_.end() || iter->second.param_types != types) {
+				return nullptr;
+			}
+			stmt_lru_.splice(stmt_lru_.begin(), stmt_lru_, iter->second.lru_iter);
+			stmt_stats_.hits++;
+			return &iter->second;
+		}
+
+		std::string next_stmt_name() {
+			return "sqlcpp_" + std::to_string(++stmt_seq_);
+		}
+
+		// name is prepared on the server, an older statement of the same sql is replaced
+		prepared_stmt& cache_stmt(std::string_view statement_sql, std::string name, const std::vector<Oid>& types) {
+			drop_stmt(statement_sql);
+			if (stmt_cache_.size() >= stmt_cache_size_) {
+				evict_stmt();
+			}
+			auto lru_iter = stmt_lru_.emplace(stmt_lru_.begin(), statement_sql);
+			auto [iter, ok] = stmt_cache_.emplace(*lru_iter, prepared_stmt{ std::move(name), types, lru_iter });
+			return iter->second;
+		}
+
+		void drop_stmt(std::string_view statement_sql) {
+			if (auto iter = stmt_cache_.find(statement_sql); iter != stmt_cache_.end()) {
+				remove_stmt(iter);
+			}
+		}
+
+		// drop the least recently used statement, it is deallocated before the next prepare
+		void evict_stmt() {
+			if (!stmt_lru_.empty()) {
+				remove_stmt(stmt_cache_.find(stmt_lru_.back()));
+				stmt_stats_.evictions++;
+			}
+		}
+
+		void remove_stmt(std::unordered_map<std::string_view, prepared_stmt>::iterator iter) {
+			if (prepared_ == &iter->second) {
+				prepared_ = nullptr;
+			}
+			deallocate_.emplace_back(std::move(iter->second.name));
+			auto lru_iter = iter->second.lru_iter;
+			stmt_cache_.erase(iter);
+			stmt_lru_.erase(lru_iter);
+		}
+
+		void deallocate_evicted() {
+			if (deallocate_.empty()) {
+				return;
+			}
+			std::string sql;
+			for (const auto& name : deallocate_) {
+				sql.append("DEALLOCATE ").append(name).append(";");
+			}
+			deallocate_.clear();
+			simple_ok(sql.c_str());
+		}
+
+		// send all queued output of pipeline mode. results coming back meanwhile are read in,
+		// so neither side blocks on a full socket buffer
+		void flush_pipeline() {
+			for (;;) {
+				auto r = PQflush(conn_);
+				if (r == 0) {
+					return;
+				}
+				if (r < 0 || !detail::wait_socket(PQsocket(conn_)) || PQconsumeInput(conn_) == 0) {
+					is_health_ = false;
+					throw except::postgres_exception("PQflush error: " + trimmed(PQerrorMessage(conn_)));
+				}
+			}
+		}
+	};
+
+	// a query of a pipeline, its rows are there after pipeline::run
+	template<typename ReturnType>
+	class pipeline_result {
+	private:
+		friend class pipeline;
+		using row_type = std::conditional_t<std::is_same_v<ReturnType, void>, char, ReturnType>;
+		struct state {
+			std::vector<row_type> rows;
+			uint64_t affected = 0;
+			bool ready = false;
+		};
+		std::shared_ptr<state> state_ = std::make_shared<state>();
+	public:
+		bool ready() const {
+			return state_->ready;
+		}
+
+		std::vector<ReturnType>& rows() {
+			static_assert(!std::is_same_v<ReturnType, void>, "no rows of query<void>");
+			if (!state_->ready) {
+				throw except::postgres_exception("pipeline query has no result, run the pipeline first");
+			}
+			return state_->rows;
+		}
+
+		// rows inserted, updated or deleted
+		uint64_t affected_rows() const {
+			return state_->affected;
+		}
+	};
+
+	// queries sent together in libpq pipeline mode, one flush and one round trip for all of them.
+	// outside a transaction they are one implicit transaction: the first error rolls all of them back and is thrown by run.
+	// do not use the connection for other queries between add and run
+	class pipeline {
+	private:
+		struct entry {
+			std::string sql;
+			std::string name; //prepared statement, empty when the cache is off
+			std::string positional; //sql to prepare, empty when prepared already
+			detail::param_buffer params;
+			std::function<void(const PGresult*)> on_result;
+		};
+
+		connection& conn_;
+		std::vector<entry> entries_;
+		std::unordered_map<std::string, size_t> preparing_; //sql---entry preparing it in this pipeline
+	public:
+		pipeline(const pipeline&) = delete;
+		pipeline& operator=(const pipeline&) = delete;
+
+		explicit pipeline(connection& conn) :conn_(conn) {}
+
+		// queue a query, args are copied
+		template<typename ReturnType, typename... Args>
+		pipeline_result<ReturnType> add(std::string_view statement_sql, Args&&...args) {
+			pipeline_result<ReturnType> result;
+			entry e{ std::string(statement_sql), {}, {}, detail::make_params(true, std::forward<Args>(args)...),
+				[state = result.state_](const PGresult* res) {
+					state->affected = std::strtoull(PQcmdTuples(const_cast<PGresult*>(res)), nullptr, 10);
+					if constexpr (!std::is_same_v<ReturnType, void>) {
+						state->rows = detail::read_rows<ReturnType>(res);
+					}
+					state->ready = true;
+				} };
+
+			if (auto stmt = conn_.find_stmt(statement_sql, e.params.types()); stmt != nullptr) {
+				e.name = stmt->name;
+			}
+			else if (auto iter = preparing_.find(e.sql); iter != preparing_.end() && entries_[iter->second].params.types() == e.params.types()) {
+				e.name = entries_[iter->second].name;
+			}
+			else {
+				conn_.stmt_stats_.misses++;
+				auto placeholders = detail::to_positional(statement_sql, e.positional);
+				if (placeholders != 0 && placeholders != e.params.size()) {
+					throw except::postgres_exception("param size do not match placeholder size");
+				}
+				if (conn_.stmt_cache_size_ > 0) {
+					e.name = conn_.next_stmt_name();
+					preparing_[e.sql] = entries_.size();
+				}
+			}
+			entries_.emplace_back(std::move(e));
+			return result;
+		}
+
+		size_t size() const {
+			return entries_.size();
+		}
+
+		// send all queries and read their results. queued ones are cleared, the pipeline can be filled again
+		void run() {
+			if (entries_.empty()) {
+				return;
+			}
+			auto span = conn_.recorder_.start("pipeline");
+			auto entries = std::move(entries_);
+			entries_.clear();
+			preparing_.clear();
+			auto deallocate = std::move(conn_.deallocate_);
+			conn_.deallocate_.clear();
+			conn_.recorder_.mark(trace::phase::bind);
+
+			std::optional<db_error> error;
+			std::vector<detail::result_ptr> results; //of the entries, all of them if nothing failed
+			uint64_t rows = 0;
+			auto pg = conn_.conn_;
+			try {
+				if (PQenterPipelineMode(pg) != 1) {
+					send_failed("PQenterPipelineMode");
+				}
+				PQsetnonblocking(pg, 1);
+				for (const auto& e : entries) {
+					auto count = (int)e.params.size();
+					if (!e.positional.empty() && !e.name.empty() &&
+						PQsendPrepare(pg, e.name.c_str(), e.positional.c_str(), count, e.params.types().data()) != 1) {
+						send_failed("PQsendPrepare");
+					}
+					auto sent = e.name.empty() ?
+						PQsendQueryParams(pg, e.positional.c_str(), count, e.params.types().data(), e.params.values(), e.params.lengths(), e.params.formats(), 1) :
+						PQsendQueryPrepared(pg, e.name.c_str(), count, e.params.values(), e.params.lengths(), e.params.formats(), 1);
+					if (sent != 1) {
+						send_failed("PQsendQueryPrepared");
+					}
+				}
+				//after the queries, so a failure of them can not abort the queries
+				for (const auto& name : deallocate) {
+					if (PQsendQueryParams(pg, ("DEALLOCATE " + name).c_str(), 0, nullptr, nullptr, nullptr, nullptr, 0) != 1) {
+						send_failed("PQsendQueryParams");
+					}
+				}
+				if (PQpipelineSync(pg) != 1) {
+					send_failed("PQpipelineSync");
+				}
+				conn_.flush_pipeline();
+				PQsetnonblocking(pg, 0);
+				conn_.recorder_.mark(trace::phase::execute);
+
+				auto failed = [this, &error](const PGresult* res, const char* where) {
+					if (!error) {
+						error = conn_.result_error(res, where);
+					}
+				};
+				for (auto& e : entries) {
+					if (!e.positional.empty() && !e.name.empty()) {
+						auto res = next_result();
+						if (connection::is_ok(res.get())) { //prepared statements are not transactional, kept even if rolled back
+							conn_.cache_stmt(e.sql, e.name, e.params.types());
+						}
+						else if (PQresultStatus(res.get()) == PGRES_FATAL_ERROR) {
+							failed(res.get(), "PQsendPrepare");
+						}
+					}
+					auto res = next_result();
+					if (connection::is_ok(res.get())) {
+						results.emplace_back(std::move(res));
+					}
+					else if (PQresultStatus(res.get()) != PGRES_PIPELINE_ABORTED) {
+						if (e.positional.empty() && connection::is_stale_plan(res.get())) {
+							if (auto iter = conn_.stmt_cache_.find(e.sql); iter != conn_.stmt_cache_.end() && iter->second.name == e.name) {
+								conn_.drop_stmt(e.sql); //prepared again next time
+							}
+						}
+						failed(res.get(), "PQsendQueryPrepared");
+					}
+				}
+				for (auto& name : deallocate) {
+					if (!connection::is_ok(next_result().get())) {
+						conn_.deallocate_.emplace_back(std::move(name)); //next time
+					}
+				}
+				if (PQresultStatus(next_result().get()) != PGRES_PIPELINE_SYNC || PQexitPipelineMode(pg) != 1) {
+					send_failed("PQexitPipelineMode");
+				}
+			}
+			catch (...) { //out of step with the server
+				conn_.is_health_ = false;
+				throw;
+			}
+			//rolled back on error, so no query has a result then
+			for (size_t i = 0; i < results.size() && !error; i++) {
+				try {
+					entries[i].on_result(results[i].get());
+					rows += (uint64_t)PQntuples(results[i].get());
+				}
+				catch (const except::sql_exception& ex) {
+					error = db_error(ex.get_error_code(), {}, "pipeline", ex.what());
+				}
+			}
+			conn_.recorder_.mark(trace::phase::fetch);
+			conn_.recorder_.rows(rows);
+			if (error) {
+				throw except::postgres_exception(error->message(), error->code());
+			}
+		}
+	private:
+		[[noreturn]] void send_failed(const char* where) {
+			throw except::postgres_exception(std::string(where) + " error: " + connection::trimmed(PQerrorMessage(conn_.conn_)));
+		}
+
+		// the next result of pipeline mode, and the null after it. sync has no null after it
+		detail::result_ptr next_result() {
+			detail::result_ptr res(PQgetResult(conn_.conn_));
+			if (res == nullptr) {
+				send_failed("PQgetResult");
+			}
+			if (PQresultStatus(res.get()) != PGRES_PIPELINE_SYNC) {
+				detail::result_ptr end(PQgetResult(conn_.conn_));
+				if (end != nullptr) {
+					send_failed("PQgetResult");
+				}
+			}
+			return res;
+		}
+	};
+}
@@ -0,0 +1,374 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <initializer_list>
+#include "db_meta.hpp"
+#include "postgres_connection.hpp"
+#include "postgres_sentinel.hpp"
+#include "trace.hpp"
+#include "logger.hpp"
+#include "pool_metrics.hpp"
+#include "db_common.h"
+
+namespace sqlcpp::postgres {
+	template<model Model>
+	class connection_pool {
+	private:
+		struct idle_connection {
+			std::unique_ptr<connection> conn;
+			std::chrono::steady_clock::time_point since;
+		};
+	public:
+		using general_pool = std::deque<idle_connection>;
+		using master_pool = std::unordered_map<std::string, general_pool>; //the primary, ip---conn
+		using slave_pool = std::unordered_map<std::string, general_pool>; //hot standbys, ip---conn
+	private:
+#ifdef SQLCPP_TRACE
+		std::shared_ptr<trace::observer> observer_;
+		std::mutex observer_mtx_;
+#endif
+		//cluster mode
+		std::unique_ptr<sentinel> sentinel_;
+		std::thread update_cluster_connections_thread_;
+		std::mutex cluster_mtx_;
+		uint64_t master_fetch_times_ = 0;
+		std::vector<node_info> masters_;
+		master_pool master_pool_;
+		uint64_t slave_fetch_times_ = 0;
+		std::vector<node_info> slaves_;
+		slave_pool slave_pool_;
+
+		//single mode
+		std::mutex mtx_;
+		std::condition_variable cond_;
+		node_info node_;
+		general_pool pool_;
+		size_t total_ = 0; //idle and in use
+		std::string user_;
+		std::string passwd_;
+		std::string conninfo_;
+		pool_options opt_;
+
+		pool_metrics metrics_;
+	public:
+		connection_pool(const connection_pool&) = delete;
+		connection_pool& operator=(const connection_pool&) = delete;
+
+		// cluster mode, members are the given nodes of streaming replication.
+		// master is the one not in recovery, slave is a hot standby. conninfo is added to every connection, like "dbname=app"
+		connection_pool(std::vector<node_info> nodes, std::string global_user, std::string global_passwd, std::string conninfo = "", pool_options opt = {})
+			:connection_pool(std::make_unique<recovery_discovery>(std::move(nodes), global_user, global_passwd, conninfo),
+				std::move(global_user), std::move(global_passwd), std::move(conninfo), opt)
+		{}
+
+		// cluster mode with another member discovery, like a stand-in for tests
+		connection_pool(std::unique_ptr<replica_discovery> discovery, std::string global_user, std::string global_passwd, std::string conninfo = "", pool_options opt = {})
+			:sentinel_(std::make_unique<sentinel>(std::move(discovery))), user_(std::move(global_user)), passwd_(std::move(global_passwd)),
+			conninfo_(std::move(conninfo)), opt_(opt)
+		{
+			static_assert(Model == model::cluster, "use node_info constructor in single model");
+			uint64_t version = 0;
+			update_cluster(sentinel_->get_nodes(version));
+			update_cluster_connections_thread_ = std::thread(&connection_pool::update_cluster_connections, this, version);
+		}
+
+		connection_pool(node_info node, std::string user, std::string passwd, std::string conninfo = "", pool_options opt = {})
+			:node_(std::move(node)), user_(std::move(user)), passwd_(std::move(passwd)), conninfo_(std::move(conninfo)), opt_(opt)
+		{
+			if (opt_.max_size != 0 && opt_.min_size > opt_.max_size) {
+				opt_.min_size = opt_.max_size;
+			}
+			//pre-warm, the pool still works when server is not ready now
+			for (size_t i = 0; i < opt_.min_size; i++) {
+				try {
+					pool_.push_back({ create_connection(), std::chrono::steady_clock::now() });
+					total_++;
+				}
+				catch (const std::exception& e) {
+					SQLCPP_LOG(warn, "postgres pre-warm conn <%s> error: %s", node_.ip.c_str(), e.what());
+					break;
+				}
+			}
+		}
+
+		~connection_pool() {
+			if constexpr (Model == model::cluster) {
+				sentinel_->stop();
+				if (update_cluster_connections_thread_.joinable()) {
+					update_cluster_connections_thread_.join();
+				}
+			}
+		}
+
+		template<conn_type Type>
+		decltype(auto) get_connection() {
+			auto begin = std::chrono::steady_clock::now();
+			try {
+				auto conn = acquire_connection<Type>();
+				auto wait = std::chrono::steady_clock::now() - begin;
+				metrics_.acquired(wait);
+#ifdef SQLCPP_TRACE
+				conn->trace_acquired(get_observer(), wait);
+#endif
+				return conn;
+			}
+			catch (...) {
+				metrics_.acquire_failed();
+				throw;
+			}
+		}
+
+		// idle and busy connections per node, and counters since the pool was created
+		pool_stats get_stats() {
+			std::vector<node_pool_stats> nodes;
+			if constexpr (Model == model::cluster) {
+				std::lock_guard<std::mutex> lock(cluster_mtx_);
+				for (const auto& [ip, q] : master_pool_) {
+					nodes.push_back({ ip, "master", q.size() });
+				}
+				for (const auto& [ip, q] : slave_pool_) {
+					nodes.push_back({ ip, "slave", q.size() });
+				}
+			}
+			else {
+				std::lock_guard<std::mutex> lock(mtx_);
+				nodes.push_back({ node_.ip, "general", pool_.size() });
+			}
+			return metrics_.snapshot("postgres", std::move(nodes));
+		}
+
+#ifdef SQLCPP_TRACE
+		// connections checked out from now on report their queries and the wait to get them to o.
+		// ones out already keep the previous observer alive until they are returned
+		void set_observer(std::shared_ptr<trace::observer> o) {
+			std::lock_guard<std::mutex> lock(observer_mtx_);
+			observer_.swap(o);
+		}
+
+		std::shared_ptr<trace::observer> get_observer() {
+			std::lock_guard<std::mutex> lock(observer_mtx_);
+			return observer_;
+		}
+#endif
+
+		void return_back(std::unique_ptr<connection>&& p) {
+#ifdef SQLCPP_TRACE
+			p->set_observer(nullptr); //the observer of the checkout is released
+#endif
+			if constexpr (Model == model::cluster) {
+				if (!p->reset_session()) {
+					metrics_.destroyed(p->get_ip(), 1, true);
+					if (!p->is_health()) {
+						sentinel_->refresh(); //maybe failover
+					}
+					return; //broken connection or session can not be cleaned, just drop it
+				}
+
+				std::lock_guard<std::mutex> lock(cluster_mtx_);
+				//a promoted standby keeps its sessions, so the connection goes to the current role of its node
+				for (auto* pools : { &slave_pool_, &master_pool_ }) {
+					if (auto iter = pools->find(p->get_ip()); iter != pools->end()) {
+						iter->second.push_back({ std::move(p), std::chrono::steady_clock::now() });
+						return;
+					}
+				}
+				metrics_.destroyed(p->get_ip()); //node is gone
+			}
+			else if constexpr (Model == model::single) {
+				if (!p->reset_session()) {
+					metrics_.destroyed(p->get_ip(), 1, true);
+					p.reset();
+					release_slot();
+					return; //broken connection or session can not be cleaned, just drop it
+				}
+
+				std::lock_guard<std::mutex> lock(mtx_);
+				pool_.push_back({ std::move(p), std::chrono::steady_clock::now() });
+				cond_.notify_one();
+			}
+		}
+
+	private:
+		template<conn_type Type>
+		decltype(auto) acquire_connection() {
+			if constexpr (Type == conn_type::slave || Type == conn_type::master) {
+				static_assert(Model == model::cluster, "postgres conn_type:master/slave only in cluster model");
+				return get_cluster_connection<Type>();
+			}
+			else if constexpr (Type == conn_type::general) {
+				static_assert(Model == model::single, "postgres conn_type:general only in single model");
+				return get_single_connection();
+			}
+			else {
+				static_assert(always_false_v<Type>, "unknown conn_type");
+			}
+		}
+
+		// round robin over primaries, or hot standbys for slave. no standby, read from primary
+		template<conn_type Type>
+		decltype(auto) get_cluster_connection() {
+			node_info node;
+			std::unique_ptr<connection> conn;
+			{
+				std::lock_guard<std::mutex> lock(cluster_mtx_);
+				auto* nodes = &masters_;
+				auto* pools = &master_pool_;
+				auto* fetch_times = &master_fetch_times_;
+				if (Type == conn_type::slave && !slaves_.empty()) {
+					nodes = &slaves_;
+					pools = &slave_pool_;
+					fetch_times = &slave_fetch_times_;
+				}
+				if (nodes->empty()) {
+					throw except::postgres_exception("postgres cluster no primary node found now");
+				}
+
+				node = (*nodes)[(*fetch_times)++ % nodes->size()];
+				auto& q = (*pools)[node.ip];
+				while (!q.empty()) {
+					auto idle = std::move(q.front());
+					q.pop_front();
+					if (is_usable(idle)) {
+						conn = std::move(idle.conn);
+						break;
+					}
+					metrics_.destroyed(node.ip, 1, true);
+				}
+			}
+
+			if (conn != nullptr) {
+				return connection_guard(std::move(conn), *this);
+			}
+			//create new connection
+			try {
+				return connection_guard(create_connection(node), *this);
+			}
+			catch (const std::exception&) {
+				sentinel_->refresh(); //maybe failover
+				throw;
+			}
+		}
+
+		decltype(auto) get_single_connection() {
+			for (;;) {
+				std::unique_lock<std::mutex> lock(mtx_);
+				if (pool_.empty()) {
+					if (opt_.max_size == 0 || total_ < opt_.max_size) {
+						//create new connection
+						total_++;
+						lock.unlock();
+						return connection_guard(create_counted_connection(), *this);
+					}
+					auto ok = cond_.wait_for(lock, opt_.wait_timeout, [this]() {
+						return !pool_.empty() || total_ < opt_.max_size;
+					});
+					if (!ok) {
+						throw except::postgres_exception("postgres connection pool exhausted, max size:" + std::to_string(opt_.max_size));
+					}
+					continue;
+				}
+
+				auto idle = std::move(pool_.front());
+				pool_.pop_front();
+				lock.unlock();
+				if (is_usable(idle)) {
+					return connection_guard(std::move(idle.conn), *this);
+				}
+				metrics_.destroyed(node_.ip, 1, true);
+				idle.conn.reset();
+				release_slot();
+			}
+		}
+
+		// validate only connections idle for a while
+		bool is_usable(idle_connection& idle) {
+			return idle.conn->is_health() &&
+				(std::chrono::steady_clock::now() - idle.since < opt_.validate_after || idle.conn->is_alive());
+		}
+
+		void update_cluster_connections(uint64_t version) {
+			while (auto nodes = sentinel_->wait_for_cluster_change(version)) {
+				update_cluster(std::move(*nodes));
+			}
+		}
+
+		void update_cluster(std::vector<node_info> nodes) {
+			std::lock_guard<std::mutex> lock(cluster_mtx_);
+			master_pool master_pool;
+			slave_pool slave_pool;
+			masters_.clear();
+			slaves_.clear();
+			bool changed = !master_pool_.empty() || !slave_pool_.empty(); //not the first discovery
+			for (auto& node : nodes) {
+				//remain the old conns of the node, a promoted standby keeps them
+				auto& new_pools = node.role == "PRIMARY" ? master_pool : slave_pool;
+				if (auto iter = master_pool_.find(node.ip); iter != master_pool_.end()) {
+					new_pools.emplace(iter->first, std::move(iter->second));
+					master_pool_.erase(iter);
+				}
+				else if (iter = slave_pool_.find(node.ip); iter != slave_pool_.end()) {
+					new_pools.emplace(iter->first, std::move(iter->second));
+					slave_pool_.erase(iter);
+				}
+				else {
+					new_pools[node.ip]; //new node appeared, Lazy create
+				}
+				(node.role == "PRIMARY" ? masters_ : slaves_).emplace_back(std::move(node));
+			}
+			//connections of nodes gone are dropped
+			for (const auto& [ip, q] : master_pool_) {
+				metrics_.destroyed(ip, q.size());
+			}
+			for (const auto& [ip, q] : slave_pool_) {
+				metrics_.destroyed(ip, q.size());
+			}
+			if (changed) {
+				metrics_.topology_changed();
+			}
+			//replace old pool
+			master_pool_ = std::move(master_pool);
+			slave_pool_ = std::move(slave_pool);
+		}
+
+		std::unique_ptr<connection> create_connection() {
+			return create_connection(node_);
+		}
+
+		std::unique_ptr<connection> create_connection(const node_info& node) {
+			try {
+				auto conn = std::make_unique<connection>(connection_options{ node.ip, node.port, user_, passwd_ }, conninfo_);
+				metrics_.created(node.ip);
+				return conn;
+			}
+			catch (...) {
+				metrics_.create_failed();
+				throw;
+			}
+		}
+
+		// the slot is already counted in total_
+		std::unique_ptr<connection> create_counted_connection() {
+			try {
+				return create_connection();
+			}
+			catch (...) {
+				release_slot();
+				throw;
+			}
+		}
+
+		void release_slot() {
+			std::lock_guard<std::mutex> lock(mtx_);
+			total_--;
+			cond_.notify_one();
+		}
+	};
+}
\ No newline at end of file
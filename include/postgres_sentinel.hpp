@@ -0,0 +1,163 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <optional>
+#include <algorithm>
+#include <unordered_map>
+#include <condition_variable>
+#include "db_meta.hpp"
+#include "db_common.h"
+#include "logger.hpp"
+#include "postgres_connection.hpp"
+
+namespace sqlcpp::postgres {
+	//where cluster members come from, a local stand-in can replace it for tests
+	class replica_discovery {
+	public:
+		virtual ~replica_discovery() = default;
+		// online members, role is PRIMARY or SECONDARY(hot standby). empty when failed
+		virtual std::vector<node_info> discover() = 0;
+	};
+
+	//streaming replication has no member list on the server, every given node is asked pg_is_in_recovery()
+	class recovery_discovery :public replica_discovery {
+	private:
+		std::vector<node_info> nodes_;
+		std::string user_;
+		std::string passwd_;
+		std::string conninfo_;
+		std::unordered_map<std::string, std::unique_ptr<connection>> conns_; //ip---conn, kept between rounds
+	public:
+		recovery_discovery(std::vector<node_info> nodes, std::string user, std::string passwd, std::string conninfo)
+			:nodes_(std::move(nodes)), user_(std::move(user)), passwd_(std::move(passwd)), conninfo_(std::move(conninfo))
+		{}
+
+		std::vector<node_info> discover() override {
+			std::vector<node_info> online;
+			for (const auto& node : nodes_) {
+				auto& conn = conns_[node.ip];
+				try {
+					if (conn == nullptr) {
+						conn = std::make_unique<connection>(connection_options{ node.ip, node.port, user_, passwd_ }, conninfo_);
+					}
+					auto r = conn->query<bool>("select pg_is_in_recovery()");
+					online.push_back({ node.ip, node.port, !r.empty() && r[0] ? "SECONDARY" : "PRIMARY" });
+				}
+				catch (const std::exception& e) {
+					SQLCPP_LOG(warn, "postgres discover node <%s> error: %s", node.ip.c_str(), e.what());
+					conn.reset();
+				}
+			}
+			return online;
+		}
+	};
+
+	//refresh cluster members in background
+	class sentinel {
+	private:
+		std::unique_ptr<replica_discovery> discovery_;
+		std::chrono::milliseconds interval_;
+		std::vector<node_info> online_nodes_;
+		uint64_t version_ = 0; //increased when members changed
+		bool refresh_requested_ = false;
+		std::mutex mtx_;
+		std::condition_variable changed_cond_;
+		std::condition_variable sleep_cond_;
+		std::atomic<bool> run_ = true;
+		std::thread monitor_thread_;
+	public:
+		sentinel(const sentinel&) = delete;
+		sentinel& operator=(const sentinel&) = delete;
+
+		// the first discovery runs here, so the members are known when constructed
+		sentinel(std::unique_ptr<replica_discovery> discovery, std::chrono::milliseconds interval = std::chrono::milliseconds(3000))
+			:discovery_(std::move(discovery)), interval_(interval)
+		{
+			update(discover());
+			monitor_thread_ = std::thread(&sentinel::monitor, this);
+		}
+
+		~sentinel() {
+			stop();
+			if (monitor_thread_.joinable()) {
+				monitor_thread_.join();
+			}
+		}
+
+		// current members and their version
+		std::vector<node_info> get_nodes(uint64_t& version) {
+			std::lock_guard<std::mutex> lock(mtx_);
+			version = version_;
+			return online_nodes_;
+		}
+
+		// block until members are newer than version, empty when stopped
+		std::optional<std::vector<node_info>> wait_for_cluster_change(uint64_t& version) {
+			std::unique_lock<std::mutex> lock(mtx_);
+			changed_cond_.wait(lock, [this, version]() { return !run_ || version_ != version; });
+			if (!run_) {
+				return std::nullopt;
+			}
+			version = version_;
+			return online_nodes_;
+		}
+
+		// discover at once, like after a connection error
+		void refresh() {
+			std::lock_guard<std::mutex> lock(mtx_);
+			refresh_requested_ = true;
+			sleep_cond_.notify_one();
+		}
+
+		void stop() {
+			std::lock_guard<std::mutex> lock(mtx_);
+			run_ = false;
+			changed_cond_.notify_all();
+			sleep_cond_.notify_one();
+		}
+
+	private:
+		std::vector<node_info> discover() {
+			try {
+				auto nodes = discovery_->discover();
+				std::sort(nodes.begin(), nodes.end()); //for compare
+				return nodes;
+			}
+			catch (const std::exception& e) {
+				SQLCPP_LOG(warn, "postgres discover cluster error: %s", e.what());
+				return {};
+			}
+		}
+
+		void update(std::vector<node_info> nodes) {
+			if (nodes.empty()) { //keep the last known members
+				return;
+			}
+			std::lock_guard<std::mutex> lock(mtx_);
+			if (nodes != online_nodes_) {
+				online_nodes_ = std::move(nodes);
+				version_++;
+				changed_cond_.notify_all();
+			}
+		}
+
+		void monitor() {
+			while (run_) {
+				{
+					std::unique_lock<std::mutex> lock(mtx_);
+					sleep_cond_.wait_for(lock, interval_, [this]() { return !run_ || refresh_requested_; });
+					refresh_requested_ = false;
+				}
+				if (!run_) {
+					break;
+				}
+				update(discover());
+			}
+		}
+	};
+}
@@ -0,0 +1,477 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L) || __cplusplus >= 202002L
+#define SQLCPP_HAS_FIXED_STRING 1
+#endif
+#include "db_meta.hpp"
+#include "exception.hpp"
+#include "reflection.hpp"
+
+//sql text and result column mapping generated from REFLECT metadata
+namespace sqlcpp::sql {
+	//counts only when no buffer, so one generator gives both the length and the text
+	class sql_writer {
+	private:
+		char* buf_ = nullptr;
+		size_t size_ = 0;
+	public:
+		constexpr sql_writer() = default;
+		constexpr explicit sql_writer(char* buf) :buf_(buf) {}
+
+		constexpr sql_writer& operator<<(std::string_view s) {
+			for (auto c : s) {
+				if (buf_ != nullptr) {
+					buf_[size_] = c;
+				}
+				size_++;
+			}
+			return *this;
+		}
+
+		constexpr size_t size() const {
+			return size_;
+		}
+	};
+
+	template<size_t N>
+	struct fixed_sql {
+		char data[N + 1]{};
+
+		constexpr std::string_view view() const {
+			return { data, N };
+		}
+
+		constexpr operator std::string_view() const {
+			return view();
+		}
+	};
+
+	template<typename T, typename = void>
+	struct has_table_name :std::false_type {};
+
+	template<typename T>
+	struct has_table_name<T, std::void_t<decltype(T::table_name)>> :std::true_type {};
+
+	namespace detail {
+		template<typename Gen>
+		constexpr size_t sql_length(Gen gen) {
+			sql_writer w;
+			gen(w);
+			return w.size();
+		}
+
+		template<size_t N, typename Gen>
+		constexpr fixed_sql<N> make_sql(Gen gen) {
+			fixed_sql<N> s{};
+			sql_writer w(s.data);
+			gen(w);
+			return s;
+		}
+
+		template<typename T>
+		constexpr void columns(sql_writer& w) {
+			constexpr auto names = T::elements_name();
+			for (size_t i = 0; i < names.size(); i++) {
+				w << (i == 0 ? "" : ",") << names[i];
+			}
+		}
+
+		template<typename T>
+		constexpr void placeholders(sql_writer& w) {
+			for (size_t i = 0; i < T::args_size_t::value; i++) {
+				w << (i == 0 ? "?" : ",?");
+			}
+		}
+
+		template<typename T>
+		constexpr void assignments(sql_writer& w) {
+			constexpr auto names = T::elements_name();
+			for (size_t i = 0; i < names.size(); i++) {
+				w << (i == 0 ? "" : ",") << names[i] << "=?";
+			}
+		}
+
+		template<typename T>
+		constexpr void select(sql_writer& w) {
+			w << "select ";
+			columns<T>(w);
+			w << " from " << std::string_view(T::table_name);
+		}
+
+		template<typename T>
+		constexpr void insert(sql_writer& w) {
+			w << "insert into " << std::string_view(T::table_name) << " (";
+			columns<T>(w);
+			w << ") values (";
+			placeholders<T>(w);
+			w << ")";
+		}
+
+		template<typename T>
+		constexpr void update(sql_writer& w) {
+			w << "update " << std::string_view(T::table_name) << " set ";
+			assignments<T>(w);
+		}
+
+		template<typename T>
+		inline constexpr auto columns_v = make_sql<sql_length(&columns<T>)>(&columns<T>);
+
+		template<typename T>
+		inline constexpr auto placeholders_v = make_sql<sql_length(&placeholders<T>)>(&placeholders<T>);
+
+		template<typename T>
+		inline constexpr auto assignments_v = make_sql<sql_length(&assignments<T>)>(&assignments<T>);
+
+		template<typename T>
+		inline constexpr auto select_v = make_sql<sql_length(&select<T>)>(&select<T>);
+
+		template<typename T>
+		inline constexpr auto insert_v = make_sql<sql_length(&insert<T>)>(&insert<T>);
+
+		template<typename T>
+		inline constexpr auto update_v = make_sql<sql_length(&update<T>)>(&update<T>);
+	}
+
+	// a,b,c
+	template<typename T>
+	constexpr std::string_view columns() {
+		static_assert(reflection::is_reflection_v<T>, "need REFLECT struct");
+		return detail::columns_v<T>;
+	}
+
+	// ?,?,?
+	template<typename T>
+	constexpr std::string_view placeholders() {
+		static_assert(reflection::is_reflection_v<T>, "need REFLECT struct");
+		return detail::placeholders_v<T>;
+	}
+
+	// a=?,b=?,c=?
+	template<typename T>
+	constexpr std::string_view assignments() {
+		static_assert(reflection::is_reflection_v<T>, "need REFLECT struct");
+		return detail::assignments_v<T>;
+	}
+
+	// select a,b,c from t. the table is T::table_name, like static constexpr std::string_view table_name = "t";
+	template<typename T>
+	constexpr std::string_view select() {
+		static_assert(has_table_name<T>::value, "need T::table_name, or give the table");
+		return detail::select_v<T>;
+	}
+
+	// insert into t (a,b,c) values (?,?,?)
+	template<typename T>
+	constexpr std::string_view insert() {
+		static_assert(has_table_name<T>::value, "need T::table_name, or give the table");
+		return detail::insert_v<T>;
+	}
+
+	// update t set a=?,b=?,c=? . append the where clause
+	template<typename T>
+	constexpr std::string_view update() {
+		static_assert(has_table_name<T>::value, "need T::table_name, or give the table");
+		return detail::update_v<T>;
+	}
+
+	template<typename T>
+	std::string select(std::string_view table) {
+		return std::string("select ").append(columns<T>()).append(" from ").append(table);
+	}
+
+	template<typename T>
+	std::string insert(std::string_view table) {
+		return std::string("insert into ").append(table).append(" (").append(columns<T>())
+			.append(") values (").append(placeholders<T>()).append(")");
+	}
+
+	template<typename T>
+	std::string update(std::string_view table) {
+		return std::string("update ").append(table).append(" set ").append(assignments<T>());
+	}
+
+	// ? out of quotes, [identifiers] and comments. backslash_escapes: \' does not end a string, like mysql
+	// without NO_BACKSLASH_ESCAPES. postgres E'' strings always take them
+	constexpr size_t count_placeholders(std::string_view sql, bool backslash_escapes = false) {
+		size_t count = 0;
+		for (size_t i = 0; i < sql.length(); i++) {
+			auto c = sql[i];
+			if (c == '?') {
+				count++;
+			}
+			else if (c == '\'' || c == '"' || c == '`' || c == '[') { //'it''s' is two quoted parts, still right
+				auto close = c == '[' ? ']' : c;
+				bool e_string = c == '\'' && i > 0 && (sql[i - 1] == 'E' || sql[i - 1] == 'e') && (i == 1 || !(
+					(sql[i - 2] >= 'a' && sql[i - 2] <= 'z') || (sql[i - 2] >= 'A' && sql[i - 2] <= 'Z') ||
+					(sql[i - 2] >= '0' && sql[i - 2] <= '9') || sql[i - 2] == '_'));
+				bool escapes = (backslash_escapes && c != '`' && c != '[') || e_string;
+				while (++i < sql.length() && sql[i] != close) {
+					if (escapes && sql[i] == '\\') {
+						i++;
+					}
+				}
+			}
+			else if (c == '-' && i + 1 < sql.length() && sql[i + 1] == '-') {
+				while (++i < sql.length() && sql[i] != '\n') {}
+			}
+			else if (c == '/' && i + 1 < sql.length() && sql[i + 1] == '*') {
+				i += 2;
+				while (i + 1 < sql.length() && !(sql[i] == '*' && sql[i + 1] == '/')) {
+					i++;
+				}
+				i++;
+			}
+		}
+		return count;
+	}
+
+	// FNV-1a of the sql text
+	constexpr uint64_t statement_id(std::string_view sql) {
+		uint64_t hash = 14695981039346656037ull;
+		for (auto c : sql) {
+			hash ^= (uint8_t)c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	namespace detail {
+		// out(c) gets the sql with literals as ?, IN and VALUES lists as (...), comments dropped and spaces squeezed.
+		// AllSpaces keeps one space for every run of them, otherwise only those between words
+		template<bool AllSpaces, typename Out>
+		void normalize(std::string_view sql, Out&& out) {
+			auto is_word = [](char c) {
+				return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '$' || c == '@' || c == '#';
+			};
+			char last = ' ';
+			bool space = false; //spaces only count between words, id=1 is id = 1
+			auto put = [&](std::string_view s) {
+				if (space && (AllSpaces || ((is_word(last) || last == '?') && (is_word(s[0]) || s[0] == '?')))) {
+					out(' ');
+				}
+				space = false;
+				for (auto c : s) {
+					out(c);
+				}
+				last = s.back();
+			};
+			auto is_space = [](char c) {
+				return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+			};
+			size_t i = 0;
+			auto skip_space = [&]() {
+				for (;;) {
+					while (i < sql.length() && is_space(sql[i])) {
+						i++;
+					}
+					if (sql.compare(i, 2, "--") == 0) {
+						while (i < sql.length() && sql[i] != '\n') {
+							i++;
+						}
+					}
+					else if (sql.compare(i, 2, "/*") == 0) {
+						auto end = sql.find("*/", i + 2);
+						i = end == std::string_view::npos ? sql.length() : end + 2;
+					}
+					else {
+						return;
+					}
+				}
+			};
+			// a literal or placeholder at i is skipped, false if there is none
+			auto skip_value = [&]() {
+				if (i >= sql.length()) {
+					return false;
+				}
+				auto c = sql[i];
+				if (c == '?') {
+					i++;
+				}
+				else if (c == '\'') {
+					while (++i < sql.length()) {
+						if (sql[i] == '\\') {
+							i++;
+						}
+						else if (sql[i] == '\'') {
+							if (i + 1 < sql.length() && sql[i + 1] == '\'') { //'it''s'
+								i++;
+							}
+							else {
+								break;
+							}
+						}
+					}
+					i = (std::min)(i + 1, sql.length()); //unclosed quote ends at the end
+				}
+				else if ((c >= '0' && c <= '9') || (c == '-' && i + 1 < sql.length() && sql[i + 1] >= '0' && sql[i + 1] <= '9') ||
+					(c == '$' && i + 1 < sql.length() && sql[i + 1] >= '0' && sql[i + 1] <= '9')) { //numbers, hex, $1
+					i++;
+					while (i < sql.length() && (is_word(sql[i]) || sql[i] == '.' ||
+						((sql[i] == '+' || sql[i] == '-') && (sql[i - 1] == 'e' || sql[i - 1] == 'E')))) {
+						i++;
+					}
+				}
+				else {
+					return false;
+				}
+				return true;
+			};
+			// (value, value, ...) at i is skipped, false and i unchanged if it is not one
+			auto skip_list = [&]() {
+				auto begin = i++;
+				for (;;) {
+					skip_space();
+					if (!skip_value()) {
+						i = begin;
+						return false;
+					}
+					skip_space();
+					if (i >= sql.length() || sql[i] != ',') {
+						break;
+					}
+					i++;
+				}
+				if (i >= sql.length() || sql[i] != ')') {
+					i = begin;
+					return false;
+				}
+				i++;
+				return true;
+			};
+
+			while (true) {
+				auto before = i;
+				skip_space();
+				space |= i != before;
+				if (i >= sql.length()) {
+					break;
+				}
+				auto c = sql[i];
+				if (c == '(' && skip_list()) {
+					put("(...)");
+					for (auto next = i; ; ) { //more rows of a multi-row VALUES
+						i = next;
+						skip_space();
+						if (i >= sql.length() || sql[i] != ',') {
+							i = next;
+							break;
+						}
+						i++;
+						skip_space();
+						if (i >= sql.length() || sql[i] != '(' || !skip_list()) {
+							i = next;
+							break;
+						}
+						next = i;
+					}
+				}
+				else if (c == '"' || c == '`' || c == '[') { //quoted identifiers stay
+					auto close = c == '[' ? ']' : c;
+					auto end = sql.find(close, i + 1);
+					end = end == std::string_view::npos ? sql.length() : end + 1;
+					put(sql.substr(i, end - i));
+					i = end;
+				}
+				else if (i > 0 && is_word(sql[i - 1]) && is_word(c)) { //inside a name, like t1
+					put(sql.substr(i, 1));
+					i++;
+				}
+				else if (c != '-' && skip_value()) {
+					put("?");
+				}
+				else if (c == '-' && i + 1 < sql.length() && sql[i + 1] >= '0' && sql[i + 1] <= '9' &&
+					!(is_word(last) || last == ')' || last == '?')) { //negative literal, not a -1
+					skip_value();
+					put("?");
+				}
+				else {
+					put(sql.substr(i, 1));
+					i++;
+				}
+			}
+		}
+	}
+
+	// the sql as fingerprint sees it, like select a from t where id = ? and b in (...)
+	inline std::string normalize(std::string_view sql) {
+		std::string text;
+		text.reserve(sql.length());
+		detail::normalize<true>(sql, [&text](char c) { text += c; });
+		return text;
+	}
+
+	// statement_id of the normalized sql, so queries differing only in values share one, like pg_stat_statements
+	inline uint64_t fingerprint(std::string_view sql) {
+		uint64_t hash = 14695981039346656037ull;
+		detail::normalize<false>(sql, [&hash](char c) {
+			hash ^= (uint8_t)c;
+			hash *= 1099511628211ull;
+		});
+		return hash;
+	}
+
+#ifdef SQLCPP_HAS_FIXED_STRING
+	// sql as template argument, like conn->query<int, "select a from t where id = ?">(1)
+	template<size_t N>
+	struct fixed_string {
+		char data[N]{};
+
+		constexpr fixed_string(const char(&s)[N]) {
+			for (size_t i = 0; i < N; i++) {
+				data[i] = s[i];
+			}
+		}
+
+		constexpr std::string_view view() const {
+			return { data, N - 1 };
+		}
+	};
+
+	// everything of a fixed sql known at compile time
+	template<fixed_string Sql>
+	struct statement {
+		static constexpr std::string_view text = Sql.view();
+		static constexpr size_t param_count = count_placeholders(text);
+		static constexpr uint64_t id = statement_id(text);
+	};
+#endif
+
+	// result column index of every member, found by case insensitive name. extra columns are ignored
+	template<typename T, typename Index, typename Names>
+	std::vector<Index> map_columns(const Names& column_names) {
+		static_assert(reflection::is_reflection_v<T>, "name mapping needs REFLECT struct");
+		auto equal = [](std::string_view a, std::string_view b) {
+			if (a.length() != b.length()) {
+				return false;
+			}
+			for (size_t i = 0; i < a.length(); i++) {
+				auto x = (a[i] >= 'A' && a[i] <= 'Z') ? a[i] - 'A' + 'a' : a[i];
+				auto y = (b[i] >= 'A' && b[i] <= 'Z') ? b[i] - 'A' + 'a' : b[i];
+				if (x != y) {
+					return false;
+				}
+			}
+			return true;
+		};
+
+		constexpr auto names = T::elements_name();
+		std::vector<Index> column_of(names.size());
+		for (size_t i = 0; i < names.size(); i++) {
+			size_t column = 0;
+			while (column < column_names.size() && !equal(names[i], column_names[column])) {
+				column++;
+			}
+			if (column == column_names.size()) {
+				throw except::sql_exception("no column in the query for member <" + std::string(names[i]) + ">");
+			}
+			column_of[i] = (Index)column;
+		}
+		return column_of;
+	}
+}
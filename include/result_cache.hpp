@@ -0,0 +1,309 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <tuple>
+#include <typeinfo>
+#include <type_traits>
+#include "db_meta.hpp"
+
+namespace sqlcpp {
+	struct cache_options {
+		std::chrono::milliseconds ttl{ 1000 };
+		std::vector<std::string> tags{}; //tables the result depends on, parsed from sql if empty
+	};
+
+	struct cache_stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t coalesced = 0; //waited for the same query loading by another thread
+		uint64_t evictions = 0;
+		uint64_t invalidations = 0;
+	};
+
+	//typed query results, LRU bounded by entry count, expired by ttl and invalidated by table tag
+	class result_cache {
+	private:
+		using value_ptr = std::shared_ptr<const void>;
+		struct entry {
+			value_ptr value;
+			std::chrono::steady_clock::time_point expire;
+			std::vector<std::string> tags;
+			std::list<std::string>::iterator lru_iter;
+		};
+
+		std::mutex mtx_;
+		size_t max_entries_;
+		std::list<std::string> lru_; //front is the newest
+		std::unordered_map<std::string, entry> entries_;
+		std::unordered_map<std::string, std::unordered_set<std::string>> tag_keys_;
+		std::unordered_map<std::string, uint64_t> tag_epochs_; //increased by every invalidation
+		std::unordered_map<std::string, std::shared_future<value_ptr>> loading_;
+
+		std::atomic<uint64_t> hits_ = 0;
+		std::atomic<uint64_t> misses_ = 0;
+		std::atomic<uint64_t> coalesced_ = 0;
+		std::atomic<uint64_t> evictions_ = 0;
+		std::atomic<uint64_t> invalidations_ = 0;
+	public:
+		result_cache(const result_cache&) = delete;
+		result_cache& operator=(const result_cache&) = delete;
+
+		explicit result_cache(size_t max_entries)
+			:max_entries_(max_entries)
+		{}
+
+		// return cached result, or call loader to get it. concurrent misses on the same key only call loader once
+		template<typename ReturnType, typename Loader, typename... Args>
+		std::vector<ReturnType> get_or_load(const cache_options& opt, std::string_view statement_sql, Loader&& loader, const Args&...args) {
+			using result_t = std::vector<ReturnType>;
+			auto key = make_key<ReturnType>(statement_sql, args...);
+			auto tags = opt.tags.empty() ? tables_of(statement_sql) : normalize_tags(opt.tags);
+
+			std::unique_lock<std::mutex> lock(mtx_);
+			if (auto iter = entries_.find(key); iter != entries_.end()) {
+				if (std::chrono::steady_clock::now() < iter->second.expire) {
+					lru_.splice(lru_.begin(), lru_, iter->second.lru_iter);
+					auto value = iter->second.value;
+					lock.unlock();
+					hits_++;
+					return *static_cast<const result_t*>(value.get());
+				}
+				erase_entry(iter);
+			}
+
+			if (auto iter = loading_.find(key); iter != loading_.end()) {
+				auto future = iter->second;
+				lock.unlock();
+				coalesced_++;
+				return *static_cast<const result_t*>(future.get().get()); //rethrow if loader failed
+			}
+
+			misses_++;
+			std::promise<value_ptr> promise;
+			loading_.emplace(key, promise.get_future().share());
+			std::vector<uint64_t> epochs;
+			epochs.reserve(tags.size());
+			for (const auto& tag : tags) {
+				epochs.emplace_back(tag_epochs_[tag]);
+			}
+			lock.unlock();
+
+			std::shared_ptr<const result_t> value;
+			try {
+				value = std::make_shared<const result_t>(loader());
+			}
+			catch (...) {
+				promise.set_exception(std::current_exception());
+				lock.lock();
+				loading_.erase(key);
+				throw;
+			}
+			promise.set_value(value);
+
+			lock.lock();
+			loading_.erase(key);
+			//a write invalidated the tables while loading, the result may be stale
+			for (size_t i = 0; i < tags.size(); i++) {
+				if (tag_epochs_[tags[i]] != epochs[i]) {
+					return *value;
+				}
+			}
+			insert_entry(std::move(key), value, std::move(tags), std::chrono::steady_clock::now() + opt.ttl);
+			return *value;
+		}
+
+		void invalidate(std::string_view table) {
+			auto tag = normalize_tag(table);
+			std::lock_guard<std::mutex> lock(mtx_);
+			tag_epochs_[tag]++;
+			auto iter = tag_keys_.find(tag);
+			if (iter == tag_keys_.end()) {
+				return;
+			}
+			auto keys = std::move(iter->second);
+			tag_keys_.erase(iter);
+			for (const auto& key : keys) {
+				if (auto e = entries_.find(key); e != entries_.end()) {
+					erase_entry(e);
+					invalidations_++;
+				}
+			}
+		}
+
+		// invalidate all tables touched by a write statement
+		void invalidate_tables(std::string_view statement_sql) {
+			for (const auto& table : tables_of(statement_sql)) {
+				invalidate(table);
+			}
+		}
+
+		void clear() {
+			std::lock_guard<std::mutex> lock(mtx_);
+			lru_.clear();
+			entries_.clear();
+			tag_keys_.clear();
+		}
+
+		cache_stats get_stats() const {
+			return { hits_.load(), misses_.load(), coalesced_.load(), evictions_.load(), invalidations_.load() };
+		}
+
+		// table names after from/join/update/into/table. for complex sql, use cache_options::tags instead
+		static std::vector<std::string> tables_of(std::string_view sql) {
+			std::vector<std::string> tables;
+			bool table_next = false;
+			size_t pos = 0;
+			while (pos < sql.length()) {
+				auto begin = sql.find_first_not_of(" \t\r\n(),;", pos);
+				if (begin == std::string_view::npos) {
+					break;
+				}
+				auto end = sql.find_first_of(" \t\r\n(),;", begin);
+				if (end == std::string_view::npos) {
+					end = sql.length();
+				}
+				auto word = lower(sql.substr(begin, end - begin));
+				if (table_next && word != "select" && word != "ignore") {
+					auto tag = normalize_tag(word);
+					if (!tag.empty() && std::find(tables.begin(), tables.end(), tag) == tables.end()) {
+						tables.emplace_back(std::move(tag));
+					}
+					table_next = false;
+				}
+				else if (word != "ignore") {
+					table_next = word == "from" || word == "join" || word == "update" || word == "into" || word == "table";
+				}
+				pos = end;
+			}
+			return tables;
+		}
+
+	private:
+		static std::string lower(std::string_view s) {
+			std::string r(s);
+			for (auto& c : r) {
+				if (c >= 'A' && c <= 'Z') {
+					c = (char)(c - 'A' + 'a');
+				}
+			}
+			return r;
+		}
+
+		// `db`.`t`, [dbo].[t] and t are the same tag: t
+		static std::string normalize_tag(std::string_view name) {
+			std::string tag;
+			for (auto c : name) {
+				if (c == '`' || c == '[' || c == ']' || c == '"') {
+					continue;
+				}
+				if (c == '.') {
+					tag.clear();
+					continue;
+				}
+				tag.push_back(c);
+			}
+			return lower(tag);
+		}
+
+		static std::vector<std::string> normalize_tags(const std::vector<std::string>& tags) {
+			std::vector<std::string> r;
+			r.reserve(tags.size());
+			for (const auto& tag : tags) {
+				r.emplace_back(normalize_tag(tag));
+			}
+			return r;
+		}
+
+		template<typename ReturnType, typename... Args>
+		static std::string make_key(std::string_view statement_sql, const Args&...args) {
+			std::string key(typeid(ReturnType).name());
+			key.push_back('\0');
+			key.append(statement_sql);
+			std::apply([&key](const auto&... params) {
+				(append_key(key, params), ...);
+			}, param_refs(args...));
+			return key;
+		}
+
+		template<typename T, typename = void>
+		struct has_key_fields :std::false_type {};
+
+		template<typename T>
+		struct has_key_fields<T, std::void_t<decltype(std::declval<const T&>().key_fields())>> :std::true_type {};
+
+		template<typename T>
+		static void append_key(std::string& key, const T& t) {
+			using U = std::decay_t<T>;
+			key.push_back('\0');
+			if constexpr (is_optional_v<U>) {
+				key.push_back(t.has_value() ? '1' : '0');
+				if (t.has_value()) {
+					append_key(key, t.value());
+				}
+			}
+			else if constexpr (is_char_array_v<U> || is_char_pointer_v<U>) {
+				key.append(t);
+			}
+			else if constexpr (std::is_convertible_v<U, std::string_view>) {
+				std::string_view str(t);
+				auto length = str.length();
+				key.append((const char*)&length, sizeof(length));
+				key.append(str);
+			}
+			else if constexpr (has_key_fields<U>::value) { //date and time, their padding bytes are not part of the value
+				std::apply([&key](const auto&... field) {
+					(append_key(key, field), ...);
+				}, t.key_fields());
+			}
+			else if constexpr (std::is_arithmetic_v<U> || std::is_enum_v<U>) {
+				key.append((const char*)&t, sizeof(U));
+			}
+			else {
+				static_assert(always_false_v<U>, "type can not be used as cache key");
+			}
+		}
+
+		void insert_entry(std::string key, value_ptr value, std::vector<std::string> tags, std::chrono::steady_clock::time_point expire) {
+			if (max_entries_ == 0) {
+				return;
+			}
+			if (auto iter = entries_.find(key); iter != entries_.end()) {
+				erase_entry(iter);
+			}
+			while (entries_.size() >= max_entries_) {
+				erase_entry(entries_.find(lru_.back()));
+				evictions_++;
+			}
+
+			lru_.emplace_front(key);
+			for (const auto& tag : tags) {
+				tag_keys_[tag].emplace(key);
+			}
+			entries_.emplace(std::move(key), entry{ std::move(value), expire, std::move(tags), lru_.begin() });
+		}
+
+		void erase_entry(std::unordered_map<std::string, entry>::iterator iter) {
+			for (const auto& tag : iter->second.tags) {
+				if (auto t = tag_keys_.find(tag); t != tag_keys_.end()) {
+					t->second.erase(iter->first);
+					if (t->second.empty()) {
+						tag_keys_.erase(t);
+					}
+				}
+			}
+			lru_.erase(iter->second.lru_iter);
+			entries_.erase(iter);
+		}
+	};
+}
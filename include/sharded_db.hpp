@@ -0,0 +1,352 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <queue>
+#include <iterator>
+#include <cstdint>
+#include <type_traits>
+#include "db.hpp"
+
+namespace sqlcpp {
+	// which shard owns a key. hash spreads keys evenly, range keeps neighbour keys together.
+	// the hash is stable across processes and platforms, so the map can be shared with other tools
+	class shard_map {
+	private:
+		enum class kind {
+			hash,
+			range
+		};
+
+		kind kind_ = kind::hash;
+		size_t count_ = 0;
+		std::vector<int64_t> bounds_; //range, upper bound(exclusive) of every shard but the last
+	public:
+		static shard_map hash(size_t shards) {
+			shard_map m;
+			m.count_ = shards;
+			return m;
+		}
+
+		// shard i owns keys in [bounds[i-1], bounds[i]), the first one below bounds[0] and the last one from bounds.back()
+		static shard_map range(std::vector<int64_t> upper_bounds) {
+			if (!std::is_sorted(upper_bounds.begin(), upper_bounds.end())) {
+				throw except::sql_exception("shard range bounds must be ascending");
+			}
+			shard_map m;
+			m.kind_ = kind::range;
+			m.count_ = upper_bounds.size() + 1;
+			m.bounds_ = std::move(upper_bounds);
+			return m;
+		}
+
+		size_t size() const {
+			return count_;
+		}
+
+		template<typename Key>
+		size_t shard_of(const Key& key) const {
+			if constexpr (std::is_integral_v<Key>) {
+				if (kind_ == kind::range) {
+					return (size_t)(std::upper_bound(bounds_.begin(), bounds_.end(), (int64_t)key) - bounds_.begin());
+				}
+				return (size_t)(mix((uint64_t)key) % count_);
+			}
+			else {
+				static_assert(std::is_convertible_v<const Key&, std::string_view>, "shard key must be an integer or a string");
+				if (kind_ == kind::range) {
+					throw except::sql_exception("range shard map needs integer keys");
+				}
+				return (size_t)(mix(sql::statement_id(std::string_view(key))) % count_);
+			}
+		}
+	private:
+		// splitmix64 finalizer, neighbour keys go to different shards
+		static uint64_t mix(uint64_t x) {
+			x += 0x9e3779b97f4a7c15ull;
+			x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+			x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+			return x ^ (x >> 31);
+		}
+	};
+
+	namespace detail {
+		// pooled threads running calls on many shards at once
+		class fan_out {
+		private:
+			// indexes of one run, taken by the caller and the threads. outlives run for tasks still queued
+			struct call {
+				size_t n;
+				std::function<void(size_t)> fn; //valid while an index is left, run waits for all of them
+				std::atomic<size_t> next = 0;
+				size_t remaining;
+				std::vector<std::exception_ptr> errors;
+				std::mutex mtx;
+				std::condition_variable cond;
+
+				call(size_t count, std::function<void(size_t)> f) :n(count), fn(std::move(f)), remaining(count), errors(count) {}
+
+				void take() {
+					for (size_t i = next++; i < n; i = next++) {
+						try {
+							fn(i);
+						}
+						catch (...) {
+							errors[i] = std::current_exception();
+						}
+						std::lock_guard<std::mutex> lock(mtx);
+						if (--remaining == 0) {
+							cond.notify_one();
+						}
+					}
+				}
+			};
+
+			std::mutex mtx_;
+			std::condition_variable cond_;
+			std::deque<std::function<void()>> tasks_;
+			std::vector<std::thread> threads_;
+			size_t idle_ = 0;
+			size_t max_threads_;
+			bool run_ = true;
+		public:
+			fan_out(const fan_out&) = delete;
+			fan_out& operator=(const fan_out&) = delete;
+
+			// threads are added while all are busy, up to max_threads
+			fan_out(size_t threads, size_t max_threads) :max_threads_((std::max)(threads, max_threads)) {
+				std::lock_guard<std::mutex> lock(mtx_);
+				while (threads_.size() < threads) {
+					add_thread();
+				}
+			}
+
+			~fan_out() {
+				{
+					std::lock_guard<std::mutex> lock(mtx_);
+					run_ = false;
+				}
+				cond_.notify_all();
+				for (auto& t : threads_) {
+					t.join();
+				}
+			}
+
+			// fn(i) for every i in [0, n) concurrently. waits for all, then rethrows the first error.
+			// the caller takes indexes too, so concurrent calls do not wait behind each other's queued tasks,
+			// free threads just help whoever is running
+			template<typename Fun>
+			void run(size_t n, Fun&& fn) {
+				auto c = std::make_shared<call>(n, [&fn](size_t i) { fn(i); });
+				if (n > 1) {
+					std::lock_guard<std::mutex> lock(mtx_);
+					for (size_t i = 1; i < n; i++) {
+						tasks_.emplace_back([c]() { c->take(); }); //done already when its turn comes is fine
+					}
+					while (idle_ < tasks_.size() && threads_.size() < max_threads_) {
+						add_thread();
+					}
+				}
+				cond_.notify_all();
+				c->take();
+				std::unique_lock<std::mutex> lock(c->mtx);
+				c->cond.wait(lock, [&c]() { return c->remaining == 0; });
+				lock.unlock();
+
+				for (auto& e : c->errors) {
+					if (e) {
+						std::rethrow_exception(e);
+					}
+				}
+			}
+		private:
+			// with mtx_ held
+			void add_thread() {
+				idle_++;
+				threads_.emplace_back(&fan_out::work, this);
+			}
+
+			void work() {
+				std::unique_lock<std::mutex> lock(mtx_);
+				for (;;) {
+					cond_.wait(lock, [this]() { return !run_ || !tasks_.empty(); });
+					if (tasks_.empty()) {
+						return; //stopped
+					}
+					auto task = std::move(tasks_.front());
+					tasks_.pop_front();
+					idle_--;
+					lock.unlock();
+					task();
+					lock.lock();
+					idle_++;
+				}
+			}
+		};
+	}
+
+	// a db per shard, ShardModel single for one instance or cluster for a mysql mgr/sqlserver ag per shard.
+	// keyed calls go to the owning shard, query_all runs on all shards at once
+	template<template<model M> typename ConnectionPool, model ShardModel>
+	class db<model::sharded, ConnectionPool, ShardModel> {
+	public:
+		using shard_db = db<ShardModel, ConnectionPool>;
+	private:
+		shard_map map_;
+		std::vector<std::unique_ptr<shard_db>> shards_;
+		std::unique_ptr<detail::fan_out> fan_out_;
+		//query_all calls at once with a thread for every shard, callers beyond run their own shards meanwhile
+		static constexpr size_t max_concurrent_scatters = 16;
+	public:
+		db(const db&) = delete;
+		db& operator=(const db&) = delete;
+
+		// nodes of every shard, shard i is map's shard i
+		db(std::vector<std::vector<node_info>> shard_nodes, shard_map map, std::string user, std::string passwd)
+			:map_(std::move(map)) {
+			check_shard_count(shard_nodes.size());
+			for (auto& nodes : shard_nodes) {
+				shards_.emplace_back(std::make_unique<shard_db>(std::move(nodes), user, passwd));
+			}
+			fan_out_ = std::make_unique<detail::fan_out>(shards_.size() - 1, (shards_.size() - 1) * max_concurrent_scatters);
+		}
+
+		db(std::vector<std::vector<node_info>> shard_nodes, shard_map map, std::string user, std::string passwd,
+			std::string odbc_driver_name, pool_options pool_opt = {})
+			:map_(std::move(map)) {
+			check_shard_count(shard_nodes.size());
+			for (auto& nodes : shard_nodes) {
+				shards_.emplace_back(std::make_unique<shard_db>(std::move(nodes), user, passwd, odbc_driver_name, pool_opt));
+			}
+			fan_out_ = std::make_unique<detail::fan_out>(shards_.size() - 1, (shards_.size() - 1) * max_concurrent_scatters);
+		}
+
+		size_t shard_count() const {
+			return shards_.size();
+		}
+
+		template<typename Key>
+		size_t shard_of(const Key& key) const {
+			return map_.shard_of(key);
+		}
+
+		// the shard db, for anything not keyed here like result cache or write-behind of one shard
+		shard_db& shard(size_t index) {
+			return *shards_.at(index);
+		}
+
+		template<typename Key>
+		shard_db& shard_for(const Key& key) {
+			return *shards_[map_.shard_of(key)];
+		}
+
+		template<conn_type Type, typename Key>
+		decltype(auto) get_conn(const Key& key) {
+			return shard_for(key).template get_conn<Type>();
+		}
+
+		// routed to the owning shard, and inside it by db::query read/write routing
+		template<typename ReturnType, typename Key, typename... Args>
+		auto query(const Key& key, std::string_view statement_sql, Args&&...args) {
+			return shard_for(key).template query<ReturnType>(statement_sql, std::forward<Args>(args)...);
+		}
+
+		template<typename Key, typename Fun>
+		auto transact(const Key& key, Fun&& fn, const retry_policy& policy = {}) {
+			return shard_for(key).transact(std::forward<Fun>(fn), policy);
+		}
+
+		// run on every shard at once, rows are put together in shard order
+		template<typename ReturnType, typename... Args>
+		auto query_all(std::string_view statement_sql, const Args&...args) {
+			if constexpr (std::is_void_v<ReturnType>) {
+				fan_out_->run(shards_.size(), [&](size_t i) {
+					shards_[i]->template query<void>(statement_sql, args...);
+				});
+			}
+			else {
+				auto parts = scatter<ReturnType>(statement_sql, args...);
+				std::vector<ReturnType> rows;
+				size_t total = 0;
+				for (const auto& part : parts) {
+					total += part.size();
+				}
+				rows.reserve(total);
+				for (auto& part : parts) {
+					std::move(part.begin(), part.end(), std::back_inserter(rows));
+				}
+				return rows;
+			}
+		}
+
+		// for an ORDER BY ... LIMIT k statement: every shard returns its rows sorted by less,
+		// they are k-way merged in that order and the first limit rows kept, 0 means all
+		template<typename ReturnType, typename Less, typename... Args>
+		std::vector<ReturnType> query_all_ordered(Less less, size_t limit, std::string_view statement_sql, const Args&...args) {
+			auto parts = scatter<ReturnType>(statement_sql, args...);
+			size_t total = 0;
+			for (const auto& part : parts) {
+				total += part.size();
+			}
+			limit = limit == 0 ? total : (std::min)(limit, total);
+
+			//heap of shard cursors, the top one has the smallest current row
+			using cursor = std::pair<size_t, size_t>; //shard, row
+			auto greater = [&parts, &less](const cursor& a, const cursor& b) {
+				return less(parts[b.first][b.second], parts[a.first][a.second]);
+			};
+			std::priority_queue<cursor, std::vector<cursor>, decltype(greater)> heap(greater);
+			for (size_t i = 0; i < parts.size(); i++) {
+				if (!parts[i].empty()) {
+					heap.push({ i, 0 });
+				}
+			}
+
+			std::vector<ReturnType> rows;
+			rows.reserve(limit);
+			while (rows.size() < limit && !heap.empty()) {
+				auto [shard, row] = heap.top();
+				heap.pop();
+				rows.emplace_back(std::move(parts[shard][row]));
+				if (row + 1 < parts[shard].size()) {
+					heap.push({ shard, row + 1 });
+				}
+			}
+			return rows;
+		}
+
+		// pools of all shards, labeled shard0, shard1...
+		std::vector<pool_stats> get_pool_stats() {
+			std::vector<pool_stats> stats;
+			for (size_t i = 0; i < shards_.size(); i++) {
+				stats.emplace_back(shards_[i]->get_pool_stats());
+				stats.back().name = "shard" + std::to_string(i);
+			}
+			return stats;
+		}
+	private:
+		void check_shard_count(size_t count) {
+			if (count == 0 || count != map_.size()) {
+				throw except::sql_exception("shard map has " + std::to_string(map_.size()) + " shards, but " + std::to_string(count) + " shard nodes given");
+			}
+		}
+
+		template<typename ReturnType, typename... Args>
+		std::vector<std::vector<ReturnType>> scatter(std::string_view statement_sql, const Args&...args) {
+			std::vector<std::vector<ReturnType>> parts(shards_.size());
+			fan_out_->run(shards_.size(), [&](size_t i) {
+				parts[i] = shards_[i]->template query<ReturnType>(statement_sql, args...);
+			});
+			return parts;
+		}
+	};
+}
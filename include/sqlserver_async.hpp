@@ -0,0 +1,241 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <tuple>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <condition_variable>
+#include <type_traits>
+#include <exception>
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L) || __cplusplus >= 202002L
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define SQLCPP_HAS_COROUTINE 1
+#endif
+#endif
+#include "db_error.hpp"
+#include "exception.hpp"
+#include "logger.hpp"
+#include "sqlserver_connection.hpp"
+
+namespace sqlcpp::sqlserver {
+	//one thread polls many running statements, each on its own connection
+	class async_loop {
+	private:
+		std::mutex mtx_;
+		std::condition_variable cond_;
+		std::vector<std::function<bool()>> incoming_;
+		std::vector<std::function<bool()>> ops_; //only touched by the polling thread
+		std::atomic<bool> run_ = true;
+		std::chrono::microseconds poll_interval_;
+	public:
+		async_loop(const async_loop&) = delete;
+		async_loop& operator=(const async_loop&) = delete;
+
+		explicit async_loop(std::chrono::microseconds poll_interval = std::chrono::microseconds(200))
+			:poll_interval_(poll_interval)
+		{}
+
+		// poll() returns true when the operation finished. thread safe
+		void post(std::function<bool()> poll) {
+			std::lock_guard<std::mutex> lock(mtx_);
+			incoming_.emplace_back(std::move(poll));
+			cond_.notify_one();
+		}
+
+		// poll every operation once, return the count still running.
+		// an operation throwing is dropped, the first exception is rethrown after all were polled
+		size_t run_once() {
+			{
+				std::lock_guard<std::mutex> lock(mtx_);
+				for (auto& op : incoming_) {
+					ops_.emplace_back(std::move(op));
+				}
+				incoming_.clear();
+			}
+
+			size_t running = 0;
+			std::exception_ptr error;
+			for (size_t i = 0; i < ops_.size(); i++) {
+				bool done = true;
+				try {
+					done = ops_[i]();
+				}
+				catch (...) { //callback or resumed coroutine threw
+					if (!error) {
+						error = std::current_exception();
+					}
+				}
+				if (!done) {
+					if (running != i) {
+						ops_[running] = std::move(ops_[i]);
+					}
+					running++;
+				}
+			}
+			ops_.resize(running);
+			if (error) {
+				std::rethrow_exception(error);
+			}
+			return running;
+		}
+
+		// poll until stop() is called and all operations finished. exceptions of operations are logged
+		void run() {
+			for (;;) {
+				size_t running = 0;
+				try {
+					running = run_once();
+				}
+				catch (const std::exception& e) {
+					SQLCPP_LOG(error, "async_loop operation error: %s", e.what());
+					running = ops_.size();
+				}
+				if (running > 0) {
+					std::this_thread::sleep_for(poll_interval_);
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(mtx_);
+				if (!run_ && incoming_.empty()) {
+					break;
+				}
+				cond_.wait(lock, [this]() { return !run_ || !incoming_.empty(); });
+			}
+		}
+
+		void stop() {
+			std::lock_guard<std::mutex> lock(mtx_);
+			run_ = false;
+			cond_.notify_one();
+		}
+	};
+
+	//a query running on one connection, args are kept until it finished
+	template<typename ReturnType, typename... Args>
+	class async_operation {
+	public:
+		using result_type = expected<query_result_t<ReturnType>>;
+	private:
+		connection& conn_;
+		std::string sql_;
+		std::tuple<Args...> args_;
+		bool started_ = false;
+	public:
+		async_operation(connection& conn, std::string sql, Args... args)
+			:conn_(conn), sql_(std::move(sql)), args_(std::move(args)...)
+		{}
+
+		// the result when finished, otherwise empty
+		std::optional<result_type> poll() {
+			try {
+				SQLRETURN retcode = SQL_SUCCESS;
+				if (!started_) {
+					started_ = true;
+					retcode = std::apply([this](auto&... args) { return conn_.template start_async<ReturnType>(sql_, args...); }, args_);
+				}
+				else {
+					retcode = conn_.poll_async();
+				}
+				if (retcode == SQL_STILL_EXECUTING) {
+					return std::nullopt;
+				}
+
+				if constexpr (std::is_same_v<ReturnType, void>) {
+					conn_.template finish_async<void>(retcode);
+					return result_type{};
+				}
+				else {
+					return result_type(conn_.template finish_async<ReturnType>(retcode));
+				}
+			}
+			catch (const except::sql_exception& e) {
+				return result_type(unexpected(db_error(e.get_error_code(), {}, "query", e.what())));
+			}
+			catch (const std::exception& e) { //like bad_alloc while reading rows
+				return result_type(unexpected(db_error(0, {}, "query", e.what())));
+			}
+		}
+	};
+
+	// run the query in loop, callback(expected<...>) is called in the loop thread.
+	// conn must not be used by others until callback
+	template<typename ReturnType, typename Callback, typename... Args>
+	void async_query(async_loop& loop, connection& conn, std::string statement_sql, Callback&& callback, Args... args) {
+		auto op = std::make_shared<async_operation<ReturnType, Args...>>(conn, std::move(statement_sql), std::move(args)...);
+		loop.post([op, callback = std::forward<Callback>(callback)]() mutable {
+			auto result = op->poll();
+			if (!result.has_value()) {
+				return false;
+			}
+			callback(std::move(*result));
+			return true;
+		});
+	}
+
+#ifdef SQLCPP_HAS_COROUTINE
+	// auto r = co_await query_awaitable<info>(loop, *conn, "select * from t where id = ?", 1);
+	// the coroutine is resumed in the loop thread
+	template<typename ReturnType, typename... Args>
+	class query_awaitable {
+	public:
+		using result_type = expected<query_result_t<ReturnType>>;
+	private:
+		async_loop& loop_;
+		async_operation<ReturnType, Args...> op_;
+		std::optional<result_type> result_;
+	public:
+		query_awaitable(async_loop& loop, connection& conn, std::string statement_sql, Args... args)
+			:loop_(loop), op_(conn, std::move(statement_sql), std::move(args)...)
+		{}
+
+		bool await_ready() {
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> h) {
+			loop_.post([this, h]() {
+				result_ = op_.poll();
+				if (!result_.has_value()) {
+					return false;
+				}
+				h.resume();
+				return true;
+			});
+		}
+
+		result_type await_resume() {
+			return std::move(*result_);
+		}
+	};
+
+	template<typename ReturnType, typename... Args>
+	query_awaitable<ReturnType, std::decay_t<Args>...> query_async(async_loop& loop, connection& conn, std::string statement_sql, Args&&...args) {
+		return { loop, conn, std::move(statement_sql), std::forward<Args>(args)... };
+	}
+
+	//fire and forget coroutine, starts at once
+	struct detached_task {
+		struct promise_type {
+			detached_task get_return_object() {
+				return {};
+			}
+			std::suspend_never initial_suspend() noexcept {
+				return {};
+			}
+			std::suspend_never final_suspend() noexcept {
+				return {};
+			}
+			void return_void() {}
+			void unhandled_exception() {
+				std::terminate();
+			}
+		};
+	};
+#endif
+}
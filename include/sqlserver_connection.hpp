@@ -1,16 +1,37 @@
 #pragma once
+#include <string>
 #include <string_view>
+#include <vector>
+#include <array>
+#include <tuple>
+#include <list>
+#include <unordered_map>
+#include <optional>
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+#include <cctype>
+#include <limits>
 #include <functional>
+#include <typeinfo>
+#ifdef SQLCPP_MOCK_DRIVER
+#include "mock/odbc.h"
+#else
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #endif
 #include <sql.h>
 #include <sqlext.h>
+#endif
 #include "db_common.h"
+#include "db_error.hpp"
+#include "trace.hpp"
+#include "logger.hpp"
 #include "db_meta.hpp"
 #include "exception.hpp"
 #include "reflection.hpp"
+#include "reflect_sql.hpp"
 
 namespace sqlcpp::sqlserver {
 	struct sqlserver_date {
@@ -25,6 +46,11 @@ namespace sqlcpp::sqlserver {
 			value.month = (SQLUSMALLINT)(s->tm_mon + 1);
 			value.day = (SQLUSMALLINT)(s->tm_mday);
 		}
+
+		// the value field by field, for cache keys
+		auto key_fields() const {
+			return std::make_tuple(value.year, value.month, value.day);
+		}
 	};
 
 	struct sqlserver_datetime {
@@ -42,119 +68,267 @@ namespace sqlcpp::sqlserver {
 			value.minute = (SQLUSMALLINT)s->tm_min;
 			value.second = (SQLUSMALLINT)s->tm_sec;
 		}
+
+		auto key_fields() const {
+			return std::make_tuple(value.year, value.month, value.day, value.hour, value.minute, value.second, value.fraction);
+		}
+	};
+
+	struct batch_status {
+		SQLULEN processed = 0; //parameter sets processed
+		std::vector<SQLUSMALLINT> row_status{}; //SQL_PARAM_SUCCESS, SQL_PARAM_ERROR... for every row
+
+		size_t failed_rows() const {
+			size_t count = 0;
+			for (auto status : row_status) {
+				if (status == SQL_PARAM_ERROR) {
+					count++;
+				}
+			}
+			return count;
+		}
+	};
+
+	struct statement_cache_stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0; //SQLPrepare and metadata calls were made
+		uint64_t evictions = 0;
+		size_t size = 0;
+	};
+
+	//a piece of one value from query_stream
+	struct value_chunk {
+		size_t row = 0; //from 0
+		SQLUSMALLINT column = 0; //from 1
+		std::string_view data{};
+		bool is_null = false;
+		bool is_last = false; //last chunk of the value
 	};
+	using chunk_sink = std::function<void(const value_chunk&)>;
 
 	class connection {
+	public:
+		static constexpr size_t max_batch_params = 2100; //parameters limit of one sqlserver request
 	private:
 		bool is_health_ = false;
+		bool in_transaction_ = false;
+		bool session_dirty_ = false; //session state may be changed by raw sql
+		bool read_only_ = false; //ApplicationIntent=ReadOnly, for readable secondary replicas
 		inline static std::atomic<int> conn_count_ = 0;
+		inline static std::atomic<SQLUINTEGER> driver_pooling_ = SQL_CP_OFF;
 		connection_options opt_{};
-		SQLHENV env_ = nullptr;
+		SQLHENV env_ = nullptr; //shared by all connections
 		SQLHDBC dbc_ = nullptr;
-		SQLHSTMT stmt_ = nullptr;
+		SQLHSTMT direct_stmt_ = nullptr; //for SQLExecDirect
+		SQLHSTMT stmt_ = nullptr; //statement in use, direct_stmt_ or a prepared one
 		scope_guard<std::function<void()>> deleter_{};
 
+		//prepared statements keyed by sql, keys point to the sql in lru list
+		struct prepared_stmt {
+			SQLHSTMT stmt = nullptr;
+			SQLSMALLINT param_count = 0;
+			SQLSMALLINT column_count = 0;
+			std::list<std::string>::iterator lru_iter{};
+			uint64_t statement_id = 0; //of fixed string sql, 0 if none
+			const std::type_info* mapped_type = nullptr; //struct of column_map, see query_by_name
+			std::vector<std::string> mapped_names{}; //result columns column_map was made for
+			std::vector<SQLUSMALLINT> column_map{}; //result column index of every member
+			bool opens_transaction = false; //begin tran by query instead of begin_transaction
+		};
+		size_t stmt_cache_size_ = 64;
+		std::list<std::string> stmt_lru_; //front is the newest
+		std::unordered_map<std::string_view, prepared_stmt> stmt_cache_;
+		std::unordered_map<uint64_t, prepared_stmt*> stmt_ids_; //fixed string sql find statements by compile-time id
+		SQLHSTMT spare_stmt_ = nullptr; //evicted or failed to prepare, reused by the next miss
+		prepared_stmt uncached_stmt_{}; //when cache size is 0
+		prepared_stmt* prepared_ = nullptr;
+		statement_cache_stats stmt_stats_{};
+
+		struct param_column {
+			std::vector<char> data;
+			std::vector<SQLLEN> ind;
+		};
+
+		struct result_column {
+			std::vector<char> data; //values of block rows
+			std::vector<SQLLEN> ind;
+			SQLLEN width = 0;
+		};
+
+		static constexpr size_t fetch_buffer_size = 1024 * 1024; //bytes of column arrays for one SQLFetch
+		static constexpr SQLULEN max_fetch_rows = 1024;
+		static constexpr SQLULEN max_bound_column_size = 8000; //bigger ones are (max) or LOB columns, read by SQLGetData
+		static constexpr size_t get_data_chunk_size = 64 * 1024;
+		std::vector<char> chunk_buf_{}; //SQLGetData chunks
+		trace::recorder recorder_{ "sqlserver" };
+		std::optional<trace::recorder::scope> async_span_; //from start_async to finish_async, after recorder_ so destroyed first
+
 	public:
 		connection(const connection&) = delete;
 		connection& operator=(const connection&) = delete;
 
-		connection(const connection_options& opt, const std::string& driver_name) {
+		connection(const connection_options& opt, const std::string& driver_name, bool read_only = false) {
 			opt_ = opt;
+			read_only_ = read_only;
 			deleter_.set_releaser([this]() {
-				if (stmt_ != nullptr) {
-					SQLFreeHandle(SQL_HANDLE_STMT, stmt_);
+				for (auto& [sql, prepared] : stmt_cache_) {
+					SQLFreeHandle(SQL_HANDLE_STMT, prepared.stmt);
+				}
+				if (spare_stmt_ != nullptr) {
+					SQLFreeHandle(SQL_HANDLE_STMT, spare_stmt_);
+				}
+				if (direct_stmt_ != nullptr) {
+					SQLFreeHandle(SQL_HANDLE_STMT, direct_stmt_);
 				}
 				if (dbc_ != SQL_NULL_HDBC) {
 					SQLDisconnect(dbc_);
 					SQLFreeHandle(SQL_HANDLE_DBC, dbc_);
 				}
-				if (env_ != SQL_NULL_HENV) {
-					SQLFreeHandle(SQL_HANDLE_ENV, env_);
-				}
 			});
 
-			auto retcode = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env_);
-			if (retcode != SQL_SUCCESS) {
-				throw except::sqlserver_exception("SQLAllocHandle(env) error:" + sqlserver_error(env_, SQL_HANDLE_ENV));
-			}
-
-			retcode = SQLSetEnvAttr(env_, SQL_ATTR_ODBC_VERSION, (SQLPOINTER)SQL_OV_ODBC3, 0);
-			if (retcode != SQL_SUCCESS) {
-				throw except::sqlserver_exception("SQLSetEnvAttr(version) error:" + sqlserver_error(env_, SQL_HANDLE_ENV));
-			}
-
-			retcode = SQLAllocHandle(SQL_HANDLE_DBC, env_, &dbc_);
+			env_ = shared_env();
+			auto retcode = SQLAllocHandle(SQL_HANDLE_DBC, env_, &dbc_);
 			if (retcode != SQL_SUCCESS) {
 				throw except::sqlserver_exception("SQLAllocHandle(dbc) error:" + sqlserver_error(env_, SQL_HANDLE_ENV));
 			}
 
 			connect(opt, driver_name);
-			retcode = SQLAllocHandle(SQL_HANDLE_STMT, dbc_, &stmt_);
+			retcode = SQLAllocHandle(SQL_HANDLE_STMT, dbc_, &direct_stmt_);
 			if (retcode != SQL_SUCCESS) {
 				throw except::sqlserver_exception("SQLAllocHandle(stmt) error:" + sqlserver_error(dbc_, SQL_HANDLE_DBC));
 			}
+			stmt_ = direct_stmt_;
 			is_health_ = true;
+			recorder_.set_node(opt_.ip);
 			conn_count_++;
-			printf("sqlserver create conn <%s>, count:%d\n", opt_.ip.c_str(), conn_count_.load());
+			SQLCPP_LOG(trace, "sqlserver create conn <%s>, count:%d", opt_.ip.c_str(), conn_count_.load());
 		}
 
 		~connection() {
 			conn_count_--;
-			printf("sqlserver release conn <%s>, count:%d\n", opt_.ip.c_str(), conn_count_.load());
+			SQLCPP_LOG(trace, "sqlserver release conn <%s>, count:%d", opt_.ip.c_str(), conn_count_.load());
+		}
+
+		// driver manager connection pooling: SQL_CP_OFF(default), SQL_CP_ONE_PER_DRIVER or SQL_CP_ONE_PER_HENV.
+		// must be set before the first connection is created
+		static void set_driver_pooling(SQLUINTEGER mode) {
+			driver_pooling_ = mode;
 		}
 
 		void execute(const std::string& sql) {
-			auto retcode = SQLExecDirect(stmt_, (SQLCHAR*)sql.data(), SQL_NTS);
-			//If SQLExecute executes a searched update, insert, or delete statement
-			//that does not affect any rows at the data source, the call to SQLExecute returns SQL_NO_DATA.
-			if (retcode == SQL_NO_DATA) {
-				;
-			}
-			else if (retcode != SQL_SUCCESS) {
-				is_health_ = false;
-				throw except::sqlserver_exception("Failed to excute sql<" + sql + ">: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
-			}
-			scope_guard sg([this]() {
-				auto retcode = SQLFreeStmt(stmt_, SQL_CLOSE);
-				if (retcode != SQL_SUCCESS) {
-					is_health_ = false;
-					throw except::sqlserver_exception("SQLFreeStmt error:" + sqlserver_error(stmt_, SQL_HANDLE_STMT));
-				}
-			});
+			session_dirty_ = true;
+			execute_sql(sql);
 		}
 
 		void begin_transaction() {
-			execute("begin tran");
+			execute_sql("begin tran");
+			in_transaction_ = true;
 		}
 
 		void commit_transaction() {
-			execute("commit tran");
+			execute_sql("commit tran");
+			in_transaction_ = false;
 		}
 
 		void rollback() {
-			execute("rollback tran");
+			in_transaction_ = false;
+			execute_sql("rollback tran");
+		}
+
+		// make the session clean before going back to pool. false means the connection should be dropped.
+		// set options, temp tables and session context of raw sql can not be undone like mysql_reset_connection does,
+		// so such sessions are dropped
+		bool reset_session() {
+			if (!is_health_ || session_dirty_) {
+				return false;
+			}
+
+			if (!in_transaction_) {
+				return true;
+			}
+
+			stmt_ = direct_stmt_;
+			auto retcode = SQLExecDirect(stmt_, (SQLCHAR*)"if @@trancount > 0 rollback tran", SQL_NTS);
+			if (retcode != SQL_SUCCESS && retcode != SQL_SUCCESS_WITH_INFO && retcode != SQL_NO_DATA) {
+				return false;
+			}
+			if (SQLFreeStmt(stmt_, SQL_CLOSE) != SQL_SUCCESS) {
+				return false;
+			}
+			in_transaction_ = false;
+			return true;
 		}
 
 		bool is_health() {
 			return is_health_;
 		}
 
+		const std::string& get_ip() const {
+			return opt_.ip;
+		}
+
+		bool is_read_only() const {
+			return read_only_;
+		}
+
+		// ask the driver whether the connection is dead, no round trip to server
+		bool is_alive() {
+			SQLUINTEGER dead = SQL_CD_FALSE;
+			auto retcode = SQLGetConnectAttr(dbc_, SQL_ATTR_CONNECTION_DEAD, &dead, SQL_IS_UINTEGER, nullptr);
+			if ((retcode != SQL_SUCCESS && retcode != SQL_SUCCESS_WITH_INFO) || dead == SQL_CD_TRUE) {
+				is_health_ = false;
+			}
+			return is_health_;
+		}
+
+#ifdef SQLCPP_TRACE
+		// queries are reported to o, null stops it. pools set their observer on every checkout
+		void set_observer(std::shared_ptr<trace::observer> o) {
+			recorder_.set_observer(std::move(o));
+		}
+
+		void trace_acquired(std::shared_ptr<trace::observer> o, std::chrono::nanoseconds wait) {
+			recorder_.acquired(std::move(o), wait);
+		}
+
+#endif
+		// max prepared statements kept by this connection, 0 disables the cache
+		void set_statement_cache_size(size_t size) {
+			stmt_cache_size_ = size;
+			while (stmt_cache_.size() > stmt_cache_size_) {
+				evict_stmt();
+			}
+		}
+
+		statement_cache_stats get_statement_cache_stats() const {
+			auto stats = stmt_stats_;
+			stats.size = stmt_cache_.size();
+			return stats;
+		}
+
+		// deadlock victim or lock request timeout, the transaction can be run again
+		static bool is_retriable_error(int error_code) {
+			return error_code == 1205 || error_code == 1222;
+		}
+
 		// this query has data back from sqlserver
 		template<typename ReturnType, typename... Args>
 		std::enable_if_t<is_tuple_v<ReturnType> || reflection::is_reflection_v<ReturnType>, std::vector<ReturnType>>
 			query(std::string_view statement_sql, Args&&...args) {
+			auto span = recorder_.start(statement_sql);
 			before_execute<ReturnType>(statement_sql, std::forward<Args>(args)...);
 			//execute
 			auto retcode = SQLExecute(stmt_);
+			recorder_.mark(trace::phase::execute);
 			//If SQLExecute executes a searched update, insert, or delete statement
 			//that does not affect any rows at the data source, the call to SQLExecute returns SQL_NO_DATA.
 			if (retcode == SQL_NO_DATA) {
 				;
 			}
 			else if (retcode != SQL_SUCCESS) {
-				is_health_ = false;
+				auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
 				auto error_msg = std::string("failed to SQLExecute : ") + sqlserver_error(stmt_, SQL_HANDLE_STMT);
-				throw except::sqlserver_exception(std::move(error_msg));
+				throw except::sqlserver_exception(std::move(error_msg), error_code);
 			}
 			scope_guard sg([this]() {
 				auto retcode = SQLFreeStmt(stmt_, SQL_CLOSE);
@@ -176,18 +350,20 @@ namespace sqlcpp::sqlserver {
 		template<typename ReturnType, typename... Args>
 		std::enable_if_t<!is_tuple_v<ReturnType> && !reflection::is_reflection_v<ReturnType> && !std::is_same_v<ReturnType, void>,
 			std::vector<ReturnType>> query(std::string_view statement_sql, Args&&...args) {
+			auto span = recorder_.start(statement_sql);
 			before_execute<ReturnType>(statement_sql, std::forward<Args>(args)...);
 			//execute
 			auto retcode = SQLExecute(stmt_);
+			recorder_.mark(trace::phase::execute);
 			//If SQLExecute executes a searched update, insert, or delete statement
 			//that does not affect any rows at the data source, the call to SQLExecute returns SQL_NO_DATA.
 			if (retcode == SQL_NO_DATA) {
 				;
 			}
 			else if (retcode != SQL_SUCCESS) {
-				is_health_ = false;
+				auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
 				auto error_msg = std::string("failed to SQLExecute : ") + sqlserver_error(stmt_, SQL_HANDLE_STMT);
-				throw except::sqlserver_exception(std::move(error_msg));
+				throw except::sqlserver_exception(std::move(error_msg), error_code);
 			}
 			scope_guard sg([this]() {
 				auto retcode = SQLFreeStmt(stmt_, SQL_CLOSE);
@@ -204,18 +380,334 @@ namespace sqlcpp::sqlserver {
 		template<typename ReturnType, typename... Args>
 		std::enable_if_t<std::is_same_v<ReturnType, void>>
 			query(std::string_view statement_sql, Args&&...args) {
+			auto span = recorder_.start(statement_sql);
 			before_execute<void>(statement_sql, std::forward<Args>(args)...);
 
 			auto retcode = SQLExecute(stmt_);
+			recorder_.mark(trace::phase::execute);
 			//If SQLExecute executes a searched update, insert, or delete statement
 			//that does not affect any rows at the data source, the call to SQLExecute returns SQL_NO_DATA.
 			if (retcode == SQL_NO_DATA) {
 				;
 			}
 			else if(retcode != SQL_SUCCESS) {
-				is_health_ = false;
+				auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
+				auto error_msg = std::string("failed to SQLExecute : ") + sqlserver_error(stmt_, SQL_HANDLE_STMT);
+				throw except::sqlserver_exception(std::move(error_msg), error_code);
+			}
+			scope_guard sg([this]() {
+				auto retcode = SQLFreeStmt(stmt_, SQL_CLOSE);
+				if (retcode != SQL_SUCCESS) {
+					is_health_ = false;
+					throw except::sqlserver_exception("SQLFreeStmt error:" + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+				}
+			});
+		}
+
+		// columns are matched to members by name(case insensitive), not by position. extra columns are ignored.
+		// the mapping is cached with the prepared statement and made again when the column names change,
+		// so select * keeps working after schema changes
+		template<typename ReturnType, typename... Args>
+		std::vector<ReturnType> query_by_name(std::string_view statement_sql, Args&&...args) {
+			static_assert(reflection::is_reflection_v<ReturnType>, "query_by_name needs REFLECT struct");
+			auto span = recorder_.start(statement_sql);
+			before_execute<ReturnType, true>(statement_sql, std::forward<Args>(args)...);
+			//execute
+			auto retcode = SQLExecute(stmt_);
+			recorder_.mark(trace::phase::execute);
+			if (retcode == SQL_NO_DATA) {
+				;
+			}
+			else if (retcode != SQL_SUCCESS) {
+				auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
+				auto error_msg = std::string("failed to SQLExecute : ") + sqlserver_error(stmt_, SQL_HANDLE_STMT);
+				throw except::sqlserver_exception(std::move(error_msg), error_code);
+			}
+			scope_guard sg([this]() {
+				auto retcode = SQLFreeStmt(stmt_, SQL_CLOSE);
+				if (retcode != SQL_SUCCESS) {
+					is_health_ = false;
+					throw except::sqlserver_exception("SQLFreeStmt error:" + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+				}
+			});
+
+			const auto& column_map = mapped_columns<ReturnType>(); //of the executed result, not the prepared one
+			return after_execute<ReturnType::args_size_t::value, ReturnType>(column_map.data());
+		}
+
+#ifdef SQLCPP_HAS_FIXED_STRING
+		// sql is a template argument, placeholders are counted at compile time.
+		// the cached statement is found by the compile-time id instead of hashing the sql text
+		template<typename ReturnType, sql::fixed_string Sql, typename... Args>
+		query_result_t<ReturnType> query(Args&&...args) {
+			using statement = sql::statement<Sql>;
+			static_assert(statement::param_count == param_size_v<Args...>, "param size do not match placeholder size");
+			auto span = recorder_.start(statement::text);
+			if (prepare(statement::text, statement::id) != SQL_SUCCESS) {
+				auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
+				auto error_msg = std::string("Failed to SQLPrepare sql<") + std::string(statement::text) + ">: "
+					+ sqlserver_error(stmt_, SQL_HANDLE_STMT);
+				throw except::sqlserver_exception(std::move(error_msg), error_code);
+			}
+			recorder_.mark(trace::phase::prepare);
+			check_and_bind<ReturnType, false, true>(std::forward<Args>(args)...);
+			recorder_.mark(trace::phase::bind);
+			auto retcode = SQLExecute(stmt_);
+			recorder_.mark(trace::phase::execute);
+			return finish_execute<ReturnType>(retcode);
+		}
+#endif
+
+		// same as query, but errors are returned instead of thrown. for hot paths expecting errors, like duplicate key
+		template<typename ReturnType, typename... Args>
+		expected<query_result_t<ReturnType>> try_query(std::string_view statement_sql, Args&&...args) {
+			auto span = recorder_.start(statement_sql);
+			auto retcode = prepare(statement_sql);
+			recorder_.mark(trace::phase::prepare);
+			if (retcode != SQL_SUCCESS) {
+				return stmt_error("SQLPrepare");
+			}
+
+			try {
+				check_and_bind<ReturnType>(std::forward<Args>(args)...);
+				recorder_.mark(trace::phase::bind);
+				retcode = SQLExecute(stmt_);
+				recorder_.mark(trace::phase::execute);
+				if (retcode != SQL_SUCCESS && retcode != SQL_NO_DATA) {
+					return stmt_error("SQLExecute");
+				}
+				scope_guard sg([this]() {
+					if (SQLFreeStmt(stmt_, SQL_CLOSE) != SQL_SUCCESS) {
+						is_health_ = false;
+					}
+				});
+
+				if constexpr (std::is_same_v<ReturnType, void>) {
+					return {};
+				}
+				else if constexpr (is_tuple_v<ReturnType>) {
+					return after_execute<std::tuple_size_v<ReturnType>, ReturnType>();
+				}
+				else if constexpr (reflection::is_reflection_v<ReturnType>) {
+					return after_execute<ReturnType::args_size_t::value, ReturnType>();
+				}
+				else {
+					return after_execute<1, ReturnType>();
+				}
+			}
+			catch (const except::sql_exception& e) { //param mismatch or fetch failed, rare
+				return unexpected(db_error(e.get_error_code(), {}, "query", e.what()));
+			}
+		}
+
+		// stream all values to sink chunk by chunk without holding them in memory, like writing (max) columns to files.
+		// binary columns are raw bytes, others are text. return the row count
+		template<typename... Args>
+		size_t query_stream(std::string_view statement_sql, const chunk_sink& sink, Args&&...args) {
+			auto span = recorder_.start(statement_sql);
+			before_execute<void>(statement_sql, std::forward<Args>(args)...);
+			auto retcode = SQLExecute(stmt_);
+			recorder_.mark(trace::phase::execute);
+			if (retcode == SQL_NO_DATA) {
+				;
+			}
+			else if (retcode != SQL_SUCCESS) {
+				auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
 				auto error_msg = std::string("failed to SQLExecute : ") + sqlserver_error(stmt_, SQL_HANDLE_STMT);
-				throw except::sqlserver_exception(std::move(error_msg));
+				throw except::sqlserver_exception(std::move(error_msg), error_code);
+			}
+			scope_guard sg([this]() {
+				auto retcode = SQLFreeStmt(stmt_, SQL_CLOSE);
+				if (retcode != SQL_SUCCESS) {
+					is_health_ = false;
+					throw except::sqlserver_exception("SQLFreeStmt error:" + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+				}
+			});
+
+			std::vector<SQLSMALLINT> c_types((size_t)result_columns(), SQL_C_CHAR);
+			for (SQLUSMALLINT i = 0; i < (SQLUSMALLINT)c_types.size(); i++) {
+				SQLSMALLINT data_type = 0;
+				SQLULEN column_size = 0;
+				SQLSMALLINT decimal_digits = 0;
+				SQLSMALLINT nullable = 0;
+				retcode = SQLDescribeCol(stmt_, i + 1, nullptr, 0, nullptr, &data_type, &column_size, &decimal_digits, &nullable);
+				if (retcode != SQL_SUCCESS && retcode != SQL_SUCCESS_WITH_INFO) {
+					throw except::sqlserver_exception("SQLDescribeCol error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+				}
+				if (data_type == SQL_BINARY || data_type == SQL_VARBINARY || data_type == SQL_LONGVARBINARY) {
+					c_types[i] = SQL_C_BINARY;
+				}
+			}
+
+			size_t row = 0;
+			for (;; row++) {
+				retcode = SQLFetch(stmt_);
+				if (retcode == SQL_NO_DATA) {
+					recorder_.mark(trace::phase::fetch);
+					recorder_.rows((uint64_t)row);
+					break;
+				}
+				else if (retcode == SQL_ERROR) {
+					auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
+					throw except::sqlserver_exception("SQLFetch error:" + sqlserver_error(stmt_, SQL_HANDLE_STMT), error_code);
+				}
+
+				for (SQLUSMALLINT i = 0; i < (SQLUSMALLINT)c_types.size(); i++) {
+					value_chunk chunk{ row, (SQLUSMALLINT)(i + 1) };
+					auto has_value = get_data_chunks(chunk.column, c_types[i], [&chunk, &sink](std::string_view data, bool is_last) {
+						chunk.data = data;
+						chunk.is_last = is_last;
+						sink(chunk);
+					});
+					if (!has_value) {
+						chunk.data = {};
+						chunk.is_null = true;
+						chunk.is_last = true;
+						sink(chunk);
+					}
+				}
+			}
+			return row;
+		}
+
+		// async execution, used by async_loop. prepare and bind, then start SQLExecute with SQL_ATTR_ASYNC_ENABLE.
+		// args must live until finish_async. SQL_STILL_EXECUTING means call poll_async later
+		template<typename ReturnType, typename... Args>
+		SQLRETURN start_async(std::string_view statement_sql, Args&&...args) {
+			auto span = recorder_.start(statement_sql);
+			before_execute<ReturnType>(statement_sql, std::forward<Args>(args)...);
+			//driver without async support just runs it synchronously
+			SQLSetStmtAttr(stmt_, SQL_ATTR_ASYNC_ENABLE, (SQLPOINTER)SQL_ASYNC_ENABLE_ON, 0);
+			auto retcode = SQLExecute(stmt_);
+			async_span_.emplace(std::move(span)); //ended by finish_async
+			return retcode;
+		}
+
+		// call SQLExecute again to check whether the running statement has finished
+		SQLRETURN poll_async() {
+			return SQLExecute(stmt_);
+		}
+
+		// the statement finished with retcode, fetch results synchronously by block cursor
+		template<typename ReturnType>
+		query_result_t<ReturnType> finish_async(SQLRETURN retcode) {
+			std::optional<trace::recorder::scope> span = std::move(async_span_);
+			async_span_.reset();
+			recorder_.mark(trace::phase::execute);
+			SQLSetStmtAttr(stmt_, SQL_ATTR_ASYNC_ENABLE, (SQLPOINTER)SQL_ASYNC_ENABLE_OFF, 0);
+			return finish_execute<ReturnType>(retcode);
+		}
+
+		// send all rows by ODBC parameter arrays in one SQLExecute. statement_sql has placeholders for one row,
+		// like insert into t(a,b) values(?,?)
+		template<typename T>
+		batch_status execute_batch(std::string_view statement_sql, const std::vector<T>& rows) {
+			static_assert(is_tuple_v<T> || reflection::is_reflection_v<T>, "row type must be tuple or reflect struct");
+			batch_status status;
+			if (rows.empty()) {
+				return status;
+			}
+
+			auto span = recorder_.start(statement_sql);
+			prepare_or_throw(statement_sql);
+			constexpr size_t field_count = row_size_v<T>;
+			SQLSMALLINT placeholder_size = prepared_->param_count;
+			if ((size_t)placeholder_size != field_count) {
+				throw except::sqlserver_exception("param size do not match placeholder size");
+			}
+
+			//parameter arrays live until SQLExecute finished
+			std::array<param_column, field_count> columns;
+			scope_guard sg([this]() {
+				SQLSetStmtAttr(stmt_, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)1, 0);
+				SQLSetStmtAttr(stmt_, SQL_ATTR_PARAM_STATUS_PTR, nullptr, 0);
+				SQLSetStmtAttr(stmt_, SQL_ATTR_PARAMS_PROCESSED_PTR, nullptr, 0);
+				SQLFreeStmt(stmt_, SQL_RESET_PARAMS);
+				if (SQLFreeStmt(stmt_, SQL_CLOSE) != SQL_SUCCESS) {
+					is_health_ = false;
+				}
+			});
+
+			if constexpr (is_tuple_v<T>) {
+				for_each_tuple([&columns, &rows, this](auto index) {
+					this->bind_param_column((SQLUSMALLINT)(index + 1), columns[index], rows,
+						[](const T& row) -> decltype(auto) { return std::get<decltype(index)::value>(row); });
+				}, std::make_index_sequence<field_count>());
+			}
+			else {
+				constexpr auto address = T::elements_address();
+				for_each_tuple([&columns, &rows, &address, this](auto index) {
+					this->bind_param_column((SQLUSMALLINT)(index + 1), columns[index], rows,
+						[&address](const T& row) -> decltype(auto) { return row.*std::get<decltype(index)::value>(address); });
+				}, std::make_index_sequence<field_count>());
+			}
+
+			status.row_status.resize(rows.size());
+			SQLSetStmtAttr(stmt_, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER)SQL_PARAM_BIND_BY_COLUMN, 0);
+			SQLSetStmtAttr(stmt_, SQL_ATTR_PARAM_STATUS_PTR, status.row_status.data(), 0);
+			SQLSetStmtAttr(stmt_, SQL_ATTR_PARAMS_PROCESSED_PTR, &status.processed, 0);
+			auto retcode = SQLSetStmtAttr(stmt_, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)(SQLULEN)rows.size(), 0);
+			if (retcode != SQL_SUCCESS) {
+				throw except::sqlserver_exception("SQLSetStmtAttr(paramset size) error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+			}
+			recorder_.mark(trace::phase::bind);
+			recorder_.rows((uint64_t)rows.size());
+
+			retcode = SQLExecute(stmt_);
+			recorder_.mark(trace::phase::execute);
+			//with parameter arrays, SQL_ERROR may come back when only some rows failed, see row_status.
+			//a link lost partway through fails the whole call
+			if (retcode == SQL_ERROR) {
+				auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
+				if (status.processed == 0 || !is_health_) {
+					auto error_msg = std::string("failed to SQLExecute : ") + sqlserver_error(stmt_, SQL_HANDLE_STMT);
+					throw except::sqlserver_exception(std::move(error_msg), error_code);
+				}
+			}
+			return status;
+		}
+
+		// bind rows one after another to a multi-row statement, like insert into t(a,b) values(?,?),(?,?)
+		template<typename T>
+		void query_batch(std::string_view statement_sql, const std::vector<T>& rows) {
+			static_assert(is_tuple_v<T> || reflection::is_reflection_v<T>, "row type must be tuple or reflect struct");
+			auto span = recorder_.start(statement_sql);
+			prepare_or_throw(statement_sql);
+			constexpr size_t field_count = row_size_v<T>;
+			SQLSMALLINT placeholder_size = prepared_->param_count;
+			if ((size_t)placeholder_size != rows.size() * field_count) {
+				throw except::sqlserver_exception("param size do not match placeholder size");
+			}
+			if (rows.empty()) {
+				return;
+			}
+
+			SQLUSMALLINT param_index = 1;
+			for (const auto& row : rows) {
+				if constexpr (is_tuple_v<T>) {
+					for_each_tuple([&row, &param_index, this](auto index) {
+						this->build_bind_param(param_index++, std::get<index>(row));
+					}, std::make_index_sequence<field_count>());
+				}
+				else {
+					constexpr auto address = T::elements_address();
+					for_each_tuple([&row, &param_index, &address, this](auto index) {
+						this->build_bind_param(param_index++, row.*std::get<index>(address));
+					}, std::make_index_sequence<field_count>());
+				}
+			}
+			recorder_.mark(trace::phase::bind);
+			recorder_.rows((uint64_t)rows.size());
+
+			auto retcode = SQLExecute(stmt_);
+			recorder_.mark(trace::phase::execute);
+			if (retcode == SQL_NO_DATA) {
+				;
+			}
+			else if (retcode != SQL_SUCCESS) {
+				auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
+				auto error_msg = std::string("failed to SQLExecute : ") + sqlserver_error(stmt_, SQL_HANDLE_STMT);
+				throw except::sqlserver_exception(std::move(error_msg), error_code);
 			}
 			scope_guard sg([this]() {
 				auto retcode = SQLFreeStmt(stmt_, SQL_CLOSE);
@@ -227,6 +719,161 @@ namespace sqlcpp::sqlserver {
 		}
 
 	private:
+		// one environment for the whole process, never freed since connections may live in static objects
+		static SQLHENV shared_env() {
+			static SQLHENV env = []() {
+				auto pooling = driver_pooling_.load();
+				if (pooling != SQL_CP_OFF) { //process level attribute, set before the environment is allocated
+					SQLSetEnvAttr(SQL_NULL_HENV, SQL_ATTR_CONNECTION_POOLING, (SQLPOINTER)(uintptr_t)pooling, SQL_IS_UINTEGER);
+				}
+
+				SQLHENV env = SQL_NULL_HENV;
+				auto retcode = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env);
+				if (retcode != SQL_SUCCESS) {
+					throw except::sqlserver_exception("SQLAllocHandle(env) error");
+				}
+
+				retcode = SQLSetEnvAttr(env, SQL_ATTR_ODBC_VERSION, (SQLPOINTER)SQL_OV_ODBC3, 0);
+				if (retcode != SQL_SUCCESS) {
+					auto error = "SQLSetEnvAttr(version) error:" + sqlserver_error(env, SQL_HANDLE_ENV);
+					SQLFreeHandle(SQL_HANDLE_ENV, env);
+					throw except::sqlserver_exception(error);
+				}
+				if (pooling != SQL_CP_OFF) {
+					SQLSetEnvAttr(env, SQL_ATTR_CP_MATCH, (SQLPOINTER)SQL_CP_RELAXED_MATCH, SQL_IS_UINTEGER);
+				}
+				return env;
+			}();
+			return env;
+		}
+
+		// make stmt_ the prepared statement of sql. cached ones skip SQLPrepare and metadata calls.
+		// on failure stmt_ is the failed statement, read the error from it
+		SQLRETURN prepare(std::string_view statement_sql) {
+			if (auto iter = stmt_cache_.find(statement_sql); iter != stmt_cache_.end()) {
+				use_cached(iter->second);
+				return SQL_SUCCESS;
+			}
+
+			stmt_stats_.misses++;
+			if (spare_stmt_ == nullptr) {
+				if (stmt_cache_size_ > 0 && stmt_cache_.size() >= stmt_cache_size_) {
+					evict_stmt();
+				}
+				else if (SQLAllocHandle(SQL_HANDLE_STMT, dbc_, &spare_stmt_) != SQL_SUCCESS) {
+					stmt_ = direct_stmt_;
+					spare_stmt_ = nullptr;
+					throw except::sqlserver_exception("SQLAllocHandle(stmt) error:" + sqlserver_error(dbc_, SQL_HANDLE_DBC));
+				}
+			}
+
+			prepared_stmt prepared{ spare_stmt_ };
+			prepared.opens_transaction = opens_transaction(statement_sql);
+			in_transaction_ |= prepared.opens_transaction;
+			stmt_ = spare_stmt_;
+			auto retcode = SQLPrepare(stmt_, (SQLCHAR*)statement_sql.data(), (SQLINTEGER)statement_sql.length());
+			if (retcode != SQL_SUCCESS) {
+				return retcode;
+			}
+			retcode = SQLNumParams(stmt_, &prepared.param_count);
+			if (retcode != SQL_SUCCESS) {
+				return retcode;
+			}
+			retcode = SQLNumResultCols(stmt_, &prepared.column_count);
+			if (retcode != SQL_SUCCESS) {
+				return retcode;
+			}
+
+			if (stmt_cache_size_ == 0) { //keep it as spare, prepare again next time
+				uncached_stmt_ = prepared;
+				prepared_ = &uncached_stmt_;
+				return SQL_SUCCESS;
+			}
+			spare_stmt_ = nullptr;
+			prepared.lru_iter = stmt_lru_.emplace(stmt_lru_.begin(), statement_sql);
+			auto [iter, ok] = stmt_cache_.emplace(*prepared.lru_iter, prepared);
+			prepared_ = &iter->second;
+			return SQL_SUCCESS;
+		}
+
+		// same as above, cached statements are found by statement_id
+		SQLRETURN prepare(std::string_view statement_sql, uint64_t statement_id) {
+			if (auto iter = stmt_ids_.find(statement_id); iter != stmt_ids_.end()) {
+				use_cached(*iter->second);
+				return SQL_SUCCESS;
+			}
+
+			auto retcode = prepare(statement_sql);
+			if (retcode == SQL_SUCCESS && prepared_ != &uncached_stmt_) {
+				prepared_->statement_id = statement_id;
+				stmt_ids_[statement_id] = prepared_;
+			}
+			return retcode;
+		}
+
+		void use_cached(prepared_stmt& prepared) {
+			in_transaction_ |= prepared.opens_transaction;
+			stmt_lru_.splice(stmt_lru_.begin(), stmt_lru_, prepared.lru_iter);
+			stmt_ = prepared.stmt;
+			prepared_ = &prepared;
+			stmt_stats_.hits++;
+		}
+
+		// begin tran or begin distributed transaction anywhere in the batch, it is rolled back on return if still open
+		static bool opens_transaction(std::string_view statement_sql) {
+			std::string sql(statement_sql.size(), ' ');
+			std::transform(statement_sql.begin(), statement_sql.end(), sql.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+			constexpr std::string_view space = " \t\r\n";
+			for (auto pos = sql.find("begin"); pos != std::string::npos; pos = sql.find("begin", pos + 5)) {
+				auto next = sql.find_first_not_of(space, pos + 5);
+				if (next == pos + 5 || next == std::string::npos) {
+					continue;
+				}
+				if (sql.compare(next, 11, "distributed") == 0) {
+					next = sql.find_first_not_of(space, next + 11);
+				}
+				if (next != std::string::npos && sql.compare(next, 4, "tran") == 0) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void prepare_or_throw(std::string_view statement_sql) {
+			auto retcode = prepare(statement_sql);
+			recorder_.mark(trace::phase::prepare);
+			if (retcode != SQL_SUCCESS) {
+				auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
+				auto error_msg = std::string("Failed to SQLPrepare sql<") + std::string(statement_sql) + ">: "
+					+ sqlserver_error(stmt_, SQL_HANDLE_STMT);
+				throw except::sqlserver_exception(std::move(error_msg), error_code);
+			}
+		}
+
+		// drop the least recently used statement, its handle becomes the spare one
+		void evict_stmt() {
+			auto iter = stmt_cache_.find(stmt_lru_.back());
+			auto stmt = iter->second.stmt;
+			if (iter->second.statement_id != 0) {
+				stmt_ids_.erase(iter->second.statement_id);
+			}
+			stmt_cache_.erase(iter);
+			stmt_lru_.pop_back();
+			stmt_stats_.evictions++;
+			if (stmt_ == stmt) {
+				stmt_ = direct_stmt_;
+			}
+
+			SQLFreeStmt(stmt, SQL_CLOSE);
+			SQLFreeStmt(stmt, SQL_RESET_PARAMS);
+			if (spare_stmt_ == nullptr) {
+				spare_stmt_ = stmt;
+			}
+			else {
+				SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+			}
+		}
+
 		void connect(const connection_options& opt, const std::string& driver_name) {
 			auto retcode = SQLSetConnectAttr(dbc_, SQL_LOGIN_TIMEOUT, (SQLPOINTER)3, 0);
 			if (retcode != SQL_SUCCESS) {
@@ -234,10 +881,13 @@ namespace sqlcpp::sqlserver {
 			}
 			//"DRIVER={SQL Server}"
 			//"Driver=ODBC Driver 17 for SQL Server"
-			std::string host = ";SERVER=" + opt.ip;
+			std::string host = ";SERVER=" + opt.ip + (opt.port.empty() ? "" : "," + opt.port);
 			std::string user = ";UID=" + opt.user;
 			std::string pwd = ";PWD=" + opt.passwd;
 			auto conn_str = driver_name + host + user + pwd;
+			if (read_only_) {
+				conn_str += ";ApplicationIntent=ReadOnly";
+			}
 			//auto conn_str = driver + host + user + pwd + ";charset=gb2312";
 			//auto conn_str = driver + host + user + pwd + ";charset=utf8";
 
@@ -248,7 +898,65 @@ namespace sqlcpp::sqlserver {
 			}
 		}
 
-		std::string sqlserver_error(SQLHANDLE handle, SQLSMALLINT type) {
+		void execute_sql(const std::string& sql) {
+			stmt_ = direct_stmt_;
+			auto retcode = SQLExecDirect(stmt_, (SQLCHAR*)sql.data(), SQL_NTS);
+			//If SQLExecute executes a searched update, insert, or delete statement
+			//that does not affect any rows at the data source, the call to SQLExecute returns SQL_NO_DATA.
+			if (retcode == SQL_NO_DATA) {
+				;
+			}
+			else if (retcode != SQL_SUCCESS) {
+				auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
+				throw except::sqlserver_exception("Failed to excute sql<" + sql + ">: " + sqlserver_error(stmt_, SQL_HANDLE_STMT), error_code);
+			}
+			scope_guard sg([this]() {
+				auto retcode = SQLFreeStmt(stmt_, SQL_CLOSE);
+				if (retcode != SQL_SUCCESS) {
+					is_health_ = false;
+					throw except::sqlserver_exception("SQLFreeStmt error:" + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+				}
+			});
+		}
+
+		// SQLSTATE class 08 is connection exception, others(like 23000 integrity constraint violation) are statement level.
+		// all records are checked, parameter arrays put row errors before a link lost later. return the first native error
+		int check_health(SQLHANDLE handle, SQLSMALLINT type) {
+			SQLSMALLINT msg_len = 0;
+			SQLCHAR sql_state[SQL_SQLSTATE_SIZE + 1]{};
+			SQLINTEGER native_error = 0;
+			if (SQLGetDiagRec(type, handle, 1, sql_state, &native_error, nullptr, 0, &msg_len) == SQL_NO_DATA) {
+				is_health_ = false; //unknown reason
+				return 0;
+			}
+			recorder_.error((int)native_error);
+			auto first_error = (int)native_error;
+			for (SQLSMALLINT record = 2; ; record++) {
+				std::string_view state((char*)sql_state);
+				if (state.substr(0, 2) == "08" || state == "HYT01") {
+					is_health_ = false;
+					break;
+				}
+				auto retcode = SQLGetDiagRec(type, handle, record, sql_state, &native_error, nullptr, 0, &msg_len);
+				if (retcode != SQL_SUCCESS && retcode != SQL_SUCCESS_WITH_INFO) {
+					break;
+				}
+			}
+			return first_error;
+		}
+
+		unexpected<db_error> stmt_error(const char* where) {
+			check_health(stmt_, SQL_HANDLE_STMT);
+			SQLSMALLINT msg_len = 0;
+			SQLCHAR sql_state[SQL_SQLSTATE_SIZE + 1]{};
+			constexpr int len = 1024;
+			SQLCHAR message[len]{};
+			SQLINTEGER native_error = 0;
+			SQLGetDiagRec(SQL_HANDLE_STMT, stmt_, 1, sql_state, &native_error, message, len, &msg_len);
+			return unexpected(db_error((int)native_error, (char*)sql_state, where, (char*)message));
+		}
+
+		static std::string sqlserver_error(SQLHANDLE handle, SQLSMALLINT type) {
 			SQLSMALLINT msg_len = 0;
 			SQLCHAR sql_state[SQL_SQLSTATE_SIZE + 1]{};
 			constexpr int len = 1024;
@@ -307,6 +1015,92 @@ namespace sqlcpp::sqlserver {
 			}
 		}
 
+		//one column of parameter arrays, values of all rows are put together
+		template<typename T, typename Getter>
+		void bind_param_column(SQLUSMALLINT index, param_column& col, const std::vector<T>& rows, Getter&& get) {
+			using M = std::decay_t<decltype(get(rows[0]))>;
+			constexpr bool nullable = is_optional_v<M>;
+			using U = typename return_if<nullable, M, std::optional<M>>::type::value_type;
+			auto is_null = [](const M& m) {
+				if constexpr (nullable) {
+					return !m.has_value();
+				}
+				else {
+					return false;
+				}
+			};
+			auto value_of = [](const M& m) -> const U& {
+				if constexpr (nullable) {
+					return *m;
+				}
+				else {
+					return m;
+				}
+			};
+
+			col.ind.resize(rows.size());
+			if constexpr (is_char_pointer_v<U> || is_char_array_v<U> || std::is_convertible_v<U, std::string> || std::is_same_v<U, std::string_view>) {
+				size_t width = 1;
+				for (const auto& row : rows) {
+					if (!is_null(get(row))) {
+						width = (std::max)(width, std::string_view(value_of(get(row))).length());
+					}
+				}
+				col.data.assign(rows.size() * width, 0);
+				for (size_t i = 0; i < rows.size(); i++) {
+					const auto& m = get(rows[i]);
+					if (is_null(m)) {
+						col.ind[i] = SQL_NULL_DATA;
+						continue;
+					}
+					std::string_view str(value_of(m));
+					std::memcpy(&col.data[i * width], str.data(), str.length());
+					col.ind[i] = (SQLLEN)str.length();
+				}
+				auto retcode = SQLBindParameter(stmt_, index, SQL_PARAM_INPUT, (SQLSMALLINT)sqlserver_type_map(std::string{}).first,
+					(SQLSMALLINT)sqlserver_type_map(std::string{}).second, width, 0, col.data.data(), (SQLLEN)width, col.ind.data());
+				if (retcode != SQL_SUCCESS) {
+					throw except::sqlserver_exception("SQLBindParameter error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+				}
+			}
+			else if constexpr (std::is_arithmetic_v<U> || std::is_same_v<U, sqlserver_date> || std::is_same_v<U, sqlserver_datetime>) {
+				auto bytes = [](const U& v) -> const void* {
+					if constexpr (std::is_arithmetic_v<U>) {
+						return &v;
+					}
+					else {
+						return &v.value;
+					}
+				};
+				constexpr size_t width = []() {
+					if constexpr (std::is_arithmetic_v<U>) {
+						return sizeof(U);
+					}
+					else {
+						return sizeof(U::value);
+					}
+				}();
+				col.data.assign(rows.size() * width, 0);
+				for (size_t i = 0; i < rows.size(); i++) {
+					const auto& m = get(rows[i]);
+					if (is_null(m)) {
+						col.ind[i] = SQL_NULL_DATA;
+						continue;
+					}
+					std::memcpy(&col.data[i * width], bytes(value_of(m)), width);
+					col.ind[i] = 0;
+				}
+				auto retcode = SQLBindParameter(stmt_, index, SQL_PARAM_INPUT, (SQLSMALLINT)sqlserver_type_map(U{}).first,
+					(SQLSMALLINT)sqlserver_type_map(U{}).second, 0, 0, col.data.data(), (SQLLEN)width, col.ind.data());
+				if (retcode != SQL_SUCCESS) {
+					throw except::sqlserver_exception("SQLBindParameter error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+				}
+			}
+			else {
+				static_assert(always_false_v<U>, "type do not match");
+			}
+		}
+
 		template <typename T>
 		constexpr std::enable_if_t<!is_optional_v<std::decay_t<T>>> build_bind_param(SQLUSMALLINT index, T&& t) {
 			using U = std::remove_cv_t<std::remove_reference_t<decltype(t)>>;
@@ -421,26 +1215,57 @@ namespace sqlcpp::sqlserver {
 			}
 		}
 
+		//element type of a result column
+		template<typename T>
+		using column_value_t = typename return_if<is_optional_v<T>, T, std::optional<T>>::type::value_type;
+
+		template<typename T>
+		static constexpr bool is_string_column_v = std::is_same_v<column_value_t<T>, std::string>;
+
+		// call f(index, element) for every column element of a result row
+		template<size_t ElementSize, typename ReturnType, typename F>
+		static void for_each_element(ReturnType& r, F&& f) {
+			if constexpr (is_tuple_v<ReturnType>) {
+				for_each_tuple([&r, &f](auto index) {
+					f(index, std::get<index>(r));
+				}, std::make_index_sequence<ElementSize>());
+			}
+			else if constexpr (reflection::is_reflection_v<ReturnType>) {
+				constexpr auto address = ReturnType::elements_address();
+				for_each_tuple([&r, &f, &address](auto index) {
+					f(index, r.*std::get<index>(address));
+				}, std::make_index_sequence<ElementSize>());
+			}
+			else { //single type
+				f(std::integral_constant<size_t, 0>(), r);
+			}
+		}
+
+		// bytes of one value in the column array, string width comes from SQLDescribeCol. 0 for (max) columns
 		template <typename T>
-		std::enable_if_t<!is_optional_v<std::decay_t<T>>>
-			build_result_param(SQLUSMALLINT index, std::vector<std::pair<std::vector<char>, int>>& buf, T&& t, SQLLEN& ind) {
-			using U = std::decay_t<T>;
+		SQLLEN result_column_width(SQLUSMALLINT index) {
+			using U = column_value_t<T>;
 			if constexpr (std::is_arithmetic_v<U>) { //built-in types
-				auto retcode = SQLBindCol(stmt_, index, (SQLSMALLINT)sqlserver_type_map(t).first, &t, sizeof(U), &ind);
-				if (retcode != SQL_SUCCESS) {
-					throw except::sqlserver_exception("SQLBindCol error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
-				}
+				return (SQLLEN)sizeof(U);
 			}
 			else if constexpr (is_char_pointer_v<U> || is_char_array_v<U>) {
 				static_assert(always_false_v<U>, "use std::string instead of char pointer or char array");
 			}
-			else if constexpr (std::is_convertible_v<U, std::string>) {
-				std::vector<char> tmp(65536, 0);
-				buf.emplace_back(std::move(tmp), -1); //(SQLLEN*)&(buf.back().second)
-				auto retcode = SQLBindCol(stmt_, index, (SQLSMALLINT)sqlserver_type_map(t).first, &(buf.back().first[0]), 65536, &ind);
-				if (retcode != SQL_SUCCESS) {
-					throw except::sqlserver_exception("SQLBindCol error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+			else if constexpr (is_string_column_v<T>) {
+				SQLSMALLINT data_type = 0;
+				SQLULEN column_size = 0;
+				SQLSMALLINT decimal_digits = 0;
+				SQLSMALLINT nullable = 0;
+				auto retcode = SQLDescribeCol(stmt_, index, nullptr, 0, nullptr, &data_type, &column_size, &decimal_digits, &nullable);
+				if (retcode != SQL_SUCCESS && retcode != SQL_SUCCESS_WITH_INFO) {
+					throw except::sqlserver_exception("SQLDescribeCol error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+				}
+				//(max) columns report 0 or a huge size, 0 width means not bound
+				if (column_size == 0 || column_size > max_bound_column_size) {
+					return 0;
 				}
+				//a character may become 4 bytes after converted to client charset, and sign/point of numbers
+				return (SQLLEN)(column_size * 4 + 3);
 			}
 			else {
 				static_assert(always_false_v<U>, "type do not match");
@@ -448,62 +1273,207 @@ namespace sqlcpp::sqlserver {
 		}
 
 		template <typename T>
-		std::enable_if_t<is_optional_v<std::decay_t<T>>>
-			build_result_param(SQLUSMALLINT index, std::vector<std::pair<std::vector<char>, int>>& buf, T&& t, SQLLEN& ind) {
-			using U = typename std::decay_t<T>::value_type;
-			if constexpr (std::is_arithmetic_v<U>) { //built-in types
-				t.emplace(U{});
-				auto retcode = SQLBindCol(stmt_, index, (SQLSMALLINT)sqlserver_type_map(U{}).first, &t.value(), sizeof(U), &ind);
-				if (retcode != SQL_SUCCESS) {
-					throw except::sqlserver_exception("SQLBindCol error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+		void build_result_column(SQLUSMALLINT index, result_column& col, SQLULEN rows) {
+			using U = column_value_t<T>;
+			col.data.resize((size_t)(rows * col.width));
+			col.ind.resize((size_t)rows);
+			SQLSMALLINT c_type = 0;
+			if constexpr (is_string_column_v<T>) {
+				c_type = (SQLSMALLINT)sqlserver_type_map(std::string{}).first;
+			}
+			else {
+				c_type = (SQLSMALLINT)sqlserver_type_map(U{}).first;
+			}
+			auto retcode = SQLBindCol(stmt_, index, c_type, col.data.data(), col.width, col.ind.data());
+			if (retcode != SQL_SUCCESS) {
+				throw except::sqlserver_exception("SQLBindCol error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+			}
+		}
+
+		template<typename Element>
+		void assign_result(const result_column& col, size_t row, Element& e) {
+			using T = std::decay_t<Element>;
+			using U = column_value_t<T>;
+			auto ind = col.ind[row];
+			if (ind == SQL_NULL_DATA) { //table filed is null, use empty optional or default value
+				e = T{};
+				return;
+			}
+
+			const char* p = col.data.data() + row * col.width;
+			if constexpr (std::is_arithmetic_v<U>) {
+				U v;
+				std::memcpy(&v, p, sizeof(U));
+				e = v;
+			}
+			else { //std::string, the buffer has a null terminator
+				auto length = (ind == SQL_NO_TOTAL || ind > col.width - 1) ? col.width - 1 : ind;
+				e = std::string(p, (size_t)length);
+			}
+		}
+
+
+		// read an unbound column of the current row
+		template<typename Element>
+		void get_data(SQLUSMALLINT index, Element& e) {
+			using T = std::decay_t<Element>;
+			using U = column_value_t<T>;
+			if constexpr (std::is_arithmetic_v<U>) {
+				U v{};
+				SQLLEN ind = 0;
+				auto retcode = SQLGetData(stmt_, index, (SQLSMALLINT)sqlserver_type_map(U{}).first, &v, sizeof(U), &ind);
+				if (retcode != SQL_SUCCESS && retcode != SQL_SUCCESS_WITH_INFO) {
+					auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
+					throw except::sqlserver_exception("SQLGetData error:" + sqlserver_error(stmt_, SQL_HANDLE_STMT), error_code);
+				}
+				if (ind == SQL_NULL_DATA) {
+					e = T{};
+				}
+				else {
+					e = v;
 				}
 			}
-			else if constexpr (is_char_pointer_v<U> || is_char_array_v<U>) {
-				static_assert(always_false_v<U>, "use std::string instead of char pointer or char array");
+			else { //std::string
+				std::string v;
+				auto has_value = get_data_chunks(index, SQL_C_CHAR, [&v](std::string_view chunk, bool) {
+					v.append(chunk);
+				});
+				if (has_value) {
+					e = std::move(v);
+				}
+				else {
+					e = T{};
+				}
+			}
+		}
+
+		// read a value of the current row chunk by chunk, f(chunk, is_last) for every chunk. false if the value is null
+		template<typename F>
+		bool get_data_chunks(SQLUSMALLINT index, SQLSMALLINT c_type, F&& f) {
+			if (chunk_buf_.empty()) {
+				chunk_buf_.resize(get_data_chunk_size);
+			}
+			const SQLLEN capacity = (SQLLEN)chunk_buf_.size() - (c_type == SQL_C_CHAR ? 1 : 0); //char data has a null terminator
+			for (;;) {
+				SQLLEN ind = 0;
+				auto retcode = SQLGetData(stmt_, index, c_type, chunk_buf_.data(), (SQLLEN)chunk_buf_.size(), &ind);
+				if (retcode == SQL_NO_DATA) { //all chunks have been read
+					return true;
+				}
+				else if (retcode != SQL_SUCCESS && retcode != SQL_SUCCESS_WITH_INFO) {
+					auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
+					throw except::sqlserver_exception("SQLGetData error:" + sqlserver_error(stmt_, SQL_HANDLE_STMT), error_code);
+				}
+				if (ind == SQL_NULL_DATA) {
+					return false;
+				}
+
+				//ind is the length left before this call, or SQL_NO_TOTAL
+				bool is_last = retcode == SQL_SUCCESS || (ind != SQL_NO_TOTAL && ind <= capacity);
+				f(std::string_view(chunk_buf_.data(), (size_t)(is_last ? ind : capacity)), is_last);
+				if (is_last) {
+					return true;
+				}
+			}
+		}
+
+		// check SQLExecute result, then fetch results by block cursor
+		template<typename ReturnType>
+		query_result_t<ReturnType> finish_execute(SQLRETURN retcode) {
+			if (retcode == SQL_NO_DATA) {
+				;
 			}
-			else if constexpr (std::is_convertible_v<U, std::string>) {
-				std::vector<char> tmp(65536, 0);
-				buf.emplace_back(std::move(tmp), -1); //(SQLLEN*)&(buf.back().second)
-				auto retcode = SQLBindCol(stmt_, index, (SQLSMALLINT)sqlserver_type_map(U{}).first, &(buf.back().first[0]), 65536, &ind);
+			else if (retcode != SQL_SUCCESS) {
+				auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
+				auto error_msg = std::string("failed to SQLExecute : ") + sqlserver_error(stmt_, SQL_HANDLE_STMT);
+				throw except::sqlserver_exception(std::move(error_msg), error_code);
+			}
+			scope_guard sg([this]() {
+				auto retcode = SQLFreeStmt(stmt_, SQL_CLOSE);
 				if (retcode != SQL_SUCCESS) {
-					throw except::sqlserver_exception("SQLBindCol error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+					is_health_ = false;
+					throw except::sqlserver_exception("SQLFreeStmt error:" + sqlserver_error(stmt_, SQL_HANDLE_STMT));
 				}
+			});
+
+			if constexpr (std::is_same_v<ReturnType, void>) {
+				return;
+			}
+			else if constexpr (is_tuple_v<ReturnType>) {
+				return after_execute<std::tuple_size_v<ReturnType>, ReturnType>();
+			}
+			else if constexpr (reflection::is_reflection_v<ReturnType>) {
+				return after_execute<ReturnType::args_size_t::value, ReturnType>();
 			}
 			else {
-				static_assert(always_false_v<U>, "type do not match");
+				return after_execute<1, ReturnType>();
 			}
 		}
 
-		template<typename ReturnType, typename... Args>
-		void before_execute(std::string_view statement_sql, Args&&...args) {
-			//prepare
-			auto retcode = SQLPrepare(stmt_, (SQLCHAR*)statement_sql.data(), SQL_NTS);
-			if (retcode != SQL_SUCCESS) {
-				is_health_ = false;
-				auto error_msg = std::string("Failed to SQLPrepare sql<") + std::string(statement_sql) + ">: "
-					+ sqlserver_error(stmt_, SQL_HANDLE_STMT);
-				throw except::sqlserver_exception(std::move(error_msg));
+		// column count of the executed result, the cached count is updated when the shape changed under the same sql
+		SQLSMALLINT result_columns() {
+			SQLSMALLINT column_count = 0;
+			auto retcode = SQLNumResultCols(stmt_, &column_count);
+			if (retcode != SQL_SUCCESS && retcode != SQL_SUCCESS_WITH_INFO) {
+				throw except::sqlserver_exception("SQLNumResultCols error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
 			}
+			prepared_->column_count = column_count;
+			return column_count;
+		}
 
-			//check input size match
-			SQLSMALLINT placeholder_size = 0;
-			retcode = SQLNumParams(stmt_, &placeholder_size);
-			if (retcode != SQL_SUCCESS) {
-				throw except::sqlserver_exception("SQLNumParams error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+		// member to result column mapping of the executed statement, column names come from SQLDescribeCol.
+		// cached while the names stay the same
+		template<typename ReturnType>
+		const std::vector<SQLUSMALLINT>& mapped_columns() {
+			auto column_count = result_columns();
+			std::vector<std::string> names((size_t)column_count);
+			for (SQLSMALLINT i = 0; i < column_count; i++) {
+				SQLCHAR name[256]{};
+				SQLSMALLINT name_length = 0;
+				SQLSMALLINT data_type = 0;
+				SQLULEN column_size = 0;
+				SQLSMALLINT decimal_digits = 0;
+				SQLSMALLINT nullable = 0;
+				auto retcode = SQLDescribeCol(stmt_, (SQLUSMALLINT)(i + 1), name, (SQLSMALLINT)sizeof(name), &name_length,
+					&data_type, &column_size, &decimal_digits, &nullable);
+				if (retcode != SQL_SUCCESS && retcode != SQL_SUCCESS_WITH_INFO) {
+					throw except::sqlserver_exception("SQLDescribeCol error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+				}
+				names[(size_t)i].assign((const char*)name, (std::min)((size_t)name_length, sizeof(name) - 1));
 			}
-			constexpr auto args_size = sizeof...(args);
-			if (placeholder_size != args_size) {
-				throw except::sqlserver_exception("param size do not match placeholder size");
+			if (prepared_->mapped_type != nullptr && *prepared_->mapped_type == typeid(ReturnType) && prepared_->mapped_names == names) {
+				return prepared_->column_map;
 			}
 
-			//check output size match
-			if constexpr (!std::is_same_v<ReturnType, void>) { //tuple or reflect struct
-				SQLSMALLINT column_count = 0;
-				retcode = SQLNumResultCols(stmt_, &column_count);
-				if (retcode != SQL_SUCCESS) {
-					throw except::sqlserver_exception("SQLNumResultCols error: " + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+			prepared_->column_map = sql::map_columns<ReturnType, SQLUSMALLINT>(names); //renamed or reordered columns are mapped again
+			prepared_->mapped_type = &typeid(ReturnType);
+			prepared_->mapped_names = std::move(names);
+			return prepared_->column_map;
+		}
+
+		template<typename ReturnType, bool ByName = false, typename... Args>
+		void before_execute(std::string_view statement_sql, Args&&...args) {
+			prepare_or_throw(statement_sql);
+			check_and_bind<ReturnType, ByName>(std::forward<Args>(args)...);
+			recorder_.mark(trace::phase::bind);
+		}
+
+		// ByName: columns are mapped by name later, the count is not checked
+		template<typename ReturnType, bool ByName = false, bool ParamsChecked = false, typename... Args>
+		void check_and_bind(Args&&...args) {
+
+			//check input size match, counts are cached with the prepared statement. fixed string sql is checked at compile time
+			constexpr auto args_size = param_size_v<Args...>; //members of one tuple or reflect struct arg count
+			if constexpr (!ParamsChecked) {
+				SQLSMALLINT placeholder_size = prepared_->param_count;
+				if (placeholder_size != args_size) {
+					throw except::sqlserver_exception("param size do not match placeholder size");
 				}
+			}
 
+			//check output size match
+			if constexpr (!std::is_same_v<ReturnType, void> && !ByName) { //tuple or reflect struct
+				SQLSMALLINT column_count = prepared_->column_count;
 				if constexpr (is_tuple_v<ReturnType>) {
 					if (column_count != std::tuple_size_v<ReturnType>) {
 						throw except::sqlserver_exception("columns in the query do not match tuple element size");
@@ -523,90 +1493,106 @@ namespace sqlcpp::sqlserver {
 
 			//bind
 			if constexpr (args_size > 0) {
-				auto param_tup = std::forward_as_tuple(std::forward<Args>(args)...);
+				auto param_tup = param_refs(std::forward<Args>(args)...);
 				for_each_tuple([&param_tup, this](auto index) {
 					this->build_bind_param((SQLUSMALLINT)(index + 1), std::get<index>(param_tup));
 				}, std::make_index_sequence<args_size>());
 			}
 		}
 
-		template<typename Element, typename BufIter>
-		void assign_result(SQLLEN ind, Element&& e, BufIter&& iter) {
-			using T = std::decay_t<Element>;
-			if constexpr (is_optional_v<T>) {
-				if constexpr (std::is_arithmetic_v<typename T::value_type>) {
-					if (ind == SQL_NULL_DATA) { //table filed is null, use empty optional instead of default value optional
-						T temp{};
-						e.swap(temp);
-					}
-				}
-				else { //std::optional<std::string>
-					if (ind != SQL_NULL_DATA) {
-						e = std::string(iter->first.data(), (size_t)ind);
-					}
-					iter++;
+		// column_map gives the result column index of every element, null means by position
+		template<size_t ElementSize, typename ReturnType>
+		auto after_execute(const SQLUSMALLINT* column_map = nullptr) {
+			auto column_of = [column_map](size_t index) {
+				return (SQLUSMALLINT)((column_map == nullptr ? index : column_map[index]) + 1);
+			};
+			//initialize column arrays, fetch many rows in one SQLFetch
+			std::array<result_column, ElementSize> columns;
+			ReturnType r{};
+			SQLLEN row_width = 0;
+			SQLUSMALLINT first_streamed = (std::numeric_limits<SQLUSMALLINT>::max)(); //columns from here are not bound, read by SQLGetData after fetch
+			for_each_element<ElementSize>(r, [&columns, &row_width, &first_streamed, &column_of, this](auto index, auto& e) {
+				columns[index].width = this->result_column_width<std::decay_t<decltype(e)>>(column_of(index));
+				row_width += columns[index].width;
+				if (columns[index].width == 0) {
+					first_streamed = (std::min)(first_streamed, column_of(index));
 				}
+			});
+			//SQLGetData works with one row a fetch, and only on columns after the last bound one, in column order
+			SQLULEN block_rows = 1;
+			std::vector<size_t> streamed;
+			if (first_streamed == (std::numeric_limits<SQLUSMALLINT>::max)()) {
+				block_rows = (std::max)((SQLULEN)1, (std::min)((SQLULEN)(fetch_buffer_size / row_width), max_fetch_rows));
 			}
 			else {
-				if constexpr (std::is_same_v<T, std::string>) {
-					if (ind != SQL_NULL_DATA) {
-						e = std::string(iter->first.data(), (size_t)ind);
+				for (size_t i = 0; i < ElementSize; i++) {
+					if (column_of(i) >= first_streamed) {
+						streamed.push_back(i);
 					}
-					iter++;
 				}
+				std::sort(streamed.begin(), streamed.end(), [&column_of](size_t a, size_t b) {
+					return column_of(a) < column_of(b);
+				});
 			}
-		}
+			for_each_element<ElementSize>(r, [&columns, block_rows, first_streamed, &column_of, this](auto index, auto& e) {
+				if (column_of(index) < first_streamed) {
+					this->build_result_column<std::decay_t<decltype(e)>>(column_of(index), columns[index], block_rows);
+				}
+			});
 
-		template<size_t ElementSize, typename ReturnType>
-		auto after_execute() {
-			//initialize results bind
-			std::vector<std::pair<std::vector<char>, int>> buf_keeper; buf_keeper.reserve(ElementSize);
-			std::array<SQLLEN, ElementSize> ind;
-			ReturnType r{};
-			if constexpr (is_tuple_v<ReturnType>) {
-				for_each_tuple([&r, &buf_keeper, &ind, this](auto index) {
-					this->build_result_param((SQLUSMALLINT)(index + 1), buf_keeper, std::get<index>(r), ind[index]);
-				}, std::make_index_sequence<ElementSize>());
-			}
-			else if constexpr (reflection::is_reflection_v<ReturnType>) { //reflect
-				constexpr auto address = ReturnType::elements_address();
-				for_each_tuple([&r, &buf_keeper, &address, &ind, this](auto index) {
-					this->build_result_param((SQLUSMALLINT)(index + 1), buf_keeper, r.*std::get<index>(address), ind[index]);
-				}, std::make_index_sequence<ElementSize>());
-			}
-			else { //single type
-				this->build_result_param(1, buf_keeper, r, ind[0]);
+			SQLULEN fetched = 0;
+			std::vector<SQLUSMALLINT> row_status((size_t)block_rows);
+			scope_guard sg([this]() {
+				SQLSetStmtAttr(stmt_, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)1, 0);
+				SQLSetStmtAttr(stmt_, SQL_ATTR_ROWS_FETCHED_PTR, nullptr, 0);
+				SQLSetStmtAttr(stmt_, SQL_ATTR_ROW_STATUS_PTR, nullptr, 0);
+				SQLFreeStmt(stmt_, SQL_UNBIND);
+			});
+			SQLSetStmtAttr(stmt_, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER)SQL_BIND_BY_COLUMN, 0);
+			SQLSetStmtAttr(stmt_, SQL_ATTR_ROWS_FETCHED_PTR, &fetched, 0);
+			SQLSetStmtAttr(stmt_, SQL_ATTR_ROW_STATUS_PTR, row_status.data(), 0);
+			auto retcode = SQLSetStmtAttr(stmt_, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)block_rows, 0);
+			if (retcode != SQL_SUCCESS && retcode != SQL_SUCCESS_WITH_INFO) {
+				throw except::sqlserver_exception("SQLSetStmtAttr(row array size) error:" + sqlserver_error(stmt_, SQL_HANDLE_STMT));
 			}
 
 			//get back data
 			std::vector<ReturnType> back_data{};
 			for (;;) {
-				auto retcode = SQLFetch(stmt_);
+				retcode = SQLFetch(stmt_);
 				if (retcode == SQL_NO_DATA) { //no data now
 					break;
 				}
 				else if (retcode == SQL_ERROR) {
-					is_health_ = false;
-					throw except::sqlserver_exception("SQLFetch error:" + sqlserver_error(stmt_, SQL_HANDLE_STMT));
+					auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
+					throw except::sqlserver_exception("SQLFetch error:" + sqlserver_error(stmt_, SQL_HANDLE_STMT), error_code);
 				}
 
-				auto iter = buf_keeper.begin();
-				if constexpr (is_tuple_v<ReturnType>) {
-					for_each_tuple([&r, &iter, &ind, this](auto index) {
-						this->assign_result(ind[index], std::get<index>(r), iter);
-					}, std::make_index_sequence<ElementSize>());
-				}
-				else if constexpr (reflection::is_reflection_v<ReturnType>) {
-					constexpr auto address = ReturnType::elements_address();
-					for_each_tuple([&r, &iter, &address, &ind, this](auto index) {
-						this->assign_result(ind[index], r.*std::get<index>(address), iter);
-					}, std::make_index_sequence<ElementSize>());
-				}
-				else { //single type
-					this->assign_result(ind[0], r, iter);
+				for (size_t row = 0; row < (size_t)fetched; row++) {
+					if (row_status[row] == SQL_ROW_NOROW) {
+						continue;
+					}
+					if (row_status[row] == SQL_ROW_ERROR) { //like a conversion failed in this row
+						auto error_code = check_health(stmt_, SQL_HANDLE_STMT);
+						throw except::sqlserver_exception("SQLFetch row error:" + sqlserver_error(stmt_, SQL_HANDLE_STMT), error_code);
+					}
+					for_each_element<ElementSize>(r, [&columns, row, first_streamed, &column_of, this](auto index, auto& e) {
+						if (column_of(index) < first_streamed) {
+							this->assign_result(columns[index], row, e);
+						}
+					});
+					for (auto i : streamed) {
+						for_each_element<ElementSize>(r, [i, &column_of, this](auto index, auto& e) {
+							if (index == i) {
+								this->get_data(column_of(index), e);
+							}
+						});
+					}
+					back_data.emplace_back(std::move(r));
 				}
-				back_data.emplace_back(std::move(r));
 			}
+			recorder_.mark(trace::phase::fetch);
+			recorder_.rows(back_data);
 			return back_data;
 		}
 	};
@@ -0,0 +1,203 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <optional>
+#include <algorithm>
+#include <condition_variable>
+#include "db_meta.hpp"
+#include "db_common.h"
+#include "logger.hpp"
+#include "sqlserver_connection.hpp"
+
+namespace sqlcpp::sqlserver {
+	//where cluster members come from, a local stand-in can replace it for tests
+	class replica_discovery {
+	public:
+		virtual ~replica_discovery() = default;
+		// online members, role is PRIMARY or SECONDARY(readable). empty when failed
+		virtual std::vector<node_info> discover() = 0;
+	};
+
+	//availability group replica states, queried from the primary
+	class ag_discovery :public replica_discovery {
+	private:
+		std::vector<node_info> seed_nodes_;
+		size_t seed_index_ = 0;
+		std::string user_;
+		std::string passwd_;
+		std::string driver_name_;
+		std::unique_ptr<connection> conn_;
+	public:
+		ag_discovery(std::vector<node_info> seed_nodes, std::string user, std::string passwd, std::string driver_name)
+			:seed_nodes_(std::move(seed_nodes)), user_(std::move(user)), passwd_(std::move(passwd)), driver_name_(std::move(driver_name))
+		{}
+
+		std::vector<node_info> discover() override {
+			//secondaries only see themselves, try seeds until the primary is found
+			for (size_t i = 0; i < seed_nodes_.size(); i++) {
+				try {
+					if (conn_ == nullptr) {
+						const auto& seed = seed_nodes_[seed_index_ % seed_nodes_.size()];
+						conn_ = std::make_unique<connection>(connection_options{ seed.ip, seed.port, user_, passwd_ }, driver_name_);
+					}
+					auto nodes = query_replicas();
+					auto has_primary = std::any_of(nodes.begin(), nodes.end(), [](const node_info& n) { return n.role == "PRIMARY"; });
+					if (has_primary) {
+						add_seeds(nodes);
+						return nodes;
+					}
+				}
+				catch (const std::exception& e) {
+					SQLCPP_LOG(warn, "sqlserver discover replicas error: %s", e.what());
+				}
+				conn_.reset();
+				seed_index_++;
+			}
+			return {};
+		}
+
+	private:
+		std::vector<node_info> query_replicas() {
+			//secondary_role_allow_connections: 1 read-intent only, 2 all
+			auto r = conn_->query<std::tuple<std::string, std::string, std::string>>(
+				"select distinct ar.replica_server_name, isnull(ar.read_only_routing_url, ''), ars.role_desc "
+				"from sys.dm_hadr_availability_replica_states ars "
+				"join sys.availability_replicas ar on ars.replica_id = ar.replica_id "
+				"where ars.connected_state = 1 and (ars.role = 1 or (ars.role = 2 and ar.secondary_role_allow_connections in (1, 2)))");
+			std::vector<node_info> nodes;
+			for (auto& [name, routing_url, role] : r) {
+				node_info node{ std::move(name), {}, std::move(role) };
+				//TCP://host:port, the address clients should use
+				if (auto pos = routing_url.find("://"); pos != std::string::npos) {
+					auto address = routing_url.substr(pos + 3);
+					auto colon = address.rfind(':');
+					node.ip = address.substr(0, colon);
+					if (colon != std::string::npos) {
+						node.port = address.substr(colon + 1);
+					}
+				}
+				nodes.emplace_back(std::move(node));
+			}
+			return nodes;
+		}
+
+		void add_seeds(const std::vector<node_info>& nodes) {
+			for (const auto& node : nodes) {
+				auto found = std::any_of(seed_nodes_.begin(), seed_nodes_.end(), [&node](const node_info& n) { return n.ip == node.ip; });
+				if (!found) {
+					seed_nodes_.emplace_back(node_info{ node.ip, node.port });
+				}
+			}
+		}
+	};
+
+	//refresh cluster members in background
+	class sentinel {
+	private:
+		std::unique_ptr<replica_discovery> discovery_;
+		std::chrono::milliseconds interval_;
+		std::vector<node_info> online_nodes_;
+		uint64_t version_ = 0; //increased when members changed
+		bool refresh_requested_ = false;
+		std::mutex mtx_;
+		std::condition_variable changed_cond_;
+		std::condition_variable sleep_cond_;
+		std::atomic<bool> run_ = true;
+		std::thread monitor_thread_;
+	public:
+		sentinel(const sentinel&) = delete;
+		sentinel& operator=(const sentinel&) = delete;
+
+		// the first discovery runs here, so the members are known when constructed
+		sentinel(std::unique_ptr<replica_discovery> discovery, std::chrono::milliseconds interval = std::chrono::milliseconds(3000))
+			:discovery_(std::move(discovery)), interval_(interval)
+		{
+			update(discover());
+			monitor_thread_ = std::thread(&sentinel::monitor, this);
+		}
+
+		~sentinel() {
+			stop();
+			if (monitor_thread_.joinable()) {
+				monitor_thread_.join();
+			}
+		}
+
+		// current members and their version
+		std::vector<node_info> get_nodes(uint64_t& version) {
+			std::lock_guard<std::mutex> lock(mtx_);
+			version = version_;
+			return online_nodes_;
+		}
+
+		// block until members are newer than version, empty when stopped
+		std::optional<std::vector<node_info>> wait_for_cluster_change(uint64_t& version) {
+			std::unique_lock<std::mutex> lock(mtx_);
+			changed_cond_.wait(lock, [this, version]() { return !run_ || version_ != version; });
+			if (!run_) {
+				return std::nullopt;
+			}
+			version = version_;
+			return online_nodes_;
+		}
+
+		// discover at once, like after a connection error
+		void refresh() {
+			std::lock_guard<std::mutex> lock(mtx_);
+			refresh_requested_ = true;
+			sleep_cond_.notify_one();
+		}
+
+		void stop() {
+			std::lock_guard<std::mutex> lock(mtx_);
+			run_ = false;
+			changed_cond_.notify_all();
+			sleep_cond_.notify_one();
+		}
+
+	private:
+		std::vector<node_info> discover() {
+			try {
+				auto nodes = discovery_->discover();
+				std::sort(nodes.begin(), nodes.end()); //for compare
+				return nodes;
+			}
+			catch (const std::exception& e) {
+				SQLCPP_LOG(warn, "sqlserver discover cluster error: %s", e.what());
+				return {};
+			}
+		}
+
+		void update(std::vector<node_info> nodes) {
+			if (nodes.empty()) { //keep the last known members
+				return;
+			}
+			std::lock_guard<std::mutex> lock(mtx_);
+			if (nodes != online_nodes_) {
+				online_nodes_ = std::move(nodes);
+				version_++;
+				changed_cond_.notify_all();
+			}
+		}
+
+		void monitor() {
+			while (run_) {
+				{
+					std::unique_lock<std::mutex> lock(mtx_);
+					sleep_cond_.wait_for(lock, interval_, [this]() { return !run_ || refresh_requested_; });
+					refresh_requested_ = false;
+				}
+				if (!run_) {
+					break;
+				}
+				update(discover());
+			}
+		}
+	};
+}
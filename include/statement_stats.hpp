@@ -0,0 +1,309 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include "trace.hpp"
+
+//client side pg_stat_statements: per statement counters and latency histograms, fed by trace events
+namespace sqlcpp::trace {
+	// log linear buckets like HDR histogram, 32 sub buckets per power of 2, about 1.6% error. values are microseconds
+	class latency_histogram {
+	private:
+		static constexpr uint32_t sub_bits = 5;
+		static constexpr uint64_t sub_count = uint64_t{ 1 } << sub_bits;
+
+		std::vector<uint64_t> counts_; //grows to the highest bucket seen
+		uint64_t count_ = 0;
+	public:
+		void record(uint64_t us) {
+			auto index = index_of(us);
+			if (index >= counts_.size()) {
+				counts_.resize(index + 1);
+			}
+			counts_[index]++;
+			count_++;
+		}
+
+		void merge(const latency_histogram& other) {
+			if (other.counts_.size() > counts_.size()) {
+				counts_.resize(other.counts_.size());
+			}
+			for (size_t i = 0; i < other.counts_.size(); i++) {
+				counts_[i] += other.counts_[i];
+			}
+			count_ += other.count_;
+		}
+
+		uint64_t count() const {
+			return count_;
+		}
+
+		// value at quantile q in [0, 1], middle of its bucket
+		std::chrono::microseconds percentile(double q) const {
+			if (count_ == 0) {
+				return std::chrono::microseconds(0);
+			}
+			auto rank = (uint64_t)(q * (double)count_ + 0.5);
+			rank = (std::max)(rank, (uint64_t)1);
+			uint64_t seen = 0;
+			for (size_t i = 0; i < counts_.size(); i++) {
+				seen += counts_[i];
+				if (seen >= rank) {
+					auto [low, high] = bounds_of(i);
+					return std::chrono::microseconds(low + (high - low) / 2);
+				}
+			}
+			return std::chrono::microseconds(bounds_of(counts_.size() - 1).second);
+		}
+	private:
+		static size_t index_of(uint64_t v) {
+			if (v < 2 * sub_count) {
+				return (size_t)v;
+			}
+			uint32_t msb = 63;
+			while ((v >> msb) == 0) {
+				msb--;
+			}
+			auto shift = msb - sub_bits;
+			return (size_t)((shift + 1) * sub_count + (v >> shift) - sub_count);
+		}
+
+		// [low, high] of values in bucket i
+		static std::pair<uint64_t, uint64_t> bounds_of(size_t i) {
+			if (i < 2 * sub_count) {
+				return { i, i };
+			}
+			auto shift = i / sub_count - 1;
+			auto low = (i % sub_count + sub_count) << shift;
+			return { low, low + (uint64_t{ 1 } << shift) - 1 };
+		}
+	};
+
+	struct statement_stats {
+		uint64_t fingerprint = 0;
+		std::string sql; //normalized, literal values as ?
+		uint64_t calls = 0;
+		uint64_t errors = 0;
+		uint64_t rows = 0;
+		uint64_t bytes = 0;
+		std::chrono::microseconds total_time{ 0 };
+		std::chrono::microseconds max_time{ 0 };
+		latency_histogram latency;
+
+		std::chrono::microseconds mean_time() const {
+			return calls == 0 ? std::chrono::microseconds(0) : total_time / (int64_t)calls;
+		}
+
+		std::chrono::microseconds p50() const {
+			return latency.percentile(0.5);
+		}
+
+		std::chrono::microseconds p99() const {
+			return latency.percentile(0.99);
+		}
+
+		std::chrono::microseconds p999() const {
+			return latency.percentile(0.999);
+		}
+	};
+
+	enum class order_by {
+		total_time,
+		mean_time,
+		p99,
+		calls,
+		errors,
+		rows,
+	};
+
+	// statements keyed by fingerprint. threads update their own shard, so queries on different threads do not contend.
+	// latency is the query time without waiting for the connection
+	class statement_registry :public observer {
+	private:
+		struct alignas(64) shard {
+			std::mutex mtx;
+			std::unordered_map<uint64_t, statement_stats> statements;
+		};
+
+		std::vector<std::unique_ptr<shard>> shards_;
+		size_t max_statements_;
+		std::atomic<uint64_t> dropped_ = 0;
+	public:
+		statement_registry(const statement_registry&) = delete;
+		statement_registry& operator=(const statement_registry&) = delete;
+
+		// new statements beyond max_statements per shard are only counted by dropped()
+		explicit statement_registry(size_t max_statements = 5000, size_t shard_count = 0)
+			:max_statements_(max_statements) {
+			if (shard_count == 0) {
+				shard_count = (std::max)(4u, std::thread::hardware_concurrency());
+			}
+			for (size_t i = 0; i < shard_count; i++) {
+				shards_.emplace_back(std::make_unique<shard>());
+			}
+		}
+
+		void on_query(const query_event& e) override {
+			auto elapsed = e.total() - e.duration(phase::acquire);
+			auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+
+			auto& s = local_shard();
+			std::lock_guard<std::mutex> lock(s.mtx);
+			auto iter = s.statements.find(e.fingerprint);
+			if (iter == s.statements.end()) {
+				if (s.statements.size() >= max_statements_) {
+					dropped_++;
+					return;
+				}
+				iter = s.statements.emplace(e.fingerprint, statement_stats{}).first;
+				iter->second.fingerprint = e.fingerprint;
+				iter->second.sql = sql::normalize(e.sql); //literals of the first caller are not shown for all of them
+			}
+			auto& st = iter->second;
+			st.calls++;
+			st.errors += e.failed ? 1 : 0;
+			st.rows += e.rows;
+			st.bytes += e.bytes;
+			st.total_time += us;
+			st.max_time = (std::max)(st.max_time, us);
+			st.latency.record((uint64_t)us.count());
+		}
+
+		// merged stats of all statements
+		std::vector<statement_stats> snapshot() const {
+			std::unordered_map<uint64_t, statement_stats> merged;
+			for (const auto& s : shards_) {
+				std::lock_guard<std::mutex> lock(s->mtx);
+				for (const auto& [fingerprint, st] : s->statements) {
+					auto [iter, inserted] = merged.try_emplace(fingerprint, st);
+					if (inserted) {
+						continue;
+					}
+					auto& m = iter->second;
+					m.calls += st.calls;
+					m.errors += st.errors;
+					m.rows += st.rows;
+					m.bytes += st.bytes;
+					m.total_time += st.total_time;
+					m.max_time = (std::max)(m.max_time, st.max_time);
+					m.latency.merge(st.latency);
+				}
+			}
+			std::vector<statement_stats> result;
+			result.reserve(merged.size());
+			for (auto& [fingerprint, st] : merged) {
+				result.emplace_back(std::move(st));
+			}
+			return result;
+		}
+
+		// the n heaviest statements, like slow statement ranking by total time
+		std::vector<statement_stats> top(size_t n, order_by order = order_by::total_time) const {
+			auto stats = snapshot();
+			auto key = [order](const statement_stats& s) -> uint64_t {
+				switch (order) {
+				case order_by::mean_time: return (uint64_t)s.mean_time().count();
+				case order_by::p99: return (uint64_t)s.p99().count();
+				case order_by::calls: return s.calls;
+				case order_by::errors: return s.errors;
+				case order_by::rows: return s.rows;
+				default: return (uint64_t)s.total_time.count();
+				}
+			};
+			n = (std::min)(n, stats.size());
+			std::partial_sort(stats.begin(), stats.begin() + n, stats.end(), [&key](const auto& a, const auto& b) {
+				return key(a) > key(b);
+			});
+			stats.resize(n);
+			return stats;
+		}
+
+		// statements not recorded because the registry was full
+		uint64_t dropped() const {
+			return dropped_.load();
+		}
+
+		void reset() {
+			for (auto& s : shards_) {
+				std::lock_guard<std::mutex> lock(s->mtx);
+				s->statements.clear();
+			}
+			dropped_ = 0;
+		}
+
+		// one line per statement, heaviest first. times are microseconds
+		std::string to_text(size_t n = 20, order_by order = order_by::total_time) const {
+			std::string out = "calls errors total_us mean_us p50_us p99_us p999_us max_us rows bytes fingerprint sql\n";
+			char line[256];
+			for (const auto& s : top(n, order)) {
+				snprintf(line, sizeof(line), "%llu %llu %lld %lld %lld %lld %lld %lld %llu %llu %016llx ",
+					(unsigned long long)s.calls, (unsigned long long)s.errors, (long long)s.total_time.count(), (long long)s.mean_time().count(),
+					(long long)s.p50().count(), (long long)s.p99().count(), (long long)s.p999().count(), (long long)s.max_time.count(),
+					(unsigned long long)s.rows, (unsigned long long)s.bytes, (unsigned long long)s.fingerprint);
+				out += line;
+				out += s.sql;
+				out += '\n';
+			}
+			return out;
+		}
+
+		// json array of statements, heaviest first. times are microseconds
+		std::string to_json(size_t n = (size_t)-1, order_by order = order_by::total_time) const {
+			std::string out = "[";
+			char fields[320];
+			for (const auto& s : top(n, order)) {
+				if (out.size() > 1) {
+					out += ',';
+				}
+				snprintf(fields, sizeof(fields), "{\"fingerprint\":\"%016llx\",\"calls\":%llu,\"errors\":%llu,\"rows\":%llu,\"bytes\":%llu,"
+					"\"total_us\":%lld,\"mean_us\":%lld,\"p50_us\":%lld,\"p99_us\":%lld,\"p999_us\":%lld,\"max_us\":%lld,\"sql\":",
+					(unsigned long long)s.fingerprint, (unsigned long long)s.calls, (unsigned long long)s.errors, (unsigned long long)s.rows,
+					(unsigned long long)s.bytes, (long long)s.total_time.count(), (long long)s.mean_time().count(), (long long)s.p50().count(),
+					(long long)s.p99().count(), (long long)s.p999().count(), (long long)s.max_time.count());
+				out += fields;
+				append_json_string(out, s.sql);
+				out += '}';
+			}
+			out += ']';
+			return out;
+		}
+	private:
+		shard& local_shard() {
+			static std::atomic<size_t> next_thread = 0;
+			thread_local size_t thread_index = next_thread++;
+			return *shards_[thread_index % shards_.size()];
+		}
+
+		static void append_json_string(std::string& out, std::string_view s) {
+			out += '"';
+			for (char c : s) {
+				switch (c) {
+				case '"': out += "\\\""; break;
+				case '\\': out += "\\\\"; break;
+				case '\n': out += "\\n"; break;
+				case '\r': out += "\\r"; break;
+				case '\t': out += "\\t"; break;
+				default:
+					if ((unsigned char)c < 0x20) {
+						char escaped[8];
+						snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+						out += escaped;
+					}
+					else {
+						out += c;
+					}
+				}
+			}
+			out += '"';
+		}
+	};
+}
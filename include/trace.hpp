@@ -0,0 +1,368 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <array>
+#include <chrono>
+#include <random>
+#include <utility>
+#include <exception>
+#include <functional>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+#include "db_meta.hpp"
+#include "reflection.hpp"
+#include "reflect_sql.hpp"
+
+//per query events with phase timing. define SQLCPP_TRACE to record them, otherwise recorder is empty and every hook is a no-op
+namespace sqlcpp::trace {
+	using clock = std::chrono::steady_clock;
+
+	enum class phase : uint8_t {
+		acquire, //waiting in get_connection, given to the first query of a checkout
+		prepare,
+		bind, //param binding and result metadata checks
+		execute,
+		store, //mysql_stmt_store_result and result binding, mysql only
+		fetch, //fetch and decode
+	};
+	inline constexpr size_t phase_count = 6;
+	inline constexpr std::array<std::string_view, phase_count> phase_names{ "acquire", "prepare", "bind", "execute", "store", "fetch" };
+
+	struct query_event {
+		std::string_view backend; //mysql or sqlserver
+		std::string_view node;
+		std::string_view sql;
+		uint64_t fingerprint = 0; //sql::fingerprint, same for queries differing only in literal values
+		std::chrono::system_clock::time_point start{};
+		std::array<std::chrono::nanoseconds, phase_count> phases{};
+		uint64_t rows = 0; //rows back, or rows sent by batches
+		uint64_t bytes = 0; //bytes of decoded values, strings by length
+		bool failed = false;
+		int error_code = 0; //native error
+
+		std::chrono::nanoseconds duration(phase p) const {
+			return phases[(size_t)p];
+		}
+
+		std::chrono::nanoseconds total() const {
+			std::chrono::nanoseconds sum{ 0 };
+			for (auto d : phases) {
+				sum += d;
+			}
+			return sum;
+		}
+	};
+
+	struct acquire_event {
+		std::string_view backend;
+		std::string_view node;
+		std::chrono::nanoseconds wait{ 0 };
+	};
+
+	// called on the thread running the query, keep it cheap or hand events to another thread. must not throw
+	class observer {
+	public:
+		virtual ~observer() = default;
+		virtual void on_query(const query_event& e) = 0;
+		virtual void on_acquire(const acquire_event&) {}
+	};
+
+	// hands events to every observer, like statement stats and spans together
+	class fanout :public observer {
+	private:
+		std::vector<std::shared_ptr<observer>> observers_;
+	public:
+		explicit fanout(std::vector<std::shared_ptr<observer>> observers) :observers_(std::move(observers)) {}
+
+		void on_query(const query_event& e) override {
+			for (auto& o : observers_) {
+				o->on_query(e);
+			}
+		}
+
+		void on_acquire(const acquire_event& e) override {
+			for (auto& o : observers_) {
+				o->on_acquire(e);
+			}
+		}
+	};
+
+	namespace detail {
+		template<typename T, typename = void>
+		struct has_content :std::false_type {};
+
+		template<typename T>
+		struct has_content<T, std::void_t<decltype(std::declval<T>().content.size())>> :std::true_type {};
+
+		template<typename T>
+		uint64_t value_bytes(const T& v) {
+			if constexpr (is_optional_v<T>) {
+				return v ? value_bytes(*v) : 0;
+			}
+			else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+				return std::string_view(v).size();
+			}
+			else if constexpr (has_content<T>::value) { //mysql_mediumtext
+				return v.content.size();
+			}
+			else {
+				return sizeof(T);
+			}
+		}
+
+		template<typename T>
+		uint64_t row_bytes(const T& row) {
+			if constexpr (is_tuple_v<T>) {
+				return std::apply([](const auto&... e) { return (uint64_t{ 0 } + ... + value_bytes(e)); }, row);
+			}
+			else if constexpr (reflection::is_reflection_v<T>) {
+				constexpr auto address = T::elements_address();
+				return std::apply([&row](auto... member) { return (uint64_t{ 0 } + ... + value_bytes(row.*member)); }, address);
+			}
+			else {
+				return value_bytes(row);
+			}
+		}
+	}
+
+#ifdef SQLCPP_TRACE
+	// phase timing of the running query of one connection
+	class recorder {
+	private:
+		std::shared_ptr<observer> observer_; //held while the connection is checked out, set_observer may replace it meanwhile
+		std::string_view backend_;
+		std::string_view node_;
+		bool active_ = false;
+		query_event event_{};
+		clock::time_point last_{};
+		std::chrono::nanoseconds acquire_wait_{ 0 };
+		int uncaught_ = 0;
+	public:
+		// reports the query when it goes out of scope, also when it throws
+		class scope {
+		private:
+			recorder* r_;
+		public:
+			explicit scope(recorder* r) :r_(r) {}
+			scope(const scope&) = delete;
+			scope& operator=(const scope&) = delete;
+
+			// async queries keep it from start to finish
+			scope(scope&& other) noexcept :r_(std::exchange(other.r_, nullptr)) {}
+
+			~scope() {
+				if (r_ != nullptr) {
+					r_->finish();
+				}
+			}
+		};
+
+		explicit recorder(std::string_view backend) :backend_(backend) {}
+
+		void set_node(std::string_view node) {
+			node_ = node;
+		}
+
+		void set_observer(std::shared_ptr<observer> o) {
+			observer_ = std::move(o);
+		}
+
+		// nested starts, like query inside try_query, belong to the outer one
+		scope start(std::string_view sql) {
+			if (observer_ == nullptr || active_) {
+				return scope(nullptr);
+			}
+			active_ = true;
+			event_ = query_event{ backend_, node_, sql, sql::fingerprint(sql), std::chrono::system_clock::now() };
+			event_.phases[(size_t)phase::acquire] = std::exchange(acquire_wait_, std::chrono::nanoseconds(0));
+			uncaught_ = std::uncaught_exceptions();
+			last_ = clock::now();
+			return scope(this);
+		}
+
+		// time since the last mark goes to p
+		void mark(phase p) {
+			if (active_) {
+				auto now = clock::now();
+				event_.phases[(size_t)p] += now - last_;
+				last_ = now;
+			}
+		}
+
+		void error(int code) {
+			if (active_) {
+				event_.error_code = code;
+			}
+		}
+
+		template<typename T>
+		void rows(const std::vector<T>& r) {
+			if (active_) {
+				event_.rows = r.size();
+				for (const auto& row : r) {
+					event_.bytes += detail::row_bytes(row);
+				}
+			}
+		}
+
+		void rows(uint64_t count) {
+			if (active_) {
+				event_.rows = count;
+			}
+		}
+
+		// the connection is checked out from a pool after waiting
+		void acquired(std::shared_ptr<observer> o, std::chrono::nanoseconds wait) {
+			observer_ = std::move(o);
+			if (observer_ != nullptr) {
+				acquire_wait_ = wait;
+				observer_->on_acquire({ backend_, node_, wait });
+			}
+		}
+	private:
+		void finish() {
+			active_ = false;
+			event_.failed = event_.error_code != 0 || std::uncaught_exceptions() > uncaught_;
+			if (observer_ != nullptr) { //an abandoned async query may end after the connection went back to the pool
+				observer_->on_query(event_);
+			}
+		}
+	};
+#else
+	class recorder {
+	public:
+		struct scope {
+			~scope() {}
+		};
+
+		explicit constexpr recorder(std::string_view) {}
+		void set_node(std::string_view) {}
+		scope start(std::string_view) { return {}; }
+		void mark(phase) {}
+		void error(int) {}
+		template<typename T>
+		void rows(const T&) {}
+		void acquired(const std::shared_ptr<observer>&, std::chrono::nanoseconds) {}
+	};
+#endif
+
+	// OpenTelemetry style span, hand it to an exporter. times are unix epoch nanoseconds, ids are lowercase hex
+	struct span {
+		std::string trace_id; //32 hex
+		std::string span_id; //16 hex
+		std::string parent_span_id; //empty for a root span
+		std::string name;
+		uint64_t start_unix_nano = 0;
+		uint64_t end_unix_nano = 0;
+		std::vector<std::pair<std::string, std::string>> attributes;
+		bool error = false;
+	};
+
+	// the span queries of this thread are children of, like the request being served. empty ids start a new trace
+	struct span_context {
+		std::string trace_id;
+		std::string span_id;
+	};
+
+	inline span_context& current_context() {
+		thread_local span_context context;
+		return context;
+	}
+
+	// a client span for every query with db.* attributes, and a child span for every phase taken
+	class span_observer :public observer {
+	public:
+		using sink = std::function<void(std::vector<span>&&)>;
+	private:
+		sink sink_;
+		bool phase_spans_ = true;
+	public:
+		explicit span_observer(sink s, bool phase_spans = true) :sink_(std::move(s)), phase_spans_(phase_spans) {}
+
+		void on_query(const query_event& e) override {
+			const auto& parent = current_context();
+			std::vector<span> spans;
+			spans.reserve(phase_spans_ ? phase_count + 1 : 1);
+			auto start = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(e.start.time_since_epoch()).count();
+			//acquire happened before the query started
+			start -= (uint64_t)e.duration(phase::acquire).count();
+
+			span& query = spans.emplace_back();
+			query.trace_id = parent.trace_id.empty() ? random_id(16) : parent.trace_id;
+			query.span_id = random_id(8);
+			query.parent_span_id = parent.span_id;
+			query.name = operation(e.sql);
+			query.start_unix_nano = start;
+			query.end_unix_nano = start + (uint64_t)e.total().count();
+			query.error = e.failed;
+			query.attributes = {
+				{ "db.system", e.backend == "sqlserver" ? "mssql" : std::string(e.backend) },
+				{ "db.statement", std::string(e.sql) },
+				{ "db.operation", query.name },
+				{ "server.address", std::string(e.node) },
+				{ "db.statement.fingerprint", hex(e.fingerprint, 8) },
+				{ "db.response.returned_rows", std::to_string(e.rows) },
+				{ "db.response.bytes", std::to_string(e.bytes) },
+			};
+			if (e.error_code != 0) {
+				query.attributes.emplace_back("error.type", std::to_string(e.error_code));
+			}
+
+			if (phase_spans_) {
+				auto phase_start = start;
+				for (size_t i = 0; i < phase_count; i++) {
+					auto d = (uint64_t)e.phases[i].count();
+					if (d == 0) {
+						continue;
+					}
+					span& child = spans.emplace_back();
+					child.trace_id = spans.front().trace_id;
+					child.span_id = random_id(8);
+					child.parent_span_id = spans.front().span_id;
+					child.name = std::string(phase_names[i]);
+					child.start_unix_nano = phase_start;
+					child.end_unix_nano = phase_start + d;
+					phase_start += d;
+				}
+			}
+			sink_(std::move(spans));
+		}
+	private:
+		static std::string hex(uint64_t v, size_t bytes) {
+			static constexpr char digits[] = "0123456789abcdef";
+			std::string s(bytes * 2, '0');
+			for (size_t i = s.size(); i > 0; i--, v >>= 4) {
+				s[i - 1] = digits[v & 0xf];
+			}
+			return s;
+		}
+
+		static std::string random_id(size_t bytes) {
+			thread_local std::mt19937_64 gen{ std::random_device{}() };
+			std::string id;
+			for (size_t i = 0; i < bytes; i += 8) {
+				id += hex(gen(), (std::min)((size_t)8, bytes - i));
+			}
+			return id;
+		}
+
+		// first word in upper case, like SELECT
+		static std::string operation(std::string_view sql) {
+			auto begin = sql.find_first_not_of(" \t\r\n(");
+			if (begin == std::string_view::npos) {
+				return "QUERY";
+			}
+			auto end = sql.find_first_of(" \t\r\n(", begin);
+			std::string op(sql.substr(begin, end == std::string_view::npos ? std::string_view::npos : end - begin));
+			for (auto& c : op) {
+				if (c >= 'a' && c <= 'z') {
+					c = c - 'a' + 'A';
+				}
+			}
+			return op;
+		}
+	};
+}
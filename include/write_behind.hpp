@@ -0,0 +1,283 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include "db_meta.hpp"
+#include "exception.hpp"
+#include "reflection.hpp"
+#include "reflect_sql.hpp"
+#include "logger.hpp"
+
+namespace sqlcpp {
+	//bounded lock-free queue, many producers and one consumer. see Dmitry Vyukov's bounded mpmc queue
+	template<typename T>
+	class mpsc_queue {
+	private:
+		struct cell {
+			std::atomic<size_t> sequence;
+			T data;
+		};
+
+		std::unique_ptr<cell[]> buffer_;
+		size_t mask_;
+		alignas(64) std::atomic<size_t> enqueue_pos_ = 0;
+		alignas(64) std::atomic<size_t> dequeue_pos_ = 0;
+	public:
+		mpsc_queue(const mpsc_queue&) = delete;
+		mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+		explicit mpsc_queue(size_t capacity) {
+			size_t size = 2;
+			while (size < capacity) {
+				size <<= 1;
+			}
+			buffer_ = std::make_unique<cell[]>(size);
+			mask_ = size - 1;
+			for (size_t i = 0; i < size; i++) {
+				buffer_[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		// v is moved only when success
+		bool try_push(T&& v) {
+			cell* c = nullptr;
+			auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+			for (;;) {
+				c = &buffer_[pos & mask_];
+				auto seq = c->sequence.load(std::memory_order_acquire);
+				auto dif = (intptr_t)seq - (intptr_t)pos;
+				if (dif == 0) {
+					if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				}
+				else if (dif < 0) { //full
+					return false;
+				}
+				else {
+					pos = enqueue_pos_.load(std::memory_order_relaxed);
+				}
+			}
+			c->data = std::move(v);
+			c->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		// only one consumer thread
+		bool try_pop(T& v) {
+			auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+			cell* c = &buffer_[pos & mask_];
+			auto seq = c->sequence.load(std::memory_order_acquire);
+			if ((intptr_t)seq - (intptr_t)(pos + 1) < 0) { //empty
+				return false;
+			}
+			v = std::move(c->data);
+			c->sequence.store(pos + mask_ + 1, std::memory_order_release);
+			dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		size_t size_approx() const {
+			auto enqueue = enqueue_pos_.load(std::memory_order_relaxed);
+			auto dequeue = dequeue_pos_.load(std::memory_order_relaxed);
+			return enqueue > dequeue ? enqueue - dequeue : 0;
+		}
+	};
+
+	struct write_behind_options {
+		size_t batch_size = 1000; //rows of one multi-row insert
+		std::chrono::milliseconds flush_interval{ 100 }; //flush not full batch after this time
+		size_t capacity = 65536; //queue size, push blocks when full
+	};
+
+	struct write_behind_stats {
+		uint64_t pushed = 0;
+		uint64_t flushed_rows = 0;
+		uint64_t batches = 0;
+		uint64_t failed_rows = 0;
+		uint64_t blocked_pushes = 0; //queue was full
+	};
+
+	//rows pushed by many threads are inserted in batches by a background thread
+	template<typename T>
+	class write_behind {
+	public:
+		using flusher = std::function<void(std::string_view, const std::vector<T>&)>;
+		using error_handler = std::function<void(const std::vector<T>&, const std::exception&)>;
+	private:
+		mpsc_queue<T> queue_;
+		std::string table_;
+		write_behind_options opt_;
+		flusher flusher_;
+		error_handler error_handler_;
+		std::string full_batch_sql_;
+
+		std::atomic<bool> run_ = true;
+		std::atomic<bool> flush_requested_ = false;
+		std::mutex mtx_;
+		std::condition_variable cond_;
+		std::condition_variable flushed_cond_;
+		std::thread flush_thread_;
+
+		std::atomic<uint64_t> pushed_ = 0;
+		std::atomic<uint64_t> flushed_rows_ = 0;
+		std::atomic<uint64_t> batches_ = 0;
+		std::atomic<uint64_t> failed_rows_ = 0;
+		std::atomic<uint64_t> blocked_pushes_ = 0;
+	public:
+		write_behind(const write_behind&) = delete;
+		write_behind& operator=(const write_behind&) = delete;
+
+		write_behind(std::string table, write_behind_options opt, flusher f)
+			:queue_(opt.capacity), table_(std::move(table)), opt_(opt), flusher_(std::move(f))
+		{
+			static_assert(is_tuple_v<T> || reflection::is_reflection_v<T>, "row type must be tuple or reflect struct");
+			if (opt_.batch_size == 0) {
+				opt_.batch_size = 1;
+			}
+			full_batch_sql_ = make_sql(opt_.batch_size);
+			flush_thread_ = std::thread(&write_behind::flush_loop, this);
+		}
+
+		// all pushed rows are flushed before destroyed
+		~write_behind() {
+			{
+				std::lock_guard<std::mutex> lock(mtx_); //the flush thread checks it under the lock before waiting
+				run_ = false;
+			}
+			cond_.notify_one();
+			if (flush_thread_.joinable()) {
+				flush_thread_.join();
+			}
+		}
+
+		// block when the queue is full
+		void push(T row) {
+			if (!run_) {
+				throw except::sql_exception("write_behind is stopped");
+			}
+			if (!queue_.try_push(std::move(row))) {
+				blocked_pushes_++;
+				do {
+					cond_.notify_one();
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				} while (!queue_.try_push(std::move(row)));
+			}
+			if (++pushed_ % opt_.batch_size == 0) {
+				cond_.notify_one();
+			}
+		}
+
+		// false when the queue is full
+		bool try_push(T row) {
+			if (!run_ || !queue_.try_push(std::move(row))) {
+				return false;
+			}
+			if (++pushed_ % opt_.batch_size == 0) {
+				cond_.notify_one();
+			}
+			return true;
+		}
+
+		// wait until all rows pushed before are flushed
+		void flush() {
+			auto target = pushed_.load();
+			std::unique_lock<std::mutex> lock(mtx_);
+			flush_requested_ = true;
+			cond_.notify_one();
+			flushed_cond_.wait(lock, [this, target]() { return flushed_rows_ + failed_rows_ >= target; });
+		}
+
+		// called in the flush thread when a batch failed, the rows are dropped after it
+		void set_error_handler(error_handler h) {
+			std::lock_guard<std::mutex> lock(mtx_);
+			error_handler_ = std::move(h);
+		}
+
+		write_behind_stats get_stats() const {
+			return { pushed_.load(), flushed_rows_.load(), batches_.load(), failed_rows_.load(), blocked_pushes_.load() };
+		}
+
+	private:
+		std::string make_sql(size_t rows) const {
+			constexpr size_t field_count = row_size_v<T>;
+			std::string sql = "insert into " + table_;
+			if constexpr (reflection::is_reflection_v<T>) {
+				sql.append(" (").append(sql::columns<T>()).append(")");
+			}
+			sql += " values ";
+
+			std::string row = "(";
+			for (size_t i = 0; i < field_count; i++) {
+				row += "?,";
+			}
+			row.back() = ')';
+			sql.reserve(sql.length() + rows * (row.length() + 1));
+			for (size_t i = 0; i < rows; i++) {
+				sql.append(row).append(",");
+			}
+			sql.pop_back();
+			return sql;
+		}
+
+		void flush_loop() {
+			std::vector<T> batch;
+			batch.reserve(opt_.batch_size);
+			auto last_flush = std::chrono::steady_clock::now();
+			for (;;) {
+				T row{};
+				while (batch.size() < opt_.batch_size && queue_.try_pop(row)) {
+					batch.emplace_back(std::move(row));
+				}
+
+				bool stopping = !run_;
+				bool full = batch.size() == opt_.batch_size;
+				auto now = std::chrono::steady_clock::now();
+				if (full || (!batch.empty() && (stopping || flush_requested_ || now - last_flush >= opt_.flush_interval))) {
+					write(batch);
+					batch.clear();
+					last_flush = now;
+					continue; //maybe more rows
+				}
+
+				if (stopping && queue_.size_approx() == 0) {
+					break;
+				}
+
+				std::unique_lock<std::mutex> lock(mtx_);
+				flushed_cond_.notify_all();
+				if (!run_ || (flush_requested_ && (!batch.empty() || queue_.size_approx() > 0))) {
+					continue; //write the rest first
+				}
+				flush_requested_ = false;
+				cond_.wait_for(lock, batch.empty() ? opt_.flush_interval : opt_.flush_interval - (now - last_flush));
+			}
+			flushed_cond_.notify_all();
+		}
+
+		void write(const std::vector<T>& batch) {
+			try {
+				flusher_(batch.size() == opt_.batch_size ? full_batch_sql_ : make_sql(batch.size()), batch);
+				flushed_rows_ += batch.size();
+				batches_++;
+			}
+			catch (const std::exception& e) {
+				failed_rows_ += batch.size();
+				std::lock_guard<std::mutex> lock(mtx_);
+				if (error_handler_) {
+					error_handler_(batch, e);
+				}
+				else {
+					SQLCPP_LOG(error, "write_behind flush %zu rows to %s error: %s", batch.size(), table_.c_str(), e.what());
+				}
+			}
+		}
+	};
+}